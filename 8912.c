@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "system.h"
 #include "6502.h"
@@ -37,6 +38,8 @@
 #include "6551.h"
 #include "machine.h"
 #include "avi.h"
+#include "wavcap.h"
+#include "basic.h"
 
 #ifdef __amigaos4__
 #include <proto/exec.h>
@@ -45,16 +48,29 @@
 SDL_AudioSpec obtained;
 Uint32 cyclespersample;
 
-static Sint16 audiocapbuf[AUDIO_BUFLEN];
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Band-limited step table, indexed by the sub-sample position of a step
+// and the output sample it contributes to. Each row sums to 1<<BLEP_SHIFT.
+#define BLEP_CUTOFF  0.42      // Fraction of the host sample rate
+#define BLEP_FFTLEN  8192
+static Sint32 bleptab[BLEP_PHASES][BLEP_TAPS];
+static SDL_bool blepready = SDL_FALSE;
 extern struct avi_handle *vidcap;
+extern struct wavcap_handle *wavcap;
 
 extern Sint16 soundsilence;
 extern SDL_bool soundavailable, soundon, warpspeed;
 
 // Variables used by the queuekeys function
-// (only works for ROM routines)
+// (only works for ROM routines). The queue is a ring that
+// doubles in size when it fills up.
+#define KEYQUEUE_MIN 256
 static char *keyqueue = NULL;
-static int keysqueued = 0, kqoffs = 0;
+static unsigned int kqsize = 0, kqhead = 0, kqtail = 0;
 
 // Volume levels
 Sint32 voltab[] = { 0, 513/4, 828/4, 1239/4, 1923/4, 3238/4, 4926/4, 9110/4, 10344/4, 17876/4, 24682/4, 30442/4, 38844/4, 47270/4, 56402/4, 65535/4};
@@ -88,9 +104,30 @@ unsigned char *eshapes[] = { eshape0, // 0000
                              eshapeE, // 1110
                              eshape4 };//1111
 
+// The envelope shapes flattened into levels, with the step each one
+// loops back to and the step after its last
+static Uint8 envlev[16][ENV_STEPS];
+static Sint32 envloop[16], envend[16];
+
+// Where each channel goes (left, right) for each stereo layout, in 1/256ths
+static Sint32 panning[3][3][2] = { { { 256, 256 }, { 256, 256 }, { 256, 256 } },   // Mono
+                                   { { 256,  64 }, { 181, 181 }, {  64, 256 } },   // ABC
+                                   { { 256,  64 }, {  64, 256 }, { 181, 181 } } }; // ACB
+
+// The mixed output for each side, indexed by the three channel states
+// (bits 12-14) and the volume of channels A, B and C (bits 8-11, 4-7
+// and 0-3), already offset and clamped.
+#define MIXINDEX(ay) (((ay)->out[0]<<12)|((ay)->out[1]<<13)|((ay)->out[2]<<14)|((ay)->vol[0]<<8)|((ay)->vol[1]<<4)|(ay)->vol[2])
+static Sint16 mixtab[2][8<<12];
+
 
 static SDL_COMPAT_KEY *keytab;
 
+// Where each host key is in keytab, hashed on the low bits of the key
+// (-1 for none). Keys that collide fall back to searching keytab.
+#define KEYPOS_MASK 0x1ff
+static Sint8 keypos[KEYPOS_MASK+1];
+
 // Oric keymap (QWERTY)
 //                                FE           FD           FB           F7           EF           DF           BF           7F
 static SDL_COMPAT_KEY qwktab[] = { '7'        , 'n'        , '5'        , 'v'        , SDLK_RCTRL , '1'        , 'x'        , '3'        ,
@@ -126,21 +163,76 @@ static SDL_COMPAT_KEY qzktab[] = { '7'        , 'n'        , '5'        , 'v'
 // are only detected by the standard ROM routines.
 void queuekeys( char *str )
 {
-  if( str )
+  unsigned int len, need, newsize, i;
+  char *newqueue;
+
+  if( !str ) return;
+
+  len  = (unsigned int)strlen( str );
+  need = (kqhead-kqtail) + len;
+  if( need > kqsize )
   {
-    int len = (int)strlen( str );
-    if( keyqueue )
-    {
-      keyqueue = realloc(keyqueue, strlen(keyqueue) + len + 1);
-      strcat(keyqueue, str);
-      keysqueued += len;
-    }
-    else
-    {
-      keyqueue   = strdup( str );
-      keysqueued = len;
-      kqoffs     = 0;
-    }
+    for( newsize = kqsize ? kqsize : KEYQUEUE_MIN; newsize < need; newsize <<= 1 )
+      ;
+
+    newqueue = malloc( newsize );
+    if( !newqueue ) return;
+
+    for( i=0; kqtail+i != kqhead; i++ )
+      newqueue[i] = keyqueue[(kqtail+i)&(kqsize-1)];
+
+    if( keyqueue ) free( keyqueue );
+    keyqueue = newqueue;
+    kqsize   = newsize;
+    kqtail   = 0;
+    kqhead   = i;
+  }
+
+  for( i=0; i<len; i++ )
+    keyqueue[(kqhead++)&(kqsize-1)] = str[i];
+}
+
+// The ROM is waiting for a key, so give it the next one
+// and skip to where it returns with it
+static void ay_feedkey( struct ay8912 *ay, Uint16 retpc )
+{
+  // A listing waiting to be injected goes in before any keys
+  if( basicqueue ) basic_poll( ay->oric );
+  if( kqhead == kqtail ) return;
+
+  ay->oric->cpu.a = keyqueue[(kqtail++)&(kqsize-1)];
+  ay->oric->cpu.write( &ay->oric->cpu, 0x2df, 0 );
+  ay->oric->cpu.f_n = 1;
+  ay->oric->cpu.calcpc = retpc;
+  ay->oric->cpu.calcop = ay->oric->cpu.read( &ay->oric->cpu, ay->oric->cpu.calcpc );
+}
+
+static void ay_buildkeypos( void )
+{
+  int i;
+
+  for( i=0; i<=KEYPOS_MASK; i++ )
+    keypos[i] = -1;
+
+  for( i=63; i>=0; i-- )
+  {
+    if( keytab[i] )
+      keypos[keytab[i]&KEYPOS_MASK] = i;
+  }
+}
+
+// Work out which rows have a held key in one of the columns
+// port A is selecting
+static void ay_buildkeyhits( struct ay8912 *ay )
+{
+  int i;
+
+  ay->keycols = ay->eregs[AY_PORT_A]^0xff;
+  ay->keyhits = 0;
+  for( i=0; i<8; i++ )
+  {
+    if( ay->keyrows[i] & ay->keycols )
+      ay->keyhits |= (1<<i);
   }
 }
 
@@ -154,22 +246,125 @@ static Uint32 ayrand( struct ay8912 *ay )
   return rbit&1;
 }
 
-void ay_audioticktock( struct ay8912 *ay, Uint32 cycles )
+/*
+** Number of clocks until a tone/noise/envelope counter next expires
+*/
+static Uint32 ay_cyclestoexpiry( Sint32 ct, Uint32 per )
 {
-  Sint32 i;
-  Sint32 output;
+  return ( ((Uint32)ct)+1 >= per ) ? 1 : per-((Uint32)ct);
+}
 
-  // For each clock cycle...
-  while( cycles > 0 )
+/*
+** Advance a tone/noise/envelope counter by "cycles" clocks.
+** Returns the number of times it expired (and was reset) on the way,
+** matching what the counter would do if clocked one cycle at a time.
+*/
+static Uint32 ay_countedges( Sint32 *ct, Uint32 per, Uint32 cycles )
+{
+  Uint32 first, p;
+
+  // Cycles until the counter next expires
+  first = ay_cyclestoexpiry( *ct, per );
+  if( cycles < first )
   {
-    // Count for the noise cycle counter
-    if( (++ay->ctn) >= ay->noiseper )
+    *ct += cycles;
+    return 0;
+  }
+
+  // After the first expiry it restarts from zero every "p" cycles
+  cycles -= first;
+  p = per ? per : 1;
+  *ct = cycles % p;
+  return 1 + cycles / p;
+}
+
+/*
+** Flatten the envelope shape descriptions into envlev/envloop/envend
+*/
+static void ay_initenv( void )
+{
+  Sint32 s, i;
+
+  for( s=0; s<16; s++ )
+  {
+    for( i=0; !(eshapes[s][i]&0x80); i++ )
+      envlev[s][i] = eshapes[s][i];
+    envend[s]  = i;
+    envloop[s] = eshapes[s][i]&0x7f;
+  }
+}
+
+/*
+** Fill in the mixer table for a stereo layout
+*/
+static void ay_buildmix( Sint32 mode )
+{
+  Sint32 i, c, s, lev;
+
+  for( i=0; i<(8<<12); i++ )
+  {
+    for( s=0; s<2; s++ )
     {
-      // Noise counter expired, calculate the next noise output level
-      ay->currnoise ^= ayrand( ay );
+      lev = soundsilence;
+      for( c=0; c<3; c++ )
+      {
+        if( i & (1<<(12+c)) )
+          lev += (voltab[(i>>(8-c*4))&0xf] * panning[mode][c][s]) >> 8;
+      }
+      if( lev > 32767 ) lev = 32767;
+      mixtab[s][i] = lev;
+    }
+  }
+}
+
+/*
+** Step the envelope position "steps" times. Each shape is a run-in
+** followed by a loop that ends in a jump code, so whole trips around
+** the loop can be skipped with a modulo.
+*/
+static void ay_envsteps( struct ay8912 *ay, Uint32 steps )
+{
+  Sint32 end, start;
 
-      // Reset the noise counter
-      ay->ctn = 0;
+  end   = envend[ay->envshape];
+  start = envloop[ay->envshape];
+
+  if( ay->envpos < start )
+  {
+    if( steps < (Uint32)(start-ay->envpos) )
+    {
+      ay->envpos += steps;
+      return;
+    }
+    steps -= start-ay->envpos;
+    ay->envpos = start;
+  }
+
+  ay->envpos = start + ((ay->envpos-start)+steps) % (end-start);
+}
+
+/*
+** Emulate the AY sound generators for some clock cycles.
+**
+** None of the generators depend on each other and the output is only
+** calculated at the end, so rather than clocking everything one cycle
+** at a time we work out how many times each counter expires within the
+** period and jump straight to the resulting state. The result is
+** identical to clocking it cycle by cycle.
+*/
+void ay_audioticktock( struct ay8912 *ay, Uint32 cycles )
+{
+  Sint32 i, mix;
+  Uint32 edges;
+
+  if( cycles > 0 )
+  {
+    // Noise generator. Each expiry clocks the RNG once.
+    edges = ay_countedges( &ay->ctn, ay->noiseper, cycles );
+    if( edges )
+    {
+      while( edges-- )
+        ay->currnoise ^= ayrand( ay );
 
       // Remember that the noise output changed
       ay->newnoise = SDL_TRUE;
@@ -180,22 +375,20 @@ void ay_audioticktock( struct ay8912 *ay, Uint32 cycles )
     {
       if( !ay->toneper[i] )
       {
-        if( !ay->sign[i] )
-        {
-          ay->sign[i] = 1;
-          ay->newout |= (1<<i);
-          continue;
-        }
+        // With a zero period the output toggles every cycle, but the
+        // counter is only touched on cycles where the sign was set.
+        if( ( ay->sign[i] ) || ( cycles > 1 ) )
+          ay->ct[i] = 0;
+        ay->sign[i] ^= cycles&1;
+        ay->newout |= (1<<i);
+        continue;
       }
 
-      // Count for the square wave counter
-      if( (++ay->ct[i]) >= ay->toneper[i] )
+      // Each expiry of the square wave counter inverts the output
+      edges = ay_countedges( &ay->ct[i], ay->toneper[i], cycles );
+      if( edges )
       {
-        // Square wave counter expired, reset it...
-        ay->ct[i] = 0;
-
-        // ...and invert the square wave output
-        ay->sign[i] ^= 1;
+        ay->sign[i] ^= edges&1;
 
         // Remember that this channels output has changed
         ay->newout |= (1<<i);
@@ -207,18 +400,12 @@ void ay_audioticktock( struct ay8912 *ay, Uint32 cycles )
         ay->newout |= (1<<i);
     }
 
-    // Count down the envelope cycle counter
-    if( (++ay->cte) >= ay->envper )
+    // Envelope generator
+    edges = ay_countedges( &ay->cte, ay->envper, cycles );
+    if( edges )
     {
-      // Counter expired, so reset it
-      ay->cte = 0;
-
-      // Move to the next envelope position
-      ay->envpos++;
-
-      // Reached the end of the envelope?
-      if( ay->envtab[ay->envpos]&0x80 )
-        ay->envpos = ay->envtab[ay->envpos]&0x7f;
+      // Move to the new envelope position
+      ay_envsteps( ay, edges );
 
       // For each channel...
       for( i=0; i<3; i++ )
@@ -227,40 +414,30 @@ void ay_audioticktock( struct ay8912 *ay, Uint32 cycles )
         if( ay->regs[AY_CHA_AMP+i]&0x10 )
         {
           // Recalculate its output volume
-          ay->vol[i] = voltab[ay->envtab[ay->envpos]];
+          ay->vol[i] = envlev[ay->envshape][ay->envpos];
 
           // and remember that the channel has changed
           ay->newout |= (1<<i);
         }
       }
     }
-
-    // Done one cycle!
-    cycles--;
   }
 
   if( !ay->newout ) return;
 
-  // "Output" accumulates the audio data from all sources
-  output = soundsilence;
-
-  // Loop through the channels
+  // Work out which channels are high...
   for( i=0; i<3; i++ )
   {
-    // Yep, calculate the squarewave signal...
     if( ay->newout & (1<<i) )
-      ay->out[i] = ((ay->tonebit[i]|ay->sign[i])&(ay->noisebit[i]|ay->currnoise)) * ay->vol[i];
-
-    // Mix in the output of this channel
-    output += ay->out[i];
+      ay->out[i] = (ay->tonebit[i]|ay->sign[i])&(ay->noisebit[i]|ay->currnoise);
   }
 
   ay->newout = 0;
 
-  // Clamp the output
-  if( output > 32767 ) output = 32767;
-//  if( output < -32768 ) output = -32768;
-  ay->output = output;
+  // ...and look up the mix
+  mix = MIXINDEX( ay );
+  ay->output[0] = mixtab[0][mix];
+  ay->output[1] = mixtab[1][mix];
 }
 
 void ay_dowrite( struct ay8912 *ay, struct aywrite *aw )
@@ -309,9 +486,9 @@ void ay_dowrite( struct ay8912 *ay, struct aywrite *aw )
       ay->regs[aw->reg] = aw->val;
       i = aw->reg-AY_CHA_AMP;
       if(aw->val&0x10)
-        ay->vol[i] = voltab[ay->envtab[ay->envpos]];
+        ay->vol[i] = envlev[ay->envshape][ay->envpos];
       else
-        ay->vol[i] = voltab[aw->val&0xf];
+        ay->vol[i] = aw->val&0xf;
       ay->newout |= (1<<i);
       break;
     
@@ -325,13 +502,13 @@ void ay_dowrite( struct ay8912 *ay, struct aywrite *aw )
       if( aw->val != 0xff )
       {
         ay->regs[aw->reg] = aw->val;
-        ay->envtab = eshapes[aw->val&0xf];
+        ay->envshape = aw->val&0xf;
         ay->envpos = 0;
         for( i=0; i<3; i++ )
         {
           if( ay->regs[AY_CHA_AMP+i]&0x10 )
           {
-            ay->vol[i] = voltab[ay->envtab[ay->envpos]];
+            ay->vol[i] = envlev[ay->envshape][ay->envpos];
             ay->newout |= (1<<i);
           }
         }
@@ -340,119 +517,629 @@ void ay_dowrite( struct ay8912 *ay, struct aywrite *aw )
   }
 }
 
+/*
+** In-place radix-2 FFT, only used to build the BLEP table
+*/
+static void ay_fft( double *re, double *im, int n, SDL_bool inverse )
+{
+  int i, j, k, m;
+  double a, wr, wi, tr, ti;
+
+  for( i=1, j=0; i<n; i++ )
+  {
+    for( k=n>>1; j&k; k>>=1 )
+      j ^= k;
+    j ^= k;
+    if( i < j )
+    {
+      tr = re[i]; re[i] = re[j]; re[j] = tr;
+      ti = im[i]; im[i] = im[j]; im[j] = ti;
+    }
+  }
+
+  for( m=2; m<=n; m<<=1 )
+  {
+    a = (inverse ? 2.0 : -2.0) * M_PI / m;
+    for( k=0; k<m/2; k++ )
+    {
+      wr = cos( a*k );
+      wi = sin( a*k );
+      for( i=k; i<n; i+=m )
+      {
+        j  = i+m/2;
+        tr = wr*re[j] - wi*im[j];
+        ti = wr*im[j] + wi*re[j];
+        re[j] = re[i]-tr;
+        im[j] = im[i]-ti;
+        re[i] += tr;
+        im[i] += ti;
+      }
+    }
+  }
+
+  if( inverse )
+  {
+    for( i=0; i<n; i++ )
+    {
+      re[i] /= n;
+      im[i] /= n;
+    }
+  }
+}
+
+/*
+** Build the band-limited step table. We start with a windowed sinc
+** lowpass, and convert it to minimum phase (via the real cepstrum) so
+** that nearly all of its energy is right after the step and there is no
+** pre-ringing or extra latency. The table is in units of host samples,
+** so it works for any obtained sample rate.
+*/
+static void ay_initblep( void )
+{
+  double *re, *im, x, w, e, sum;
+  Sint32 i, k, p, len, isum, big;
+
+  if( blepready ) return;
+  blepready = SDL_TRUE;
+
+  len = BLEP_TAPS*BLEP_PHASES;
+  re  = calloc( BLEP_FFTLEN, sizeof( double ) );
+  im  = calloc( BLEP_FFTLEN, sizeof( double ) );
+  if( ( !re ) || ( !im ) )
+  {
+    // Fall back to plain unfiltered steps
+    free( re );
+    free( im );
+    for( p=0; p<BLEP_PHASES; p++ )
+    {
+      for( k=0; k<BLEP_TAPS; k++ )
+        bleptab[p][k] = 0;
+      bleptab[p][0] = 1<<BLEP_SHIFT;
+    }
+    return;
+  }
+
+  // Blackman windowed sinc, oversampled BLEP_PHASES times
+  for( i=0; i<len; i++ )
+  {
+    x = (i - (len-1)/2.0) / BLEP_PHASES;
+    w = 0.42 - 0.5*cos( 2.0*M_PI*i/(len-1) ) + 0.08*cos( 4.0*M_PI*i/(len-1) );
+    re[i] = w * ((x == 0.0) ? 2.0*BLEP_CUTOFF : sin( 2.0*M_PI*BLEP_CUTOFF*x ) / (M_PI*x));
+  }
+
+  // Real cepstrum of the filter...
+  ay_fft( re, im, BLEP_FFTLEN, SDL_FALSE );
+  for( i=0; i<BLEP_FFTLEN; i++ )
+  {
+    x = sqrt( re[i]*re[i] + im[i]*im[i] );
+    re[i] = log( (x < 1e-10) ? 1e-10 : x );
+    im[i] = 0.0;
+  }
+  ay_fft( re, im, BLEP_FFTLEN, SDL_TRUE );
+
+  // ...folded onto the causal side...
+  for( i=1; i<BLEP_FFTLEN/2; i++ )
+  {
+    re[i] *= 2.0;
+    im[i] *= 2.0;
+  }
+  for( i=BLEP_FFTLEN/2+1; i<BLEP_FFTLEN; i++ )
+  {
+    re[i] = 0.0;
+    im[i] = 0.0;
+  }
+
+  // ...gives the minimum phase version
+  ay_fft( re, im, BLEP_FFTLEN, SDL_FALSE );
+  for( i=0; i<BLEP_FFTLEN; i++ )
+  {
+    e = exp( re[i] );
+    x = im[i];
+    re[i] = e*cos( x );
+    im[i] = e*sin( x );
+  }
+  ay_fft( re, im, BLEP_FFTLEN, SDL_TRUE );
+
+  // A step "p/BLEP_PHASES" of the way into sample n contributes to
+  // sample n+1+k the impulse response at time k+1-(p/BLEP_PHASES).
+  // The output is the running sum of those contributions.
+  for( p=0; p<BLEP_PHASES; p++ )
+  {
+    sum = 0.0;
+    for( k=0; k<BLEP_TAPS; k++ )
+      sum += re[k*BLEP_PHASES+BLEP_PHASES-p];
+
+    isum = 0;
+    big  = 0;
+    for( k=0; k<BLEP_TAPS; k++ )
+    {
+      bleptab[p][k] = (Sint32)floor( re[k*BLEP_PHASES+BLEP_PHASES-p] * (1<<BLEP_SHIFT) / sum + 0.5 );
+      isum += bleptab[p][k];
+      if( abs( bleptab[p][k] ) > abs( bleptab[p][big] ) ) big = k;
+    }
+
+    // Make sure each step settles at exactly the right level
+    bleptab[p][big] += (1<<BLEP_SHIFT) - isum;
+  }
+
+  free( re );
+  free( im );
+}
+
+/*
+** Record any change in the output levels at a given cycle of the
+** current audio buffer. In mono only the left side is worked out.
+*/
+static void ay_blepstep( struct ay8912 *ay, Uint32 cycle )
+{
+  Sint32 dl, dr, k, *buf, *tab;
+  Uint32 pos;
+
+  dl = ay->output[0] + ay->tapeout - ay->bleplevel[0];
+  dr = ay->output[1] + ay->tapeout - ay->bleplevel[1];
+  if( ay->stereo == AYSTEREO_MONO ) dr = 0;
+  if( ( !dl ) && ( !dr ) ) return;
+  ay->bleplevel[0] += dl;
+  ay->bleplevel[1] += dr;
+
+  pos = (Uint32)((((Uint64)cycle)*(BLEP_PHASES<<FPBITS))/ay->cps);
+  if( pos >= ay->buflen*BLEP_PHASES ) pos = ay->buflen*BLEP_PHASES-1;
+
+  buf = &ay->blepbuf[(pos/BLEP_PHASES+1)*2];
+  tab = bleptab[pos%BLEP_PHASES];
+  if( dl )
+  {
+    for( k=0; k<BLEP_TAPS; k++ )
+      buf[k*2] += dl * tab[k];
+  }
+  if( dr )
+  {
+    for( k=0; k<BLEP_TAPS; k++ )
+      buf[k*2+1] += dr * tab[k];
+  }
+}
+
+/*
+** Number of cycles until something happens that can change the output
+*/
+static Uint32 ay_cyclestoedge( struct ay8912 *ay )
+{
+  Uint32 n, c;
+  Sint32 i;
+  SDL_bool noise, env;
+
+  n = 0xffffffff;
+  noise = SDL_FALSE;
+  env = SDL_FALSE;
+
+  for( i=0; i<3; i++ )
+  {
+    if( !ay->noisebit[i] ) noise = SDL_TRUE;
+    if( ay->regs[AY_CHA_AMP+i]&0x10 ) env = SDL_TRUE;
+
+    // Tone disabled, so the square wave doesn't matter
+    if( ay->tonebit[i] ) continue;
+
+    c = ay->toneper[i] ? ay_cyclestoexpiry( ay->ct[i], ay->toneper[i] ) : 1;
+    if( c < n ) n = c;
+  }
+
+  if( noise )
+  {
+    c = ay_cyclestoexpiry( ay->ctn, ay->noiseper );
+    if( c < n ) n = c;
+  }
+
+  if( env )
+  {
+    c = ay_cyclestoexpiry( ay->cte, ay->envper );
+    if( c < n ) n = c;
+  }
+
+  return n;
+}
+
+/*
+** Run the AY up to the given cycle, recording every change in the
+** output at the cycle it happens. The work done depends on the number
+** of edges, not the number of cycles.
+*/
+static void ay_blepadvance( struct ay8912 *ay, Uint32 tocyc )
+{
+  Uint32 n;
+
+  while( ay->lastcyc < tocyc )
+  {
+    n = ay_cyclestoedge( ay );
+    if( n > tocyc-ay->lastcyc ) n = tocyc-ay->lastcyc;
+
+    ay_audioticktock( ay, n );
+    ay->lastcyc += n;
+    ay_blepstep( ay, ay->lastcyc );
+  }
+}
+
+/*
+** Apply everything in the event log immediately. Only used when the
+** audio callback isn't consuming it (sound off, warp speed, mode
+** changes), so taking the audio lock here is fine.
+*/
 void ay_flushlog( struct ay8912 *ay )
 {
+  struct aywrite *aw;
+  Uint32 head, tail;
+
+  if( !ay->writelog ) return;
+
+  head = AY_LOAD_ACQUIRE( &ay->loghead );
+  if( head == ay->logtail ) return;
+
+  if( soundavailable ) SDL_LockAudio();
+  for( tail=ay->logtail; tail!=head; tail++ )
+  {
+    aw = &ay->writelog[tail&ay->logmask];
+    if( aw->reg == AY_TAPE_EVENT )
+      continue;
+    ay_dowrite( ay, aw );
+  }
+  AY_STORE_RELEASE( &ay->logtail, tail );
+  if( soundavailable ) SDL_UnlockAudio();
+}
+
+/*
+** Add a cycle-stamped AY write or tape edge to the event log. This is
+** only ever called from the emulation thread, and never waits for the
+** audio thread. If the log is full the write is dropped, but the
+** register is remembered and sent again with its latest value as soon
+** as there is room.
+*/
+void ay_logevent( struct ay8912 *ay, Uint8 reg, Uint8 val )
+{
+  struct aywrite *aw;
+  Uint32 head, tail;
   int i;
 
-  for (i=0; i<ay->logged; i++)
-    ay_dowrite( ay, &ay->writelog[i] );
-  ay->logged = 0;
+  if( !ay->writelog ) return;
+
+  head = ay->loghead;
+  tail = AY_LOAD_ACQUIRE( &ay->logtail );
+
+  for( i=0; ( ay->dirtyregs ) && ( i<NUM_AY_REGS ); i++ )
+  {
+    if( !(ay->dirtyregs&(1<<i)) ) continue;
+    if( head-tail > ay->logmask ) break;
+
+    aw = &ay->writelog[(head++)&ay->logmask];
+    aw->cycle = ay->logcycle;
+    aw->reg   = i;
+    aw->val   = ay->eregs[i];
+    ay->dirtyregs &= ~(1<<i);
+  }
+
+  if( head-tail > ay->logmask )
+  {
+    if( reg != AY_TAPE_EVENT )
+      ay->dirtyregs |= (1<<reg);
+  }
+  else
+  {
+    aw = &ay->writelog[(head++)&ay->logmask];
+    aw->cycle = ay->logcycle;
+    aw->reg   = reg;
+    aw->val   = val;
+  }
+
+  // Publish the new entries to the audio thread
+  AY_STORE_RELEASE( &ay->loghead, head );
 }
 
 /*
-** This is the SDL audio callback. It is called by SDL
-** when it needs a sound buffer to be filled.
+** Should the emulation be paced by the audio output? Only makes sense
+** when sound is actually playing, and we're aiming for real speed.
 */
-void ay_callback( void *dummy, Sint8 *stream, int length )
+SDL_bool ay_audiosync_wanted( struct machine *oric )
 {
-  Uint16 *out;
-  Sint16 fout;
-  Sint32 i, j, logc, tlogc;
-  struct ay8912 *ay = (struct ay8912 *)dummy;
+  return oric->audiosync && soundavailable && soundon && (!warpspeed) &&
+         ( oric->frameskip_target == 100 ) && ( oric->emu_mode == EM_RUNNING );
+}
+
+/*
+** Estimate how many cycles the emulation is ahead of the audio output.
+** The audio position is only updated once per buffer, so we extrapolate
+** from the time of the last callback. Returns SDL_FALSE if the audio
+** doesn't seem to be running, in which case the caller should fall back
+** to pacing by the timer.
+*/
+SDL_bool ay_audiolead( struct ay8912 *ay, Sint32 *lead )
+{
+  Uint32 cyc, ticks, elapsed;
+
+  cyc     = AY_LOAD_ACQUIRE( &ay->audiocycle );
+  ticks   = AY_LOAD_ACQUIRE( &ay->audioticks );
+  elapsed = SDL_GetTicks() - ticks;
+
+  // Nothing heard from the audio thread for a while?
+  if( ( !ticks ) || ( elapsed > 250 ) )
+    return SDL_FALSE;
+
+  *lead = (Sint32)(ay->logcycle - (cyc + (elapsed*CYCLESPERSECOND)/1000));
+  return SDL_TRUE;
+}
+
+/*
+** Synthesise "nsamples" samples of stereo output into capbuf, covering
+** the emulated cycles from "start". Returns the number of cycles used.
+**
+** All register writes and tape edges for the buffer are applied at the
+** cycle they were logged, and every resulting change in the output is
+** placed into the buffer as a band-limited step at its exact position.
+*/
+static Uint32 ay_synth( struct ay8912 *ay, Uint32 start, Sint32 nsamples )
+{
+  Sint32 fout=0, i, s, rel;
+  Uint32 span, head, tail;
+  struct aywrite *aw;
   Sint32 dcadjustave, dcadjustmax;
   SDL_bool tapenoise;
 
-  logc    = 0;
-  tlogc   = 0;
   dcadjustave = 0;
   dcadjustmax = soundsilence;
 
-  tapenoise = ay->oric->tapenoise && ((!ay->oric->tapeturbo)||(ay->oric->rawtape));
+  span = (ay->ccycle + nsamples*ay->cps)>>FPBITS;
+  ay->ccycle = (ay->ccycle + nsamples*ay->cps)&((1<<FPBITS)-1);
+  ay->lastcyc = 0;
+
+  tapenoise = ay->oric->tapenoise && ((!ay->oric->tapeturbo)||(ay->oric->tape.raw));
   if( !tapenoise ) ay->tapeout = 0;
 
-  out = (Uint16 *)stream;
-  for( i=0,j=0; i<AUDIO_BUFLEN && i<length/(2*sizeof(Uint16)); i++ )
-  {
-    ay->ccyc = ay->ccycle>>FPBITS;
+  // Pick up anything that changed the level between buffers
+  ay_blepstep( ay, 0 );
 
-    while( ( logc < ay->logged ) && ( ay->ccyc >= ay->writelog[logc].cycle ) )
-      ay_dowrite( ay, &ay->writelog[logc++] );
+  // Apply logged writes and tape edges in cycle order. Anything that
+  // arrived late is applied at the start of the buffer.
+  head = AY_LOAD_ACQUIRE( &ay->loghead );
+  for( tail=ay->logtail; tail!=head; tail++ )
+  {
+    aw  = &ay->writelog[tail&ay->logmask];
+    rel = (Sint32)(aw->cycle - start);
+    if( rel >= (Sint32)span ) break;
+    if( rel < 0 ) rel = 0;
 
-    if( tapenoise )
+    ay_blepadvance( ay, rel );
+    if( aw->reg == AY_TAPE_EVENT )
     {
-      while( ( tlogc < ay->tlogged ) && ( ay->ccyc >= ay->tapelog[tlogc].cycle ) )
-        ay->tapeout = ay->tapelog[tlogc++].val * 8192;
+      if( !tapenoise ) continue;
+      ay->tapeout = aw->val * 8192;
     }
+    else
+    {
+      ay_dowrite( ay, aw );
+      ay_audioticktock( ay, 0 );
+    }
+    ay_blepstep( ay, ay->lastcyc );
+  }
+
+  // Hand the used entries back to the emulation thread
+  AY_STORE_RELEASE( &ay->logtail, tail );
+
+  ay_blepadvance( ay, span );
 
-    if( ay->ccyc > ay->lastcyc )
+  // Integrate the steps into samples
+  for( i=0; i<nsamples*2; i++ )
+  {
+    s = i&1;
+    if( ( s ) && ( ay->stereo == AYSTEREO_MONO ) )
     {
-      ay_audioticktock( ay, ay->ccyc-ay->lastcyc );
-      ay->lastcyc = ay->ccyc;
+      // Same as the left
+      ay->capbuf[i] = fout;
+      continue;
     }
 
-    fout = ay->output + ay->tapeout;
-    out[j++] = fout;
-    out[j++] = fout;
-    if( vidcap ) audiocapbuf[i] = fout;
+    ay->blepacc[s] += ay->blepbuf[i];
+    fout = ay->blepacc[s] >> BLEP_SHIFT;
+    if( fout > 32767 ) fout = 32767;
+    if( fout < -32768 ) fout = -32768;
+
+    ay->capbuf[i] = fout;
 
     if( fout > dcadjustmax ) dcadjustmax = fout;
     dcadjustave += fout;
-
-    ay->ccycle += cyclespersample;
   }
 
-  dcadjustave /= (length/4);
+  // Keep the tails of steps near the end for the next buffer
+  memmove( &ay->blepbuf[0], &ay->blepbuf[nsamples*2], BLEP_TAPS*2*sizeof(ay->blepbuf[0]) );
+  memset( &ay->blepbuf[BLEP_TAPS*2], 0, nsamples*2*sizeof(ay->blepbuf[0]) );
+
+  if( nsamples > 0 )
+    dcadjustave /= (ay->stereo == AYSTEREO_MONO) ? nsamples : nsamples*2;
 
   if( (dcadjustmax-dcadjustave) > 32767 )
     dcadjustave = -(32767-dcadjustmax);
 
   if( dcadjustave )
   {
-    for( i=0, j=0; i<AUDIO_BUFLEN && i<length/(2*sizeof(Uint16)); i++ )
+    for( i=0; i<nsamples*2; i++ )
+      ay->capbuf[i] -= dcadjustave;
+  }
+
+  return span;
+}
+
+/*
+** This is the SDL audio callback. It is called by SDL
+** when it needs a sound buffer to be filled.
+*/
+void ay_callback( void *dummy, Sint8 *stream, int length )
+{
+  Sint32 nsamples;
+  Sint32 i, j, lead, want, adjust;
+  Uint32 start, span, now;
+  struct ay8912 *ay = (struct ay8912 *)dummy;
+  SDL_bool sync;
+
+  nsamples = length/(2*sizeof(Uint16));
+  if( nsamples > ay->buflen ) nsamples = ay->buflen;
+
+  start = ay->cbase;
+  now   = AY_LOAD_ACQUIRE( &ay->logcycle );
+  sync  = ay_audiosync_wanted( ay->oric );
+
+  if( sync )
+  {
+    // The emulation is paced by us, so this buffer carries on exactly
+    // where the last one ended. How far ahead the emulation is tells us
+    // whether we are playing slightly too fast or too slow, so nudge
+    // the rate (by no more than 0.5%) to keep the latency constant.
+    span = (nsamples*cyclespersample)>>FPBITS;
+    lead = (Sint32)(now - start);
+    want = span + (ay->synclead*3)/2;
+
+    if( ( lead < -(Sint32)span ) || ( lead > want+span*4 ) )
+    {
+      // Way out (after a pause or a reset), so just jump
+      start = now - want;
+      adjust = 0;
+    }
+    else
     {
-      out[j++] -= dcadjustave;
-      out[j++] -= dcadjustave;
-      if( vidcap ) audiocapbuf[i] -= dcadjustave;
+      adjust = (Sint32)((((Sint64)(lead-want))*cyclespersample)/(span*16));
+      if( adjust >  (Sint32)(cyclespersample/200) ) adjust =  cyclespersample/200;
+      if( adjust < -(Sint32)(cyclespersample/200) ) adjust = -(Sint32)(cyclespersample/200);
     }
+    ay->cps = cyclespersample + adjust;
+  }
+  else
+  {
+    // This buffer covers the emulated cycles from where the emulation
+    // was at the last callback.
+    ay->cps = cyclespersample;
+    ay->cbase = now;
   }
 
+  span = ay_synth( ay, start, nsamples );
+  if( sync ) ay->cbase = start + span;
+
+  // Tell the emulation where the audio has got to, and when
+  AY_STORE_RELEASE( &ay->audioticks, SDL_GetTicks() );
+  AY_STORE_RELEASE( &ay->audiocycle, start + span );
+
+  // Latency is how far the emulation is ahead of this buffer, plus the
+  // buffer SDL is playing while we fill this one. Smoothed a little.
+  lead = (Sint32)(now - start);
+  if( lead < 0 ) lead = 0;
+  lead = (Sint32)((((Uint64)lead)*1000)/CYCLESPERSECOND) + (nsamples*1000)/obtained.freq;
+  AY_STORE_RELEASE( &ay->latency, (ay->latency*7 + lead)/8 );
+
+  memcpy( stream, ay->capbuf, nsamples*2*sizeof(ay->capbuf[0]) );
+
+  if( wavcap )
+    wavcap_addaudio( wavcap, ay->capbuf, nsamples*2, SDL_FALSE );
+
   if( vidcap )
   {
+    // The AVI soundtrack is mono
+    for( i=0, j=0; i<nsamples; i++, j+=2 )
+    {
+      ay->capbuf[i] = (ay->capbuf[j]+ay->capbuf[j+1])/2;
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    for( i=0; i<(length/4); i++ )
-      audiocapbuf[i] = SDL_Swap16( audiocapbuf[i] );
+      ay->capbuf[i] = SDL_Swap16( ay->capbuf[i] );
 #endif
-    avi_addaudio( &vidcap, audiocapbuf, length/2 );
+    }
+    avi_addaudio( &vidcap, ay->capbuf, nsamples*2 );
   }
+}
 
-  if (ay->logged > logc)
+/*
+** With no sound device (a headless rip) nothing calls ay_callback, so
+** the emulation thread synthesises the audio itself, a buffer at a time,
+** as far as it has emulated. It runs as fast as the emulation does.
+*/
+void ay_headlessaudio( struct ay8912 *ay )
+{
+  Uint32 now, span;
+
+  if( ( soundavailable ) || ( !ay->blepbuf ) ) return;
+
+  now = ay->logcycle;
+  ay->cps = cyclespersample;
+  for( ;; )
   {
-    memmove(&ay->writelog[0], &ay->writelog[logc], (ay->logged-logc) * sizeof(ay->writelog[0]));
-    ay->logged -= logc;
-    for (i=0; i<ay->logged; i++)
-      ay->writelog[i].cycle -= ay->lastcyc;
+    span = (ay->ccycle + ay->buflen*ay->cps)>>FPBITS;
+    if( (Sint32)(now - ay->cbase) < (Sint32)span ) break;
 
-    /* Got out of sync? */
-    if (ay->logged > 150)
-      ay_flushlog( ay );
+    ay->cbase += ay_synth( ay, ay->cbase, ay->buflen );
+    if( wavcap )
+      wavcap_addaudio( wavcap, ay->capbuf, ay->buflen*2, SDL_TRUE );
   }
-  else
+}
+
+/*
+** Switch between mono and the stereo layouts
+*/
+void ay_setstereo( struct ay8912 *ay, int mode )
+{
+  Sint32 i;
+
+  if( ( mode < AYSTEREO_MONO ) || ( mode > AYSTEREO_ACB ) )
+    mode = AYSTEREO_MONO;
+
+  if( soundavailable ) SDL_LockAudio();
+  ay_buildmix( mode );
+
+  // The right side isn't tracked in mono, so start it off as a copy of the left
+  if( ( ay->stereo == AYSTEREO_MONO ) && ( ay->blepbuf ) )
   {
-    ay->logged = 0;
+    for( i=0; i<ay->buflen+BLEP_TAPS; i++ )
+      ay->blepbuf[i*2+1] = ay->blepbuf[i*2];
+    ay->blepacc[1]   = ay->blepacc[0];
+    ay->bleplevel[1] = ay->bleplevel[0];
   }
 
-  if( tapenoise )
+  ay->stereo = mode;
+  ay->newout = 7;
+  ay_audioticktock( ay, 0 );
+  if( soundavailable ) SDL_UnlockAudio();
+}
+
+/*
+** Work out everything that follows from the register values, after
+** they have been loaded from a snapshot
+*/
+void ay_restore( struct ay8912 *ay )
+{
+  Sint32 i;
+
+  ay->envshape = ay->regs[AY_ENV_CYCLE]&0xf;
+  if( ( ay->envpos < 0 ) || ( ay->envpos >= envend[ay->envshape] ) )
+    ay->envpos = envloop[ay->envshape];
+
+  for( i=0; i<3; i++ )
   {
-    while( tlogc < ay->tlogged )
-      ay->tapeout = ay->tapelog[tlogc++].val * 8192;
+    if( ay->regs[AY_CHA_AMP+i]&0x10 )
+      ay->vol[i] = envlev[ay->envshape][ay->envpos];
+    else
+      ay->vol[i] = ay->regs[AY_CHA_AMP+i]&0xf;
   }
 
-  ay->ccycle -= (ay->lastcyc<<FPBITS);
-  ay->lastcyc = 0;
-  ay->newlogcycle = ay->ccycle>>FPBITS;
-  ay->do_logcycle_reset = SDL_TRUE;
-//  ay->logged   = 0;
-  ay->tlogged  = 0;
+  ay->newout = 7;
+  ay_audioticktock( ay, 0 );
+  ay_buildkeyhits( ay );
+}
+
+/*
+** Set up for ay_headlessaudio
+*/
+SDL_bool ay_initheadless( struct ay8912 *ay, int rate, int samples )
+{
+  if( !ay_setbuffers( ay, samples ) )
+    return SDL_FALSE;
+
+  cyclespersample = ((CYCLESPERSECOND<<FPBITS)/rate);
+  ay->cps = cyclespersample;
+
+  // Log the writes for ay_headlessaudio instead of applying them
+  soundon = SDL_TRUE;
+  return SDL_TRUE;
 }
 
 /*
@@ -462,41 +1149,21 @@ void ay_callback( void *dummy, Sint8 *stream, int length )
 void ay_ticktock( struct ay8912 *ay, int cycles )
 {
   // Need to do queued keys?
-  if( ( keyqueue ) && ( keysqueued ) )
+  if( ( kqhead != kqtail ) || ( basicqueue ) )
   {
-    if( kqoffs >= keysqueued )
+    switch( ay->oric->type )
     {
-      free(keyqueue);
-      keyqueue = NULL;
-      keysqueued = 0;
-      kqoffs = 0;
-    } else {
-      switch( ay->oric->type )
-      {
-        case MACH_ATMOS:
-        case MACH_PRAVETZ:
-          if( ( ay->oric->cpu.pc == 0xeb78 ) && ( ay->oric->romon ) )
-          {
-            ay->oric->cpu.a = keyqueue[kqoffs++];
-            ay->oric->cpu.write( &ay->oric->cpu, 0x2df, 0 );
-            ay->oric->cpu.f_n = 1;
-            ay->oric->cpu.calcpc = 0xeb88;
-            ay->oric->cpu.calcop = ay->oric->cpu.read( &ay->oric->cpu, ay->oric->cpu.calcpc );
-          }
-          break;
-        
-        case MACH_ORIC1:
-        case MACH_ORIC1_16K:
-          if( ( ay->oric->cpu.pc == 0xe905 ) && ( ay->oric->romon ) )
-          {
-            ay->oric->cpu.a = keyqueue[kqoffs++];
-            ay->oric->cpu.write( &ay->oric->cpu, 0x2df, 0 );
-            ay->oric->cpu.f_n = 1;
-            ay->oric->cpu.calcpc = 0xe915;
-            ay->oric->cpu.calcop = ay->oric->cpu.read( &ay->oric->cpu, ay->oric->cpu.calcpc );
-          }
-          break;
-      }
+      case MACH_ATMOS:
+      case MACH_PRAVETZ:
+        if( ( ay->oric->cpu.pc == 0xeb78 ) && ( ay->oric->romon ) )
+          ay_feedkey( ay, 0xeb88 );
+        break;
+      
+      case MACH_ORIC1:
+      case MACH_ORIC1_16K:
+        if( ( ay->oric->cpu.pc == 0xe905 ) && ( ay->oric->romon ) )
+          ay_feedkey( ay, 0xe915 );
+        break;
     }
   }
 
@@ -551,14 +1218,14 @@ void ay_ticktock( struct ay8912 *ay, int cycles )
     }
   }
 
-  if( ay->do_logcycle_reset )
-  {
-    ay->logcycle = ay->newlogcycle;
-    ay->do_logcycle_reset = SDL_FALSE;
-  }
-  ay->logcycle += cycles;
+  // Let the audio thread know how far we've got
+  AY_STORE_RELEASE( &ay->logcycle, ay->logcycle+cycles );
 }
 
+/*
+** The AY and tape events don't need the audio lock any more, but AVI
+** capture still writes to the same file from both threads.
+*/
 void ay_lockaudio( struct ay8912 *ay )
 {
   if( ay->audiolocked ) return;
@@ -588,10 +1255,12 @@ SDL_bool ay_init( struct ay8912 *ay, struct machine *oric )
     case KMAP_QWERTZ: keytab = qzktab; break;
     default:          keytab = qwktab; break;
   }
+  ay_buildkeypos();
 
   // No oric keys pressed
   for( i=0; i<8; i++ )
-    ay->keystates[i] = SDL_FALSE;
+    ay->keyrows[i] = 0;
+  ay_buildkeyhits( ay );
 
   // Reset all regs to 0
   for( i=0; i<NUM_AY_REGS; i++ )
@@ -612,7 +1281,8 @@ SDL_bool ay_init( struct ay8912 *ay, struct machine *oric )
   ay->ctn = 0; // Reset the noise counter
   ay->cte = 0; // Reset the envelope counter
 
-  ay->envtab  = eshape0;    // Default to envelope 0
+  ay_initenv();
+  ay->envshape = 0;         // Default to envelope 0
   ay->envpos  = 0;
 
   ay->bmode   = 0;          // GI silly addressing mode
@@ -621,24 +1291,93 @@ SDL_bool ay_init( struct ay8912 *ay, struct machine *oric )
   ay->soundon = soundavailable && soundon && (!warpspeed);
   ay->currnoise = 0;
   ay->rndrack = 1;
-  ay->logged  = 0;
+  ay->keybitdelay = 0;
+  ay->audiolocked = SDL_FALSE;
+
+  // Nothing else touches the event log without going through the ring,
+  // but resetting it needs the audio thread out of the way.
+  if( soundavailable ) SDL_LockAudio();
+  ay->loghead = 0;
+  ay->logtail = 0;
   ay->logcycle = 0;
-  ay->do_logcycle_reset = SDL_FALSE;
-  ay->output  = soundsilence;
+  ay->dirtyregs = 0;
+  ay->cbase   = 0;
+  ay->cps     = cyclespersample;
+  ay->audiocycle = 0;
+  ay->audioticks = 0;
+  ay->synclead   = CYCLESPERSECOND/50;
   ay->lastcyc = 0;
-  ay->ccyc    = 0;
   ay->ccycle  = 0;
   ay->tapeout = 0;
-  ay->tlogged = 0;
-  ay->tapeout = 0;
-  ay->keybitdelay = 0;
-  ay->audiolocked = SDL_FALSE;
+
+  ay->stereo  = oric->aystereo;
+  ay_buildmix( ay->stereo );
+  ay->output[0] = soundsilence;
+  ay->output[1] = soundsilence;
+
+  ay_initblep();
+  if( ay->blepbuf )
+    memset( ay->blepbuf, 0, (ay->buflen+BLEP_TAPS)*2*sizeof( ay->blepbuf[0] ) );
+  for( i=0; i<2; i++ )
+  {
+    ay->bleplevel[i] = soundsilence;
+    ay->blepacc[i]   = soundsilence<<BLEP_SHIFT;
+  }
+  if( soundavailable ) SDL_UnlockAudio();
+
   if( soundavailable )
     SDL_PauseAudio( 0 );
 
   return SDL_TRUE;
 }
 
+/*
+** (Re)allocate the audio buffers and event log to suit the audio buffer
+** length SDL gave us. The audio must not be running when this is called.
+*/
+SDL_bool ay_setbuffers( struct ay8912 *ay, int samples )
+{
+  Uint32 logsize;
+
+  if( ( ay->blepbuf ) && ( ay->buflen == samples ) )
+    return SDL_TRUE;
+
+  ay_freebuffers( ay );
+
+  // The log needs to hold all the writes for a buffer (the old fixed
+  // log allowed 12 per sample) plus a frame or so of lead.
+  for( logsize=WRITELOG_MIN; logsize<(Uint32)samples*12+WRITELOG_MIN; logsize<<=1 ) ;
+
+  ay->blepbuf  = malloc( (samples+BLEP_TAPS)*2*sizeof( ay->blepbuf[0] ) );
+  ay->capbuf   = malloc( samples*2*sizeof( ay->capbuf[0] ) );
+  ay->writelog = malloc( logsize*sizeof( ay->writelog[0] ) );
+  if( ( !ay->blepbuf ) || ( !ay->capbuf ) || ( !ay->writelog ) )
+  {
+    ay_freebuffers( ay );
+    return SDL_FALSE;
+  }
+
+  ay->buflen  = samples;
+  ay->logmask = logsize-1;
+  ay->loghead = 0;
+  ay->logtail = 0;
+  ay->latency = 0;
+  memset( ay->blepbuf, 0, (samples+BLEP_TAPS)*2*sizeof( ay->blepbuf[0] ) );
+  return SDL_TRUE;
+}
+
+void ay_freebuffers( struct ay8912 *ay )
+{
+  free( ay->blepbuf );
+  free( ay->capbuf );
+  free( ay->writelog );
+  ay->blepbuf  = NULL;
+  ay->capbuf   = NULL;
+  ay->writelog = NULL;
+  ay->buflen   = 0;
+  ay->logmask  = 0;
+}
+
 /*
 ** Update the VIA bits when key states change
 */
@@ -652,10 +1391,7 @@ void ay_update_keybits( struct ay8912 *ay )
     return;
   }
 
-  if( ay->keystates[ay->currkeyoffs] & (ay->eregs[AY_PORT_A]^0xff) )
-    ay->oric->via.write_port_b( &ay->oric->via, 0x08, 0x08 );
-  else
-    ay->oric->via.write_port_b( &ay->oric->via, 0x08, 0x00 );
+  ay->oric->via.write_port_b( &ay->oric->via, 0x08, ((ay->keyhits>>ay->currkeyoffs)&1)<<3 );
 }
 
 /*
@@ -663,32 +1399,41 @@ void ay_update_keybits( struct ay8912 *ay )
 */
 void ay_keypress( struct ay8912 *ay, SDL_COMPAT_KEY key, SDL_bool down )
 {
-  int i;
+  int i, row;
 
   // No key?
   if( key == 0 ) return;
 
   // Does this key exist on the Oric?
-  for( i=0; i<64; i++ )
-    if( keytab[i] == key ) break;
+  i = keypos[key&KEYPOS_MASK];
+  if( i < 0 ) return;
+
+  if( keytab[i] != key )
+  {
+    // Shares its hash with another key
+    for( i=0; i<64; i++ )
+      if( keytab[i] == key ) break;
 
-  // No...
-  if( i == 64 ) return;
+    // No...
+    if( i == 64 ) return;
+  }
+
+  row = i>>3;
 
   // Key down event, or key up event?
   if( down )
-    ay->keystates[i>>3] |= (1<<(i&7));          // Down, so set the corresponding bit
+    ay->keyrows[row] |= (1<<(i&7));             // Down, so set the corresponding bit
   else
-    ay->keystates[i>>3] &= ~(1<<(i&7));         // Up, so clear it
+    ay->keyrows[row] &= ~(1<<(i&7));            // Up, so clear it
+
+  if( ay->keyrows[row] & ay->keycols )
+    ay->keyhits |= (1<<row);
+  else
+    ay->keyhits &= ~(1<<row);
 
   // Maybe update the VIA
-  if( ay->currkeyoffs == (i>>3) )
-  {
-    if( ay->keystates[ay->currkeyoffs] & (ay->eregs[AY_PORT_A]^0xff) )
-      ay->oric->via.write_port_b( &ay->oric->via, 0x08, 0x08 );
-    else
-      ay->oric->via.write_port_b( &ay->oric->via, 0x08, 0x00 );
-  }
+  if( ay->currkeyoffs == row )
+    ay->oric->via.write_port_b( &ay->oric->via, 0x08, ((ay->keyhits>>row)&1)<<3 );
 }
 
 /*
@@ -723,6 +1468,9 @@ void ay_modeset( struct ay8912 *ay )
       if( ( ay->creg != AY_ENV_CYCLE ) || ( v != 0xff ) )
         ay->eregs[ay->creg] = v;
 
+      if( ( ay->creg == AY_ENV_CYCLE ) && ( v != 0xff ) )
+        ay->envwritten = SDL_TRUE;
+
       switch( ay->creg )
       {
         case AY_STATUS:
@@ -755,23 +1503,11 @@ void ay_modeset( struct ay8912 *ay )
             break;
           }
 
-          ay_lockaudio( ay );  // Gets unlocked at the end of each frame
-
-          if( ay->do_logcycle_reset )
-          {
-            ay->logcycle = ay->newlogcycle;
-            ay->do_logcycle_reset = SDL_FALSE;
-          }
-
-          if( ay->logged >= WRITELOG_SIZE )
-            ay_flushlog( ay );
-
-          ay->writelog[ay->logged  ].cycle = ay->logcycle;
-          ay->writelog[ay->logged  ].reg   = ay->creg;
-          ay->writelog[ay->logged++].val   = v;
+          ay_logevent( ay, ay->creg, v );
           break;
 
         case AY_PORT_A:
+          ay_buildkeyhits( ay );
           ay->keybitdelay = 3;
           break;
       }
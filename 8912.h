@@ -23,13 +23,47 @@
 // clock cycles to audio samples
 #define FPBITS 10
 
-// Audio buffer size
+// Default audio buffer size (can be changed at runtime)
 #ifndef AUDIO_BUFLEN
 #define AUDIO_BUFLEN 2048
 #endif
+#define AUDIO_BUFLEN_MIN 64
+#define AUDIO_BUFLEN_MAX 8192
 
-#define WRITELOG_SIZE (AUDIO_BUFLEN*12)
-#define TAPELOG_SIZE (AUDIO_BUFLEN)
+// Band-limited step synthesis: sub-sample positions, length of
+// each step in samples and the fixed point shift of the table
+#define BLEP_PHASES 32
+#define BLEP_TAPS   32
+#define BLEP_SHIFT  12
+
+// Minimum size of the event log between the emulation and the audio
+// thread. It is sized to suit the audio buffer length (see ay_setbuffers).
+#define WRITELOG_MIN 8192
+
+// Where the three channels go in the stereo image
+#define AYSTEREO_MONO 0
+#define AYSTEREO_ABC  1
+#define AYSTEREO_ACB  2
+
+// Longest envelope shape, in steps
+#define ENV_STEPS 32
+
+// Pseudo register number used to log tape noise edges
+#define AY_TAPE_EVENT 0xff
+
+// The event log is a single-producer, single-consumer ring. The
+// emulation thread fills it and the audio thread empties it, and
+// each side only ever writes its own index.
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define AY_LOAD_ACQUIRE(p)    __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define AY_STORE_RELEASE(p,v) __atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+#elif defined(__GNUC__)
+#define AY_LOAD_ACQUIRE(p)    ({ Uint32 ay_v_ = *(volatile Uint32 *)(p); __sync_synchronize(); ay_v_; })
+#define AY_STORE_RELEASE(p,v) do { __sync_synchronize(); *(volatile Uint32 *)(p) = (v); } while(0)
+#else
+#define AY_LOAD_ACQUIRE(p)    (*(volatile Uint32 *)(p))
+#define AY_STORE_RELEASE(p,v) do { *(volatile Uint32 *)(p) = (v); } while(0)
+#endif
 
 #define CYCLESPERSECOND (312*64*50)
 // We now calculate this using the actual obtained frequency
@@ -69,17 +103,12 @@ struct aywrite
   Uint8  val;
 };
 
-struct tnchange
-{
-  Uint32 cycle;
-  Uint8  val;
-};
-
 struct ay8912
 {
   Uint8           bmode, creg;
   Uint8           regs[NUM_AY_REGS], eregs[NUM_AY_REGS];
-  SDL_bool        keystates[8], newnoise;
+  SDL_bool        envwritten;             // Envelope shape written since the last AY dump frame
+  SDL_bool        newnoise;
   SDL_bool        soundon;
   SDL_bool        tapenoiseon;
   Uint32          toneper[3], noiseper, envper;
@@ -87,26 +116,44 @@ struct ay8912
   Sint32          ct[3], ctn, cte;
   Uint32          tonepos[3], tonestep[3];
   Sint32          sign[3], out[3], envpos;
-  unsigned char  *envtab;
+  Sint32          envshape;
+  Sint32          stereo;
   struct machine *oric;
   Uint32          currnoise, rndrack;
-  Sint16          output;
+  Sint16          output[2];              // Left and right
   Sint16          tapeout;
-  Uint32          ccycle, lastcyc, ccyc;
+  Uint32          ccycle, lastcyc, cbase, cps;
+  Sint32          bleplevel[2], blepacc[2];
+  Sint32          buflen;                 // Audio buffer length in samples
+  Sint32         *blepbuf;                // buflen+BLEP_TAPS steps, left/right interleaved
+  Sint16         *capbuf;                 // buflen stereo samples, for output and capture
   Uint32          keybitdelay, currkeyoffs;
+  Uint8           keyrows[8];             // Keys held in each row of the matrix, one bit per column
+  Uint8           keycols;                // Columns selected by port A (set bits)
+  Uint8           keyhits;                // Rows with a held key in a selected column
 
   SDL_bool        audiolocked;
-  SDL_bool        do_logcycle_reset;
-  Sint32          logged, tlogged;
-  Uint32          logcycle, newlogcycle;
-  struct aywrite  writelog[WRITELOG_SIZE];
-  struct tnchange tapelog[TAPELOG_SIZE];
+  Uint32          logcycle, dirtyregs;
+  Uint32          loghead, logtail, logmask;
+  struct aywrite *writelog;
+
+  // Audio clock, for pacing the emulation (see ay_audiolead)
+  Uint32          audiocycle, audioticks, synclead;
+
+  // Measured time from the emulation to the speaker, in ms
+  Uint32          latency;
 };
 
 void queuekeys( char *str );
 
 SDL_bool ay_init( struct ay8912 *ay, struct machine *oric );
+SDL_bool ay_setbuffers( struct ay8912 *ay, int samples );
+void ay_freebuffers( struct ay8912 *ay );
 void ay_callback( void *dummy, Sint8 *stream, int length );
+void ay_headlessaudio( struct ay8912 *ay );
+void ay_setstereo( struct ay8912 *ay, int mode );
+void ay_restore( struct ay8912 *ay );
+SDL_bool ay_initheadless( struct ay8912 *ay, int rate, int samples );
 void ay_ticktock( struct ay8912 *ay, int cycles );
 void ay_update_keybits( struct ay8912 *ay );
 void ay_keypress( struct ay8912 *ay, SDL_COMPAT_KEY key, SDL_bool down );
@@ -119,3 +166,6 @@ void ay_modeset( struct ay8912 *ay );
 void ay_lockaudio( struct ay8912 *ay );
 void ay_unlockaudio( struct ay8912 *ay );
 void ay_flushlog( struct ay8912 *ay );
+void ay_logevent( struct ay8912 *ay, Uint8 reg, Uint8 val );
+SDL_bool ay_audiosync_wanted( struct machine *oric );
+SDL_bool ay_audiolead( struct ay8912 *ay, Sint32 *lead );
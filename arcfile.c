@@ -0,0 +1,773 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Reading images from plain files, .gz files and .zip archives
+**
+**  An arcfile reads the same way whatever it was opened from. Deflated
+**  data is inflated as it is read, so nothing is unpacked until someone
+**  asks for it. Deflate streams only go forwards, so seeking backwards
+**  starts again from the beginning.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "system.h"
+#include "arcfile.h"
+
+// Extensions of the files worth looking at inside a .zip
+char *arc_tapeexts[]  = { ".tap", ".ort", ".wav", NULL };
+char *arc_diskexts[]  = { ".dsk", NULL };
+char *arc_imageexts[] = { ".dsk", ".tap", ".ort", ".wav", NULL };
+
+static Uint32 crctab[256];
+static SDL_bool crcready = SDL_FALSE;
+
+static const Uint16 lbase[29]  = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const Uint8  lextra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const Uint16 dbase[30]  = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                   257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                   8193, 12289, 16385, 24577 };
+static const Uint8  dextra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                   7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const Uint8 clorder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static Uint32 get16l( Uint8 *p )
+{
+  return (p[1]<<8)|p[0];
+}
+
+static Uint32 get32l( Uint8 *p )
+{
+  return (p[3]<<24)|(p[2]<<16)|(p[1]<<8)|p[0];
+}
+
+static void arc_initcrc( void )
+{
+  Uint32 c;
+  int i, j;
+
+  if( crcready ) return;
+
+  for( i=0; i<256; i++ )
+  {
+    c = i;
+    for( j=0; j<8; j++ )
+      c = (c&1) ? (0xedb88320^(c>>1)) : (c>>1);
+    crctab[i] = c;
+  }
+  crcready = SDL_TRUE;
+}
+
+// CRC-32, as used by gzip and zip. Start with crc = 0.
+Uint32 arc_crc( Uint32 crc, Uint8 *p, Uint32 len )
+{
+  arc_initcrc();
+  crc = ~crc;
+  while( len-- )
+    crc = crctab[(crc^*(p++))&0xff]^(crc>>8);
+  return ~crc;
+}
+
+/******************** Inflate *********************/
+
+// Get another byte of compressed data into the bit buffer
+static SDL_bool inf_morebits( struct arcfile *a )
+{
+  struct arc_inflater *inf = a->inf;
+  Uint32 n;
+
+  if( inf->inpos >= inf->inlen )
+  {
+    n = ( inf->inleft > ARC_INBUFLEN ) ? ARC_INBUFLEN : inf->inleft;
+    if( ( !n ) || ( fread( inf->inbuf, n, 1, a->f ) != 1 ) )
+      return SDL_FALSE;
+    inf->inleft -= n;
+    inf->inpos = 0;
+    inf->inlen = n;
+  }
+
+  inf->bitbuf |= inf->inbuf[inf->inpos++] << inf->bitcnt;
+  inf->bitcnt += 8;
+  return SDL_TRUE;
+}
+
+static Uint32 inf_bits( struct arcfile *a, int n )
+{
+  struct arc_inflater *inf = a->inf;
+  Uint32 v;
+
+  while( inf->bitcnt < n )
+  {
+    if( !inf_morebits( a ) )
+    {
+      inf->failed = SDL_TRUE;
+      return 0;
+    }
+  }
+
+  v = inf->bitbuf & ((1<<n)-1);
+  inf->bitbuf >>= n;
+  inf->bitcnt -= n;
+  return v;
+}
+
+// Make a Huffman code from a list of code lengths
+static SDL_bool inf_build( struct arc_huffman *h, Uint8 *lengths, int n )
+{
+  Sint16 offs[16];
+  int i, len, left, code, sym, fill, rev;
+
+  memset( h->count, 0, sizeof( h->count ) );
+  memset( h->fast, 0, sizeof( h->fast ) );
+
+  for( i=0; i<n; i++ )
+    h->count[lengths[i]]++;
+
+  // No codes at all is only a problem if one gets used
+  if( h->count[0] == n ) return SDL_TRUE;
+
+  // Too many codes of some length?
+  left = 1;
+  for( len=1; len<16; len++ )
+  {
+    left <<= 1;
+    left -= h->count[len];
+    if( left < 0 ) return SDL_FALSE;
+  }
+
+  offs[1] = 0;
+  for( len=1; len<15; len++ )
+    offs[len+1] = offs[len] + h->count[len];
+
+  for( i=0; i<n; i++ )
+    if( lengths[i] ) h->symbol[offs[lengths[i]]++] = i;
+
+  // Short codes get looked up directly. Deflate sends codes
+  // starting at the top bit, so the index is bit reversed.
+  code = 0;
+  sym  = 0;
+  for( len=1; len<=ARC_FASTBITS; len++ )
+  {
+    for( i=0; i<h->count[len]; i++, sym++, code++ )
+    {
+      for( rev=0, fill=0; fill<len; fill++ )
+        rev |= ((code>>fill)&1)<<(len-1-fill);
+
+      for( fill=rev; fill<(1<<ARC_FASTBITS); fill+=(1<<len) )
+        h->fast[fill] = (h->symbol[sym]<<4)|len;
+    }
+    code <<= 1;
+  }
+
+  return SDL_TRUE;
+}
+
+static int inf_decode( struct arcfile *a, struct arc_huffman *h )
+{
+  struct arc_inflater *inf = a->inf;
+  int code, first, index, count, len;
+  Uint16 e;
+
+  // Near the end of the data there may not be ARC_FASTBITS left
+  while( ( inf->bitcnt < ARC_FASTBITS ) && ( inf_morebits( a ) ) ) ;
+
+  e = h->fast[inf->bitbuf&((1<<ARC_FASTBITS)-1)];
+  if( ( e ) && ( (e&15) <= inf->bitcnt ) )
+  {
+    inf->bitbuf >>= (e&15);
+    inf->bitcnt -= (e&15);
+    return e>>4;
+  }
+
+  // Longer codes, a bit at a time
+  code = first = index = 0;
+  for( len=1; len<16; len++ )
+  {
+    code |= inf_bits( a, 1 );
+    if( inf->failed ) return -1;
+
+    count = h->count[len];
+    if( code - count < first )
+      return h->symbol[index + (code-first)];
+
+    index += count;
+    first += count;
+    first <<= 1;
+    code  <<= 1;
+  }
+
+  inf->failed = SDL_TRUE;
+  return -1;
+}
+
+static SDL_bool inf_dynamic( struct arcfile *a )
+{
+  struct arc_inflater *inf = a->inf;
+  Uint8 lengths[286+30];
+  int nlen, ndist, ncode, i, sym, len, rep;
+
+  nlen  = inf_bits( a, 5 ) + 257;
+  ndist = inf_bits( a, 5 ) + 1;
+  ncode = inf_bits( a, 4 ) + 4;
+  if( ( inf->failed ) || ( nlen > 286 ) || ( ndist > 30 ) ) return SDL_FALSE;
+
+  // The code lengths are themselves Huffman coded
+  memset( lengths, 0, sizeof( lengths ) );
+  for( i=0; i<ncode; i++ )
+    lengths[clorder[i]] = inf_bits( a, 3 );
+  if( ( inf->failed ) || ( !inf_build( &inf->lit, lengths, 19 ) ) ) return SDL_FALSE;
+
+  i = 0;
+  while( i < nlen+ndist )
+  {
+    sym = inf_decode( a, &inf->lit );
+    if( sym < 0 ) return SDL_FALSE;
+
+    if( sym < 16 )
+    {
+      lengths[i++] = sym;
+      continue;
+    }
+
+    len = 0;
+    switch( sym )
+    {
+      case 16:
+        if( !i ) return SDL_FALSE;
+        len = lengths[i-1];
+        rep = 3 + inf_bits( a, 2 );
+        break;
+
+      case 17:
+        rep = 3 + inf_bits( a, 3 );
+        break;
+
+      default:
+        rep = 11 + inf_bits( a, 7 );
+        break;
+    }
+    if( ( inf->failed ) || ( i+rep > nlen+ndist ) ) return SDL_FALSE;
+    while( rep-- ) lengths[i++] = len;
+  }
+
+  // No end of block code?
+  if( !lengths[256] ) return SDL_FALSE;
+
+  return ( inf_build( &inf->lit, lengths, nlen ) &&
+           inf_build( &inf->dist, &lengths[nlen], ndist ) );
+}
+
+static SDL_bool inf_fixed( struct arcfile *a )
+{
+  struct arc_inflater *inf = a->inf;
+  Uint8 lengths[288];
+  int i;
+
+  for( i=0;   i<144; i++ ) lengths[i] = 8;
+  for( ; i<256; i++ ) lengths[i] = 9;
+  for( ; i<280; i++ ) lengths[i] = 7;
+  for( ; i<288; i++ ) lengths[i] = 8;
+  inf_build( &inf->lit, lengths, 288 );
+
+  for( i=0; i<30; i++ ) lengths[i] = 5;
+  inf_build( &inf->dist, lengths, 30 );
+  return SDL_TRUE;
+}
+
+// Start a new block
+static SDL_bool inf_header( struct arcfile *a )
+{
+  struct arc_inflater *inf = a->inf;
+  Uint32 len, nlen;
+
+  inf->lastblock = inf_bits( a, 1 );
+  inf->btype     = inf_bits( a, 2 );
+  if( inf->failed ) return SDL_FALSE;
+
+  switch( inf->btype )
+  {
+    case 0:
+      // Stored blocks start on a byte boundary
+      inf->bitbuf >>= (inf->bitcnt&7);
+      inf->bitcnt -= (inf->bitcnt&7);
+      len  = inf_bits( a, 16 );
+      nlen = inf_bits( a, 16 );
+      if( ( inf->failed ) || ( len != ((~nlen)&0xffff) ) ) break;
+      inf->storedleft = len;
+      return SDL_TRUE;
+
+    case 1:
+      return inf_fixed( a );
+
+    case 2:
+      if( inf_dynamic( a ) ) return SDL_TRUE;
+      break;
+  }
+
+  inf->failed = SDL_TRUE;
+  return SDL_FALSE;
+}
+
+static void inf_endblock( struct arc_inflater *inf )
+{
+  inf->btype = -1;
+  if( inf->lastblock )
+    inf->done = SDL_TRUE;
+}
+
+static void inf_out( struct arc_inflater *inf, Uint8 *out, Uint32 *n, Uint8 c )
+{
+  inf->window[(inf->total++)&(ARC_WINDOWLEN-1)] = c;
+  out[(*n)++] = c;
+}
+
+// Inflate up to "len" bytes
+static Uint32 inf_read( struct arcfile *a, Uint8 *out, Uint32 len )
+{
+  struct arc_inflater *inf = a->inf;
+  Uint32 n = 0;
+  int sym;
+
+  while( ( n < len ) && ( !inf->failed ) )
+  {
+    // Finish off a match
+    if( inf->copylen )
+    {
+      while( ( inf->copylen ) && ( n < len ) )
+      {
+        inf_out( inf, out, &n, inf->window[(inf->total-inf->copydist)&(ARC_WINDOWLEN-1)] );
+        inf->copylen--;
+      }
+      continue;
+    }
+
+    if( inf->btype < 0 )
+    {
+      if( ( inf->done ) || ( !inf_header( a ) ) ) break;
+      continue;
+    }
+
+    if( inf->btype == 0 )
+    {
+      if( !inf->storedleft )
+      {
+        inf_endblock( inf );
+        continue;
+      }
+
+      sym = inf_bits( a, 8 );
+      if( inf->failed ) break;
+      inf_out( inf, out, &n, sym );
+      inf->storedleft--;
+      continue;
+    }
+
+    sym = inf_decode( a, &inf->lit );
+    if( sym < 0 ) break;
+
+    if( sym < 256 )
+    {
+      inf_out( inf, out, &n, sym );
+    }
+    else if( sym == 256 )
+    {
+      inf_endblock( inf );
+    }
+    else
+    {
+      sym -= 257;
+      if( sym >= 29 )
+      {
+        inf->failed = SDL_TRUE;
+        break;
+      }
+      inf->copylen = lbase[sym] + inf_bits( a, lextra[sym] );
+
+      sym = inf_decode( a, &inf->dist );
+      if( ( sym < 0 ) || ( sym >= 30 ) )
+      {
+        inf->failed = SDL_TRUE;
+        break;
+      }
+      inf->copydist = dbase[sym] + inf_bits( a, dextra[sym] );
+
+      // Pointing back before the start?
+      if( (Uint32)inf->copydist > inf->total )
+        inf->failed = SDL_TRUE;
+    }
+  }
+
+  return n;
+}
+
+/******************** Containers *********************/
+
+static SDL_bool arc_hasext( char *name, int len, char *ext )
+{
+  int elen = (int)strlen( ext );
+  int i;
+
+  if( len <= elen ) return SDL_FALSE;
+  for( i=0; i<elen; i++ )
+    if( tolower( (unsigned char)name[len-elen+i] ) != tolower( (unsigned char)ext[i] ) )
+      return SDL_FALSE;
+  return SDL_TRUE;
+}
+
+static SDL_bool arc_wanted( char *name, int len, char **exts )
+{
+  int i;
+
+  if( ( len < 1 ) || ( name[len-1] == '/' ) ) return SDL_FALSE;
+  if( !exts ) return SDL_TRUE;
+
+  for( i=0; exts[i]; i++ )
+    if( arc_hasext( name, len, exts[i] ) )
+      return SDL_TRUE;
+  return SDL_FALSE;
+}
+
+static SDL_bool arc_opengz( struct arcfile *a, char *fname, Uint32 filelen, char **exts )
+{
+  Uint8 b[10];
+  int c, i;
+
+  if( ( fseek( a->f, 0, SEEK_SET ) != 0 ) || ( fread( b, 10, 1, a->f ) != 1 ) || ( b[2] != 8 ) )
+    return SDL_FALSE;
+
+  // Skip the optional bits
+  if( b[3] & 4 )
+  {
+    if( fread( b, 2, 1, a->f ) != 1 ) return SDL_FALSE;
+    fseek( a->f, get16l( b ), SEEK_CUR );
+  }
+  for( i=8; i<=16; i<<=1 )
+  {
+    if( b[3] & i )
+    {
+      do { c = fgetc( a->f ); } while( ( c != 0 ) && ( c != EOF ) );
+      if( c == EOF ) return SDL_FALSE;
+    }
+  }
+  if( b[3] & 2 )
+    fseek( a->f, 2, SEEK_CUR );
+
+  a->dataoffs = (Uint32)ftell( a->f );
+  if( a->dataoffs+8 > filelen ) return SDL_FALSE;
+  a->datalen = filelen-8-a->dataoffs;
+
+  // The trailer has the CRC and length
+  if( ( fseek( a->f, filelen-8, SEEK_SET ) != 0 ) || ( fread( b, 8, 1, a->f ) != 1 ) )
+    return SDL_FALSE;
+  a->wantcrc = get32l( &b[0] );
+  a->size    = get32l( &b[4] );
+  a->method  = 8;
+  a->type    = ARC_GZIP;
+
+  // "foo.dsk.gz" unpacks to "foo.dsk"
+  a->plainname = malloc( strlen( fname )+8 );
+  if( !a->plainname ) return SDL_FALSE;
+  strcpy( a->plainname, fname );
+  i = (int)strlen( fname );
+  if( arc_hasext( fname, i, ".gz" ) )
+    a->plainname[i-3] = 0;
+  else if( exts )
+    strcat( a->plainname, exts[0] );
+  return SDL_TRUE;
+}
+
+static SDL_bool arc_openzip( struct arcfile *a, char *fname, Uint32 filelen, char **exts )
+{
+  Uint8 *buf, *p, lh[30];
+  Uint32 buflen, cdoffs, cdlen, nlen;
+  int i, entries;
+  char *member = NULL, *sep;
+
+  // Find the end of the central directory. It's at the end,
+  // apart from a comment of up to 64K.
+  buflen = ( filelen < 65557 ) ? filelen : 65557;
+  if( buflen < 22 ) return SDL_FALSE;
+  buf = malloc( buflen );
+  if( !buf ) return SDL_FALSE;
+  if( ( fseek( a->f, filelen-buflen, SEEK_SET ) != 0 ) || ( fread( buf, buflen, 1, a->f ) != 1 ) )
+  {
+    free( buf );
+    return SDL_FALSE;
+  }
+
+  for( i=buflen-22; i>=0; i-- )
+    if( get32l( &buf[i] ) == 0x06054b50 ) break;
+  if( i < 0 )
+  {
+    free( buf );
+    return SDL_FALSE;
+  }
+
+  entries = get16l( &buf[i+10] );
+  cdlen   = get32l( &buf[i+12] );
+  cdoffs  = get32l( &buf[i+16] );
+  free( buf );
+  if( ( cdoffs > filelen ) || ( cdlen > filelen-cdoffs ) ) return SDL_FALSE;
+
+  buf = malloc( cdlen+1 );
+  if( !buf ) return SDL_FALSE;
+  if( ( fseek( a->f, cdoffs, SEEK_SET ) != 0 ) || ( ( cdlen ) && ( fread( buf, cdlen, 1, a->f ) != 1 ) ) )
+  {
+    free( buf );
+    return SDL_FALSE;
+  }
+
+  // Take the first member with a name we like
+  for( p=buf; ( entries > 0 ) && ( p+46 <= buf+cdlen ); entries-- )
+  {
+    if( get32l( p ) != 0x02014b50 ) break;
+
+    nlen = get16l( &p[28] );
+    if( p+46+nlen > buf+cdlen ) break;
+
+    a->method = get16l( &p[10] );
+    if( ( ( a->method == 0 ) || ( a->method == 8 ) ) &&
+        ( arc_wanted( (char *)&p[46], nlen, exts ) ) )
+    {
+      a->wantcrc  = get32l( &p[16] );
+      a->datalen  = get32l( &p[20] );
+      a->size     = get32l( &p[24] );
+      a->dataoffs = get32l( &p[42] );
+      p[46+nlen] = 0;
+      member = (char *)&p[46];
+      break;
+    }
+
+    p += 46 + nlen + get16l( &p[30] ) + get16l( &p[32] );
+  }
+
+  if( !member )
+  {
+    free( buf );
+    return SDL_FALSE;
+  }
+
+  // The data follows the local header
+  if( ( fseek( a->f, a->dataoffs, SEEK_SET ) != 0 ) ||
+      ( fread( lh, 30, 1, a->f ) != 1 ) ||
+      ( get32l( lh ) != 0x04034b50 ) )
+  {
+    free( buf );
+    return SDL_FALSE;
+  }
+  a->dataoffs += 30 + get16l( &lh[26] ) + get16l( &lh[28] );
+  if( ( a->dataoffs > filelen ) || ( a->datalen > filelen-a->dataoffs ) )
+  {
+    free( buf );
+    return SDL_FALSE;
+  }
+  a->type = ARC_ZIP;
+
+  // "foo.zip" containing "bar/baz.dsk" unpacks to "baz.dsk" next to foo.zip
+  sep = strrchr( member, '/' );
+  if( sep ) member = sep+1;
+  a->plainname = malloc( strlen( fname )+strlen( member )+2 );
+  if( a->plainname )
+  {
+    strcpy( a->plainname, fname );
+    sep = strrchr( a->plainname, PATHSEP );
+    if( sep )
+      sep[1] = 0;
+    else
+      a->plainname[0] = 0;
+    strcat( a->plainname, member );
+  }
+  free( buf );
+
+  return ( a->plainname != NULL );
+}
+
+// Go back to the start of the data
+static SDL_bool arc_restart( struct arcfile *a )
+{
+  a->pos      = 0;
+  a->crc      = 0;
+  a->crcvalid = SDL_TRUE;
+
+  if( fseek( a->f, a->dataoffs, SEEK_SET ) != 0 )
+    return SDL_FALSE;
+
+  if( a->inf )
+  {
+    memset( a->inf, 0, sizeof( struct arc_inflater ) );
+    a->inf->inleft = a->datalen;
+    a->inf->btype  = -1;
+  }
+  return SDL_TRUE;
+}
+
+// What sort of file is it?
+int arc_detect( char *fname )
+{
+  FILE *f;
+  Uint8 b[4];
+  int type = ARC_NONE;
+
+  f = fopen( fname, "rb" );
+  if( !f ) return ARC_NONE;
+
+  if( fread( b, 4, 1, f ) == 1 )
+  {
+    if( ( b[0] == 0x1f ) && ( b[1] == 0x8b ) )
+      type = ARC_GZIP;
+    else if( ( b[0] == 'P' ) && ( b[1] == 'K' ) && ( b[2] == 3 ) && ( b[3] == 4 ) )
+      type = ARC_ZIP;
+  }
+
+  fclose( f );
+  return type;
+}
+
+// Open a file to read. If it's a .zip, the first member with one of the
+// extensions in "exts" is opened (or the first member, if "exts" is NULL).
+struct arcfile *arc_open( char *fname, char **exts )
+{
+  struct arcfile *a;
+  Uint32 filelen;
+  Uint8 b[4];
+  SDL_bool ok;
+
+  arc_initcrc();
+
+  a = malloc( sizeof( struct arcfile ) );
+  if( !a ) return NULL;
+  memset( a, 0, sizeof( struct arcfile ) );
+
+  a->f = fopen( fname, "rb" );
+  if( !a->f )
+  {
+    free( a );
+    return NULL;
+  }
+
+  fseek( a->f, 0, SEEK_END );
+  filelen = (Uint32)ftell( a->f );
+  fseek( a->f, 0, SEEK_SET );
+
+  memset( b, 0, 4 );
+  if( filelen >= 4 ) fread( b, 4, 1, a->f );
+
+  if( ( b[0] == 0x1f ) && ( b[1] == 0x8b ) )
+    ok = arc_opengz( a, fname, filelen, exts );
+  else if( ( b[0] == 'P' ) && ( b[1] == 'K' ) && ( b[2] == 3 ) && ( b[3] == 4 ) )
+    ok = arc_openzip( a, fname, filelen, exts );
+  else
+  {
+    a->type = ARC_NONE;
+    a->size = filelen;
+    ok = SDL_TRUE;
+  }
+
+  if( ( ok ) && ( a->method == 8 ) )
+  {
+    a->inf = malloc( sizeof( struct arc_inflater ) );
+    ok = ( a->inf != NULL );
+  }
+
+  if( ( !ok ) || ( !arc_restart( a ) ) )
+  {
+    arc_close( &a );
+    return NULL;
+  }
+
+  return a;
+}
+
+// Read from the current position. Returns how much was read, which is
+// only short at the end of the data or if something went wrong.
+Uint32 arc_read( struct arcfile *a, void *buf, Uint32 len )
+{
+  Uint32 n;
+
+  if( len > a->size-a->pos ) len = a->size-a->pos;
+  if( !len ) return 0;
+
+  if( a->inf )
+    n = inf_read( a, (Uint8 *)buf, len );
+  else
+    n = (Uint32)fread( buf, 1, len, a->f );
+
+  if( n < len ) a->failed = SDL_TRUE;
+
+  if( ( a->type != ARC_NONE ) && ( a->crcvalid ) )
+  {
+    a->crc = arc_crc( a->crc, (Uint8 *)buf, n );
+    if( ( a->pos+n == a->size ) && ( a->crc != a->wantcrc ) )
+      a->failed = SDL_TRUE;
+  }
+
+  a->pos += n;
+  return n;
+}
+
+SDL_bool arc_seek( struct arcfile *a, Uint32 pos )
+{
+  Uint8 skip[4096];
+  Uint32 n;
+
+  if( pos > a->size ) return SDL_FALSE;
+  if( pos == a->pos ) return SDL_TRUE;
+
+  if( !a->inf )
+  {
+    if( fseek( a->f, a->dataoffs+pos, SEEK_SET ) != 0 ) return SDL_FALSE;
+    a->pos = pos;
+    a->crc = 0;
+    a->crcvalid = ( pos == 0 );
+    return SDL_TRUE;
+  }
+
+  if( ( pos < a->pos ) && ( !arc_restart( a ) ) )
+    return SDL_FALSE;
+
+  while( a->pos < pos )
+  {
+    n = pos-a->pos;
+    if( n > sizeof( skip ) ) n = sizeof( skip );
+    if( arc_read( a, skip, n ) != n ) return SDL_FALSE;
+  }
+  return SDL_TRUE;
+}
+
+// Has everything read so far been good?
+SDL_bool arc_ok( struct arcfile *a )
+{
+  return !a->failed;
+}
+
+void arc_close( struct arcfile **a )
+{
+  if( ( !a ) || ( !(*a) ) ) return;
+
+  if( (*a)->f ) fclose( (*a)->f );
+  if( (*a)->inf ) free( (*a)->inf );
+  if( (*a)->plainname ) free( (*a)->plainname );
+  free( *a );
+  *a = NULL;
+}
@@ -0,0 +1,85 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Reading images from plain files, .gz files and .zip archives
+**
+*/
+
+#define ARC_INBUFLEN  16384
+#define ARC_WINDOWLEN 32768             // Deflate's maximum match distance
+#define ARC_FASTBITS  9                 // Codes up to this long are decoded with one lookup
+
+enum
+{
+  ARC_NONE = 0,
+  ARC_GZIP,
+  ARC_ZIP
+};
+
+// A canonical Huffman code
+struct arc_huffman
+{
+  Sint16 count[16];                     // Number of codes of each length
+  Sint16 symbol[288];                   // Symbols in code order
+  Uint16 fast[1<<ARC_FASTBITS];         // (symbol<<4)|length, or 0 for longer codes
+};
+
+// Deflate decoder state. It decodes a symbol at a time, so it can stop
+// whenever the caller has enough and carry on later.
+struct arc_inflater
+{
+  Uint8    inbuf[ARC_INBUFLEN];
+  int      inpos, inlen;
+  Uint32   inleft;                      // Compressed bytes not read from the file yet
+  Uint32   bitbuf;
+  int      bitcnt;
+
+  Uint8    window[ARC_WINDOWLEN];
+  Uint32   total;                       // Bytes decoded so far
+
+  int      btype;                       // Current block type, or -1 between blocks
+  SDL_bool lastblock, done, failed;
+  Uint32   storedleft;
+  int      copylen, copydist;
+  struct arc_huffman lit, dist;
+};
+
+struct arcfile
+{
+  FILE    *f;
+  int      type;
+  int      method;                      // 0 stored, 8 deflated (zip members)
+  Uint32   dataoffs, datalen;           // Where the (compressed) data is in the file
+  Uint32   size;                        // Uncompressed size
+  Uint32   pos;                         // Read position in the uncompressed data
+  Uint32   crc, wantcrc;
+  SDL_bool crcvalid;                    // Read straight through from the start so far
+  SDL_bool failed;
+  char    *plainname;                   // Where an uncompressed copy should go
+  struct arc_inflater *inf;
+};
+
+int arc_detect( char *fname );
+struct arcfile *arc_open( char *fname, char **exts );
+Uint32 arc_read( struct arcfile *a, void *buf, Uint32 len );
+SDL_bool arc_seek( struct arcfile *a, Uint32 pos );
+SDL_bool arc_ok( struct arcfile *a );
+void arc_close( struct arcfile **a );
+Uint32 arc_crc( Uint32 crc, Uint8 *p, Uint32 len );
+
+extern char *arc_tapeexts[], *arc_diskexts[], *arc_imageexts[];
@@ -0,0 +1,214 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  AY register dumps (YM5, YM6 and PSG)
+**
+**  Once per emulated frame the registers the CPU has written are
+**  snapshotted and appended to the file. YM files are written
+**  uncompressed and non-interleaved, so they can be streamed; most
+**  players accept them as they are, or they can be LHA packed later.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "6502.h"
+#include "via.h"
+#include "8912.h"
+#include "aydump.h"
+
+// Bits of each register the AY actually uses. The spare bits in the
+// YM formats carry effect flags, so they must be kept clear.
+static Uint8 regmask[AY_ENV_CYCLE+1] = { 0xff, 0x0f, 0xff, 0x0f, 0xff, 0x0f, 0x1f,
+                                         0xff, 0x1f, 0x1f, 0x1f, 0xff, 0xff, 0x0f };
+
+// Write a 32bit value to a stream in big-endian format
+static SDL_bool write32b( SDL_bool stillok, struct aydump_handle *dh, Uint32 val, Uint32 *rem )
+{
+  Uint8 b[4];
+  if( !stillok ) return SDL_FALSE; // Something failed earlier, so we're aborting
+  if( rem ) (*rem) = (Uint32)ftell( dh->f );
+  b[0] = val>>24;
+  b[1] = val>>16;
+  b[2] = val>>8;
+  b[3] = val;
+  return (fwrite( b, 4, 1, dh->f ) == 1);
+}
+
+// Write a 16bit value to a stream in big-endian format
+static SDL_bool write16b( SDL_bool stillok, struct aydump_handle *dh, Uint16 val )
+{
+  Uint8 b[2];
+  if( !stillok ) return SDL_FALSE; // Something failed earlier, so we're aborting
+  b[0] = val>>8;
+  b[1] = val;
+  return (fwrite( b, 2, 1, dh->f ) == 1);
+}
+
+// Write a string to a stream (with the terminator if "withnul" is set)
+static SDL_bool writestr( SDL_bool stillok, struct aydump_handle *dh, char *str, SDL_bool withnul )
+{
+  Sint32 i = (int)strlen( str ) + (withnul ? 1 : 0);
+  if( !stillok ) return SDL_FALSE; // Something failed earlier, so we're aborting
+  return (fwrite( str, i, 1, dh->f ) == 1);
+}
+
+struct aydump_handle *aydump_open( char *filename, SDL_bool is50hz )
+{
+  struct aydump_handle *dh;
+  SDL_bool ok;
+  Sint32 i;
+
+  dh = malloc( sizeof( struct aydump_handle ) );
+  if( !dh ) return NULL;
+
+  memset( dh, 0, sizeof( struct aydump_handle ) );
+
+  // The extension picks the format. Anything unknown gets YM6.
+  i = (int)strlen( filename );
+  dh->format = AYDUMP_YM6;
+  if( ( i > 3 ) && ( strcasecmp( &filename[i-4], ".psg" ) == 0 ) )
+    dh->format = AYDUMP_PSG;
+  else if( ( i > 3 ) && ( strcasecmp( &filename[i-4], ".ym5" ) == 0 ) )
+    dh->format = AYDUMP_YM5;
+
+  dh->f = fopen( filename, "wb" );
+  if( !dh->f )
+  {
+    free( dh );
+    return NULL;
+  }
+  setvbuf( dh->f, dh->buf, _IOFBF, AYDUMP_BUFSIZE );
+
+  dh->first = SDL_TRUE;
+
+  ok = SDL_TRUE;
+  if( dh->format == AYDUMP_PSG )
+  {
+    Uint8 hdr[16];
+
+    memset( hdr, 0, 16 );
+    memcpy( hdr, "PSG\x1a", 4 );
+    hdr[5] = is50hz ? 50 : 60;                      // Interrupt frequency
+    ok &= (fwrite( hdr, 16, 1, dh->f ) == 1);
+  }
+  else
+  {
+    ok &= writestr( ok, dh, (dh->format==AYDUMP_YM5) ? "YM5!" : "YM6!", SDL_FALSE );
+    ok &= writestr( ok, dh, "LeOnArD!"  , SDL_FALSE );
+    ok &= write32b( ok, dh,            0, &dh->offs_frames );   // Number of frames
+    ok &= write32b( ok, dh,            0, NULL );               // Attributes (not interleaved)
+    ok &= write16b( ok, dh,            0 );                     // Digidrums
+    ok &= write32b( ok, dh,      1000000, NULL );               // AY clock
+    ok &= write16b( ok, dh, is50hz?50:60 );                     // Player frequency
+    ok &= write32b( ok, dh,            0, NULL );               // Loop frame
+    ok &= write16b( ok, dh,            0 );                     // Additional data
+    ok &= writestr( ok, dh, filename    , SDL_TRUE );           // Song name
+    ok &= writestr( ok, dh, "Unknown"   , SDL_TRUE );           // Author
+    ok &= writestr( ok, dh, APP_NAME_FULL, SDL_TRUE );          // Comment
+  }
+
+  if( !ok )
+  {
+    fclose( dh->f );
+    free( dh );
+    return NULL;
+  }
+
+  return dh;
+}
+
+SDL_bool aydump_frame( struct aydump_handle **dh, struct ay8912 *ay )
+{
+  Uint8 regs[AYDUMP_REGS];
+  SDL_bool ok;
+  Sint32 i;
+
+  if( ( !dh ) || ( !(*dh) ) ) return SDL_FALSE;
+
+  // Snapshot what the CPU has written. The envelope shape only restarts
+  // the envelope when it is written, so YM uses 0xff for "unchanged".
+  memset( regs, 0, AYDUMP_REGS );
+  for( i=0; i<AY_ENV_CYCLE; i++ )
+    regs[i] = ay->eregs[i] & regmask[i];
+  regs[AY_ENV_CYCLE] = ay->envwritten ? (ay->eregs[AY_ENV_CYCLE] & regmask[AY_ENV_CYCLE]) : 0xff;
+  ay->envwritten = SDL_FALSE;
+
+  ok = SDL_TRUE;
+  if( (*dh)->format == AYDUMP_PSG )
+  {
+    Uint8 out[AYDUMP_REGS*2+1];
+    Sint32 n = 0;
+
+    for( i=0; i<=AY_ENV_CYCLE; i++ )
+    {
+      if( ( i == AY_ENV_CYCLE ) && ( regs[i] == 0xff ) ) continue;
+      if( ( !(*dh)->first ) && ( regs[i] == (*dh)->lastregs[i] ) && ( i != AY_ENV_CYCLE ) ) continue;
+      out[n++] = i;
+      out[n++] = regs[i];
+    }
+    out[n++] = 0xff;                                // End of frame
+    ok &= (fwrite( out, n, 1, (*dh)->f ) == 1);
+  }
+  else
+  {
+    ok &= (fwrite( regs, AYDUMP_REGS, 1, (*dh)->f ) == 1);
+  }
+
+  memcpy( (*dh)->lastregs, regs, AYDUMP_REGS );
+  (*dh)->first = SDL_FALSE;
+  (*dh)->frames++;
+
+  if( !ok )
+  {
+    aydump_close( dh );
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+void aydump_close( struct aydump_handle **dh )
+{
+  SDL_bool ok;
+  Uint8 end = 0xfd;
+
+  if( ( !dh ) || (!(*dh)) ) return;
+
+  if( (*dh)->f )
+  {
+    ok = SDL_TRUE;
+    if( (*dh)->format == AYDUMP_PSG )
+    {
+      ok &= (fwrite( &end, 1, 1, (*dh)->f ) == 1);  // End of music
+    }
+    else
+    {
+      ok &= writestr( ok, *dh, "End!", SDL_FALSE );
+      if( ok ) fseek( (*dh)->f, (*dh)->offs_frames, SEEK_SET );
+      ok &= write32b( ok, *dh, (*dh)->frames, NULL );
+    }
+
+    fclose( (*dh)->f );
+  }
+  free( (*dh) );
+  *dh = NULL;
+}
@@ -0,0 +1,43 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  AY register dumps (YM5, YM6 and PSG)
+**
+*/
+
+#define AYDUMP_YM6 0
+#define AYDUMP_YM5 1
+#define AYDUMP_PSG 2
+
+#define AYDUMP_REGS 16           // Registers per frame in a YM file
+#define AYDUMP_BUFSIZE 65536     // stdio buffer, so frames don't each hit the disk
+
+struct aydump_handle
+{
+  FILE     *f;
+  int       format;
+  Uint32    frames;
+  Uint32    offs_frames;
+  SDL_bool  first;
+  Uint8     lastregs[AYDUMP_REGS];
+  char      buf[AYDUMP_BUFSIZE];
+};
+
+struct aydump_handle *aydump_open( char *filename, SDL_bool is50hz );
+SDL_bool aydump_frame( struct aydump_handle **dh, struct ay8912 *ay );
+void aydump_close( struct aydump_handle **dh );
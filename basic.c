@@ -0,0 +1,493 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  BASIC listing injection
+**
+**  Rather than typing a listing in one key per keyboard poll, the
+**  text is tokenised here the same way the ROM would, linked into
+**  RAM at the start of the program area and the BASIC pointers are
+**  set as if the lines had been entered. The keywords are taken from
+**  the ROM itself, so the Oric-1, Atmos and Pravetz tables all work.
+**
+**  Loading a file replaces the program in memory. Pasted lines are
+**  merged into it by line number, as if they had been typed.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "6502.h"
+#include "via.h"
+#include "8912.h"
+#include "gui.h"
+#include "disk.h"
+#include "monitor.h"
+#include "6551.h"
+#include "machine.h"
+#include "basic.h"
+
+struct basicline
+{
+  int num;     // Line number
+  int seq;     // Position in the text, so later copies of a line win
+  int offs;    // Tokenised bytes in the work buffer
+  int len;
+};
+
+char *basicqueue = NULL;
+static SDL_bool basicmerge = SDL_FALSE;
+
+static char errmsg[128];
+
+// Keywords, as read from the ROM (token = 0x80 + index)
+static char keywords[128][16];
+static int numkeywords, tok_rem, tok_data;
+
+static Uint16 basic_deek( struct machine *oric, Uint16 addr )
+{
+  return oric->cpu.read( &oric->cpu, addr ) | (oric->cpu.read( &oric->cpu, addr+1 )<<8);
+}
+
+static void basic_doke( struct machine *oric, Uint16 addr, Uint16 val )
+{
+  oric->cpu.write( &oric->cpu, addr, val&0xff );
+  oric->cpu.write( &oric->cpu, addr+1, val>>8 );
+}
+
+// Find the keyword table in the ROM. It starts "END","EDIT", with
+// bit 7 set on the last letter of each word.
+static SDL_bool basic_getkeywords( struct machine *oric )
+{
+  static const Uint8 start[] = { 'E', 'N', 'D'|0x80, 'E', 'D', 'I', 'T'|0x80 };
+  int i, k;
+
+  if( oric->type == MACH_TELESTRAT )
+    return SDL_FALSE;
+
+  for( i=0; i<16384-(int)sizeof( start ); i++ )
+  {
+    if( memcmp( &oric->rom[i], start, sizeof( start ) ) == 0 )
+      break;
+  }
+  if( i >= 16384-(int)sizeof( start ) )
+    return SDL_FALSE;
+
+  numkeywords = 0;
+  tok_rem = tok_data = -1;
+  for( ; ( numkeywords < 128 ) && ( i < 16384 ) && ( oric->rom[i] ); numkeywords++ )
+  {
+    for( k=0; ( i < 16384 ) && ( k < 15 ); k++ )
+    {
+      keywords[numkeywords][k] = oric->rom[i]&0x7f;
+      if( oric->rom[i++]&0x80 ) { k++; break; }
+    }
+    keywords[numkeywords][k] = 0;
+
+    if( strcmp( keywords[numkeywords], "REM" ) == 0 )  tok_rem  = numkeywords;
+    if( strcmp( keywords[numkeywords], "DATA" ) == 0 ) tok_data = numkeywords;
+  }
+
+  return ( tok_rem != -1 ) && ( tok_data != -1 );
+}
+
+// Tokenise one line the way the ROM does: nothing inside quotes,
+// nothing after REM, and DATA items up to the next colon are left alone.
+// Digits and :; are never the start of a keyword.
+static int basic_crunch( char *src, int len, Uint8 *dst )
+{
+  SDL_bool inquote = SDL_FALSE, indata = SDL_FALSE;
+  int i=0, o=0, t, kl;
+  char c;
+
+  while( i < len )
+  {
+    c = src[i];
+    if( c == '"' )
+    {
+      inquote = !inquote;
+      dst[o++] = src[i++];
+      continue;
+    }
+
+    if( c == ':' ) indata = SDL_FALSE;
+    if( ( inquote ) || ( indata ) || ( c == ' ' ) || ( ( c >= '0' ) && ( c <= ';' ) ) )
+    {
+      dst[o++] = src[i++];
+      continue;
+    }
+
+    for( t=0; t<numkeywords; t++ )
+    {
+      kl = (int)strlen( keywords[t] );
+      if( ( kl <= len-i ) && ( strncmp( &src[i], keywords[t], kl ) == 0 ) )
+        break;
+    }
+
+    if( t >= numkeywords )
+    {
+      dst[o++] = src[i++];
+      continue;
+    }
+
+    dst[o++] = 0x80+t;
+    i += kl;
+
+    if( t == tok_rem )
+    {
+      while( i < len ) dst[o++] = src[i++];
+    }
+    else if( t == tok_data )
+    {
+      indata = SDL_TRUE;
+    }
+  }
+
+  return o;
+}
+
+static int basic_cmpline( const void *a, const void *b )
+{
+  const struct basicline *la = (const struct basicline *)a;
+  const struct basicline *lb = (const struct basicline *)b;
+
+  if( la->num != lb->num ) return la->num - lb->num;
+  return la->seq - lb->seq;
+}
+
+// Does every non-blank line start with a line number?
+SDL_bool basic_islisting( char *text )
+{
+  SDL_bool any = SDL_FALSE, linestart = SDL_TRUE;
+
+  for( ; *text; text++ )
+  {
+    if( ( *text == '\r' ) || ( *text == '\n' ) )
+    {
+      linestart = SDL_TRUE;
+      continue;
+    }
+
+    if( !linestart ) continue;
+    if( ( *text == ' ' ) || ( *text == '\t' ) ) continue;
+    if( ( *text < '0' ) || ( *text > '9' ) ) return SDL_FALSE;
+    any = SDL_TRUE;
+    linestart = SDL_FALSE;
+  }
+
+  return any;
+}
+
+// Is BASIC sitting in direct mode, rather than running a program?
+static SDL_bool basic_directmode( struct machine *oric )
+{
+  return oric->cpu.read( &oric->cpu, BASIC_CURLIN+1 ) == 0xff;
+}
+
+// Count the lines and tokenised bytes of the program in RAM.
+// Returns SDL_FALSE if the links don't hold together.
+static SDL_bool basic_sizeprogram( struct machine *oric, Uint16 start, Uint16 himem, int *numlines, int *numbytes )
+{
+  Uint16 addr, next;
+
+  *numlines = 0;
+  *numbytes = 0;
+  for( addr=start; ( next = basic_deek( oric, addr ) ) != 0; addr=next )
+  {
+    if( ( next < addr+5 ) || ( next >= himem ) )
+      return SDL_FALSE;
+    (*numlines)++;
+    *numbytes += next-addr-5;
+  }
+
+  return SDL_TRUE;
+}
+
+// Tokenise a listing and put it in RAM, either merged into the current
+// program ("merge") or in place of it. Returns NULL if it worked, or a
+// reason if it didn't.
+char *basic_inject( struct machine *oric, char *text, SDL_bool merge )
+{
+  struct basicline *lines;
+  Uint8 *tok;
+  char *p, *eol, c;
+  int numlines, oldlines, oldbytes, i, j, len, offs;
+  Uint16 start, himem, addr, next;
+
+  if( !basic_getkeywords( oric ) )
+    return "Couldn't find the BASIC keywords in the ROM";
+
+  start = basic_deek( oric, BASIC_TXTTAB );
+  himem = basic_deek( oric, BASIC_MEMSIZ );
+  if( ( start < 0x400 ) || ( himem <= start ) )
+    return "BASIC isn't ready";
+
+  oldlines = oldbytes = 0;
+  if( ( merge ) && ( !basic_sizeprogram( oric, start, himem, &oldlines, &oldbytes ) ) )
+    return "The program in memory is corrupt";
+
+  // Every line needs its link, number and terminator on top of the
+  // text, and the tokens are never longer than what they replace.
+  for( numlines=1, p=text; *p; p++ )
+    if( ( *p == '\r' ) || ( *p == '\n' ) ) numlines++;
+  len = (int)(p-text);
+
+  lines = malloc( sizeof( struct basicline ) * (numlines+oldlines) );
+  tok   = malloc( len+oldbytes+1 );
+  if( ( !lines ) || ( !tok ) )
+  {
+    if( lines ) free( lines );
+    if( tok ) free( tok );
+    return "Out of memory";
+  }
+
+  numlines = 0;
+  offs = 0;
+  for( p=text; *p; p=eol )
+  {
+    for( eol=p; ( *eol ) && ( *eol != '\r' ) && ( *eol != '\n' ); eol++ )
+    {
+      if( ( *eol == '\t' ) || ( *eol < 0x20 ) || ( (Uint8)*eol >= 0x7f ) )
+        *eol = ' ';
+    }
+    c = *eol;
+    if( c ) eol++;
+
+    while( *p == ' ' ) p++;
+    if( ( *p == '\r' ) || ( *p == '\n' ) || ( !*p ) )
+      continue;
+
+    if( ( *p < '0' ) || ( *p > '9' ) )
+    {
+      sprintf( errmsg, "Missing line number after line %d", numlines ? lines[numlines-1].num : 0 );
+      free( lines );
+      free( tok );
+      return errmsg;
+    }
+
+    for( i=0; ( *p >= '0' ) && ( *p <= '9' ); p++ )
+    {
+      i = i*10 + (*p-'0');
+      if( i > BASIC_MAXLINE )
+      {
+        free( lines );
+        free( tok );
+        return "Line number too big";
+      }
+    }
+    while( *p == ' ' ) p++;
+
+    // Line lengths are worked out with the terminator out of the way
+    j = (int)(eol-p);
+    if( ( c ) && ( j > 0 ) ) j--;
+
+    lines[numlines].num  = i;
+    lines[numlines].seq  = numlines;
+    lines[numlines].offs = offs;
+    lines[numlines].len  = basic_crunch( p, j, &tok[offs] );
+    if( lines[numlines].len > BASIC_MAXLEN )
+    {
+      free( lines );
+      free( tok );
+      sprintf( errmsg, "Line %d is too long", i );
+      return errmsg;
+    }
+    offs += lines[numlines].len;
+    numlines++;
+  }
+
+  // The lines already in memory go in ahead of the new ones
+  // (negative "seq"), so a new line with the same number wins
+  if( merge )
+  {
+    for( i=0, addr=start; i<oldlines; i++, addr=next )
+    {
+      next = basic_deek( oric, addr );
+      lines[numlines].num  = basic_deek( oric, addr+2 );
+      lines[numlines].seq  = i-oldlines;
+      lines[numlines].offs = offs;
+      for( j=0; ( j < next-addr-5 ) && ( ( tok[offs+j] = oric->cpu.read( &oric->cpu, addr+4+j ) ) != 0 ); j++ ) ;
+      lines[numlines].len  = j;
+      offs += j;
+      numlines++;
+    }
+  }
+
+  qsort( lines, numlines, sizeof( struct basicline ), basic_cmpline );
+
+  // A repeated line number replaces the earlier one, and one on its
+  // own deletes it, just like typing them in.
+  for( i=0, j=0; i<numlines; i++ )
+  {
+    if( ( i+1 < numlines ) && ( lines[i+1].num == lines[i].num ) )
+      continue;
+    if( lines[i].len )
+      lines[j++] = lines[i];
+  }
+  numlines = j;
+
+  for( i=0, addr=start; i<numlines; i++ )
+    addr += lines[i].len + 5;
+  if( (int)addr + 2 >= (int)himem )
+  {
+    free( lines );
+    free( tok );
+    return "Program too big for the space below HIMEM";
+  }
+
+  oric->cpu.write( &oric->cpu, start-1, 0 );
+  for( i=0, addr=start; i<numlines; i++ )
+  {
+    next = addr + lines[i].len + 5;
+    basic_doke( oric, addr, next );
+    basic_doke( oric, addr+2, lines[i].num );
+    for( j=0; j<lines[i].len; j++ )
+      oric->cpu.write( &oric->cpu, addr+4+j, tok[lines[i].offs+j] );
+    oric->cpu.write( &oric->cpu, addr+4+j, 0 );
+    addr = next;
+  }
+  basic_doke( oric, addr, 0 );
+  addr += 2;
+
+  // Same as CLEAR: no variables, arrays or strings
+  basic_doke( oric, BASIC_VARTAB, addr );
+  basic_doke( oric, BASIC_ARYTAB, addr );
+  basic_doke( oric, BASIC_STREND, addr );
+  basic_doke( oric, BASIC_FRETOP, himem );
+
+  free( lines );
+  free( tok );
+  return NULL;
+}
+
+static char *basic_readfile( char *fname, char **text )
+{
+  FILE *f;
+  long len;
+
+  f = fopen( fname, "rb" );
+  if( !f )
+  {
+    sprintf( errmsg, "Unable to open '%.80s'", fname );
+    return errmsg;
+  }
+
+  fseek( f, 0, SEEK_END );
+  len = ftell( f );
+  fseek( f, 0, SEEK_SET );
+
+  *text = malloc( len+1 );
+  if( !*text )
+  {
+    fclose( f );
+    return "Out of memory";
+  }
+
+  if( ( len > 0 ) && ( fread( *text, len, 1, f ) != 1 ) )
+  {
+    fclose( f );
+    free( *text );
+    sprintf( errmsg, "Unable to read '%.80s'", fname );
+    return errmsg;
+  }
+  fclose( f );
+  (*text)[len] = 0;
+
+  if( !basic_islisting( *text ) )
+  {
+    free( *text );
+    sprintf( errmsg, "'%.80s' isn't a BASIC listing", fname );
+    return errmsg;
+  }
+
+  return NULL;
+}
+
+// Load a listing into RAM right now (from the monitor)
+char *basic_injectfile( struct machine *oric, char *fname )
+{
+  char *text, *err;
+
+  if( ( err = basic_readfile( fname, &text ) ) )
+    return err;
+
+  err = basic_inject( oric, text, SDL_FALSE );
+  free( text );
+  return err;
+}
+
+// Load a listing when BASIC is next waiting for a key
+char *basic_queuefile( struct machine *oric, char *fname )
+{
+  char *text, *err;
+
+  if( ( err = basic_readfile( fname, &text ) ) )
+    return err;
+
+  if( basicqueue ) free( basicqueue );
+  basicqueue = text;
+  basicmerge = SDL_FALSE;
+  return NULL;
+}
+
+void basic_queue( char *text, SDL_bool merge )
+{
+  char *copy = strdup( text );
+  if( !copy ) return;
+
+  if( basicqueue ) free( basicqueue );
+  basicqueue = copy;
+  basicmerge = merge;
+}
+
+// Pasted text: listings go straight in, anything else is typed
+void basic_paste( struct machine *oric, char *text )
+{
+  if( basic_islisting( text ) )
+    basic_queue( text, SDL_TRUE );
+  else
+    queuekeys( text );
+}
+
+// Called when the ROM is waiting for a key. The program is only
+// touched at the direct mode prompt, never under a running program
+// waiting in GET or KEY$. A listing from a file waits for the prompt,
+// and a pasted one is typed in, as it would have been before. If the
+// listing can't be injected, it gets typed in instead.
+void basic_poll( struct machine *oric )
+{
+  char *text = basicqueue, *p;
+  SDL_bool direct;
+
+  if( !text ) return;
+  direct = basic_directmode( oric );
+  if( ( !direct ) && ( !basicmerge ) )
+    return;
+
+  basicqueue = NULL;
+  if( ( !direct ) || ( basic_inject( oric, text, basicmerge ) ) )
+  {
+    for( p=text; *p; p++ )
+      if( *p == '\n' ) *p = '\r';
+    queuekeys( text );
+  }
+
+  free( text );
+}
@@ -0,0 +1,43 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  BASIC listing injection
+**
+*/
+
+#define BASIC_TXTTAB 0x9a        // Start of the program
+#define BASIC_VARTAB 0x9c        // Start of the simple variables
+#define BASIC_ARYTAB 0x9e        // Start of the arrays
+#define BASIC_STREND 0xa0        // End of the arrays
+#define BASIC_FRETOP 0xa2        // Bottom of the string space
+#define BASIC_MEMSIZ 0xa6        // HIMEM
+#define BASIC_CURLIN 0xa8        // Line being run (0xffxx in direct mode)
+
+#define BASIC_MAXLINE 63999      // Highest line number the ROM accepts
+#define BASIC_MAXLEN  250        // Longest tokenised line we'll write
+
+// Text waiting for the ROM to reach its keyboard wait, or NULL
+extern char *basicqueue;
+
+SDL_bool basic_islisting( char *text );
+char *basic_inject( struct machine *oric, char *text, SDL_bool merge );
+char *basic_injectfile( struct machine *oric, char *fname );
+char *basic_queuefile( struct machine *oric, char *fname );
+void basic_queue( char *text, SDL_bool merge );
+void basic_paste( struct machine *oric, char *text );
+void basic_poll( struct machine *oric );
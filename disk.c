@@ -36,6 +36,11 @@
 #include <unistd.h>
 
 #include "system.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #include "6502.h"
 #include "via.h"
 #include "8912.h"
@@ -47,10 +52,13 @@
 #include "machine.h"
 #include "msgbox.h"
 #include "filereq.h"
+#include "arcfile.h"
+#include "disksave.h"
 
 extern char diskfile[], diskpath[], filetmp[];
 extern char telediskfile[], telediskpath[];
 extern char pravdiskfile[], pravdiskpath[];
+extern char diskdeltapath[];
 extern SDL_bool refreshdisks;
 
 #define GENERAL_DISK_DEBUG 0
@@ -130,6 +138,24 @@ void diskimage_free( struct machine *oric, struct diskimage **dimg )
     }
   }
 
+  // Let the autosave writer finish
+  if( !disksave_close( &(*dimg)->writer ) )
+  {
+    char errmsg[64];
+    sprintf( errmsg, "Autosaving the disk in drive %d failed", (*dimg)->drivenum );
+    msgbox( oric, MSGBOX_OK, errmsg );
+  }
+
+  arc_close( &(*dimg)->arc );
+  if( (*dimg)->dirty ) free( (*dimg)->dirty );
+  if( (*dimg)->tracks ) free( (*dimg)->tracks );
+  if( (*dimg)->deltamap ) free( (*dimg)->deltamap );
+  if( (*dimg)->deltaname ) free( (*dimg)->deltaname );
+#ifdef HAVE_MMAP
+  if( ( (*dimg)->rawimage ) && ( (*dimg)->mapped ) )
+    munmap( (*dimg)->rawimage, (*dimg)->rawimagelen );
+  else
+#endif
   if( (*dimg)->rawimage ) free( (*dimg)->rawimage );
   free( *dimg );
   (*dimg) = NULL;
@@ -169,10 +195,23 @@ struct diskimage *diskimage_alloc( Uint32 rawimglen )
   dimg->cachedtrack = -1;
   dimg->cachedside  = -1;
   dimg->numsectors  = 0;
+  dimg->tracks      = NULL;
   dimg->rawimage    = buf;
   dimg->rawimagelen = rawimglen;
+  dimg->arc         = NULL;
+  dimg->inflated    = rawimglen;
   dimg->modified    = SDL_FALSE;
   dimg->modified_time = 0;
+  dimg->trackbase   = 0;
+  dimg->tracklen    = 0;
+  dimg->numdirty    = 0;
+  dimg->dirty       = NULL;
+  dimg->ondisk      = SDL_FALSE;
+  dimg->writer      = NULL;
+  dimg->mapped      = SDL_FALSE;
+  dimg->deltaname   = NULL;
+  dimg->deltabase   = 0;
+  dimg->deltamap    = NULL;
   return dimg;
 }
 
@@ -183,32 +222,77 @@ void disk_eject( struct machine *oric, int drive )
   oric->pravetz.drv[drive].pimg  = NULL;
   oric->pravetz.drv[drive].byte  = 0;
   oric->pravetz.drv[drive].dirty = SDL_FALSE;
+  memset( oric->pravetz.drv[drive].dirtytrack, 0, PRAV_TRACKS_PER_DISK );
   oric->pravetz.drv[drive].half_track = 0;
   oric->diskname[drive][0] = 0;
   disk_popup( oric, drive );
 }
 
-// Whenever a seek operation occurs, the track where the head ends up
-// is "cached". The track is located within the raw image file, and
-// all the sector address and data markers are found, and pointers
-// are remembered for each.
-void diskimage_cachetrack( struct diskimage *dimg, int track, int side )
+// Compressed images are inflated as far as they are needed. Deflate
+// can only go forwards, so this is everything up to "upto".
+SDL_bool diskimage_inflate( struct diskimage *dimg, Uint32 upto )
 {
-  Uint8 *ptr, *eot;
-  Uint32 sectorcount, n;
+  Uint32 n;
+  SDL_bool ok;
 
-  // If this track is already cached, don't waste time doing it again
-  if( ( dimg->cachedtrack == track ) &&
-      ( dimg->cachedside == side ) )
-    return;
+  if( !dimg->arc ) return SDL_TRUE;
+
+  if( upto > dimg->rawimagelen ) upto = dimg->rawimagelen;
+  if( upto <= dimg->inflated ) return SDL_TRUE;
+
+  n = arc_read( dimg->arc, &dimg->rawimage[dimg->inflated], upto-dimg->inflated );
+  dimg->inflated += n;
+  ok = arc_ok( dimg->arc );
+
+  // If it's corrupt, the rest of the disk is blank
+  if( !ok )
+  {
+    memset( &dimg->rawimage[dimg->inflated], 0, dimg->rawimagelen-dimg->inflated );
+    dimg->inflated = dimg->rawimagelen;
+  }
+
+  // All there? The archive isn't needed any more.
+  if( dimg->inflated == dimg->rawimagelen )
+    arc_close( &dimg->arc );
+
+  return ok;
+}
+
+// Find all the sector address and data markers in a track, and index
+// them by sector ID. This is only done once for each track, the first
+// time it is used. Returns NULL if the track isn't in the image.
+static struct disktrack *diskimage_indextrack( struct diskimage *dimg, int track, int side )
+{
+  struct disktrack *dt;
+  Uint8 *trk, *ptr, *eot;
+  Uint32 sectorcount, n, i;
+
+  if( ( track < 0 ) || ( track >= (int)dimg->numtracks ) ||
+      ( side < 0 ) || ( side >= (int)dimg->numsides ) )
+    return NULL;
+
+  if( !dimg->tracks )
+  {
+    dimg->tracks = calloc( dimg->numsides*dimg->numtracks, sizeof( struct disktrack ) );
+    if( !dimg->tracks ) return NULL;
+  }
+
+  dt = &dimg->tracks[side*dimg->numtracks+track];
+  if( dt->indexed ) return dt;
 
   // Find the start and end locations of the track within the disk image
-  ptr = &dimg->rawimage[(side*dimg->numtracks+track)*6400+256];
-  eot = &ptr[6400];
+  diskimage_inflate( dimg, (side*dimg->numtracks+track+1)*6400+256 );
+  if( (side*dimg->numtracks+track+1)*6400+256 > dimg->rawimagelen )
+    return NULL;
+  trk = &dimg->rawimage[(side*dimg->numtracks+track)*6400+256];
+  eot = &trk[6400];
+
+  memset( dt->first, DISK_NOSECTOR, sizeof( dt->first ) );
 
   // Scan through the track looking for sectors
   sectorcount = 0;
-  while( ptr < eot )
+  ptr = trk;
+  while( ( ptr < eot ) && ( sectorcount < DISK_MAXSECTORS ) )
   {
     // Search for ID mark
     while( (ptr<eot) && (ptr[0]!=0xfe) ) ptr++;
@@ -216,9 +300,10 @@ void diskimage_cachetrack( struct diskimage *dimg, int track, int side )
     // Don't exceed the bounds of this track
     if( ptr >= eot ) break;
     
-    // Store ID pointer
-    dimg->sector[sectorcount].id_ptr = ptr;
-    dimg->sector[sectorcount].data_ptr = NULL;
+    // Store ID offset
+    dt->id_offs[sectorcount] = (Uint16)(ptr-trk);
+    dt->data_offs[sectorcount] = 0;
+    dt->nextsame[sectorcount] = DISK_NOSECTOR;
     sectorcount++;
 
     // Get N value
@@ -231,15 +316,320 @@ void diskimage_cachetrack( struct diskimage *dimg, int track, int side )
     while( (ptr<eot) && (ptr[0]!=0xfb) && (ptr[0]!=0xf8) ) ptr++;
     if( ptr >= eot ) break;
 
-    // Store pointer
-    dimg->sector[sectorcount-1].data_ptr = ptr;
+    // Store offset
+    dt->data_offs[sectorcount-1] = (Uint16)(ptr-trk);
 
     // Skip data field and ID
     ptr += (1<<(n+7))+3;
   }
 
+  // Chain together sectors with the same ID, in the order they pass the head
+  for( i=sectorcount; i>0; i-- )
+  {
+    n = trk[dt->id_offs[i-1]+3];
+    dt->nextsame[i-1] = dt->first[n];
+    dt->first[n] = i-1;
+  }
+
+  dt->numsectors = sectorcount;
+  dt->indexed = SDL_TRUE;
+  return dt;
+}
+
+// Whenever a seek operation occurs, the track where the head ends up
+// is "cached". The sectors are looked up in the track index, and
+// pointers are remembered for each.
+void diskimage_cachetrack( struct diskimage *dimg, int track, int side )
+{
+  struct disktrack *dt;
+  Uint8 *trk;
+  Uint32 i;
+
+  // If this track is already cached, don't waste time doing it again
+  if( ( dimg->cachedtrack == track ) &&
+      ( dimg->cachedside == side ) )
+    return;
+
+  dimg->numsectors  = 0;
+  dimg->cachedtrack = -1;
+  dimg->cachedside  = -1;
+
+  dt = diskimage_indextrack( dimg, track, side );
+  if( !dt ) return;
+
+  trk = &dimg->rawimage[(side*dimg->numtracks+track)*6400+256];
+  for( i=0; i<dt->numsectors; i++ )
+  {
+    dimg->sector[i].id_ptr   = &trk[dt->id_offs[i]];
+    dimg->sector[i].data_ptr = dt->data_offs[i] ? &trk[dt->data_offs[i]] : NULL;
+  }
+
   // Remember how many sectors we have successfully cached
-  dimg->numsectors = sectorcount;
+  dimg->numsectors  = dt->numsectors;
+  dimg->cachedtrack = track;
+  dimg->cachedside  = side;
+}
+
+// A track has been written over, so it has to be scanned again
+void diskimage_trackchanged( struct diskimage *dimg, int track, int side )
+{
+  if( ( !dimg->tracks ) ||
+      ( track < 0 ) || ( track >= (int)dimg->numtracks ) ||
+      ( side < 0 ) || ( side >= (int)dimg->numsides ) )
+    return;
+
+  dimg->tracks[side*dimg->numtracks+track].indexed = SDL_FALSE;
+
+  if( ( dimg->cachedtrack == track ) && ( dimg->cachedside == side ) )
+  {
+    dimg->cachedtrack = -1;
+    dimg->cachedside  = -1;
+    diskimage_cachetrack( dimg, track, side );
+  }
+}
+
+// Work out where the tracks are in the raw image, so that they can be
+// saved one at a time.
+static void diskimage_settracks( struct machine *oric, struct diskimage *dimg )
+{
+  if( !dimg->dirty )
+  {
+    if( oric->drivetype == DRV_PRAVETZ )
+    {
+      dimg->trackbase = 0;
+      dimg->tracklen  = PRAV_BYTES_PER_SECTOR*PRAV_SECTORS_PER_TRACK;
+    } else {
+      dimg->trackbase = 256;
+      dimg->tracklen  = 6400;
+    }
+
+    dimg->numdirty = 0;
+    if( dimg->rawimagelen > dimg->trackbase )
+      dimg->numdirty = (dimg->rawimagelen-dimg->trackbase+dimg->tracklen-1)/dimg->tracklen;
+
+    dimg->dirty = malloc( dimg->numdirty+1 );
+    if( !dimg->dirty ) return;
+  }
+
+  memset( dimg->dirty, 0, dimg->numdirty+1 );
+}
+
+// Note that the track holding rawimage[offs] needs saving
+void diskimage_markdirty( struct diskimage *dimg, Uint32 offs )
+{
+  Uint32 track;
+
+  if( ( !dimg->dirty ) || ( offs < dimg->trackbase ) ) return;
+
+  track = (offs-dimg->trackbase)/dimg->tracklen;
+  if( track < dimg->numdirty )
+    dimg->dirty[track] = 1;
+}
+
+// Swap a mapped image for a copy in memory, so that the file
+// can be rewritten from it
+static SDL_bool diskimage_unmap( struct diskimage *dimg )
+{
+#ifdef HAVE_MMAP
+  Uint8 *buf;
+
+  if( !dimg->mapped ) return SDL_TRUE;
+
+  buf = malloc( dimg->rawimagelen );
+  if( !buf ) return SDL_FALSE;
+
+  memcpy( buf, dimg->rawimage, dimg->rawimagelen );
+  munmap( dimg->rawimage, dimg->rawimagelen );
+  dimg->rawimage = buf;
+  dimg->mapped   = SDL_FALSE;
+
+  // Point the cached sectors at the copy (the controller
+  // could be part way through one)
+  if( dimg->cachedtrack != -1 )
+  {
+    int track = dimg->cachedtrack, side = dimg->cachedside;
+    dimg->cachedtrack = -1;
+    diskimage_cachetrack( dimg, track, side );
+  }
+#endif
+  return SDL_TRUE;
+}
+
+// Hand the changed tracks over to the background writer (starting it if
+// necessary). With a delta file, they go in there along with the track map.
+static SDL_bool diskimage_queuedirty( struct diskimage *dimg )
+{
+  Uint32 i, offs, len;
+
+  if( !dimg->dirty ) return SDL_FALSE;
+
+  if( !dimg->writer )
+  {
+    dimg->writer = disksave_open( dimg->deltaname ? dimg->deltaname : dimg->filename );
+    if( !dimg->writer ) return SDL_FALSE;
+  }
+
+  for( i=0; i<dimg->numdirty; i++ )
+  {
+    if( !dimg->dirty[i] ) continue;
+
+    offs = dimg->trackbase + i*dimg->tracklen;
+    len  = dimg->tracklen;
+    if( len > dimg->rawimagelen-offs ) len = dimg->rawimagelen-offs;
+
+    if( !disksave_queue( dimg->writer, dimg->deltabase+offs, &dimg->rawimage[offs], len ) )
+    {
+      disksave_close( &dimg->writer );
+      return SDL_FALSE;
+    }
+    dimg->dirty[i] = 0;
+    if( dimg->deltamap ) dimg->deltamap[i] = 1;
+  }
+
+  if( ( dimg->deltamap ) &&
+      ( !disksave_queue( dimg->writer, DISK_DELTAHDR, dimg->deltamap, dimg->numdirty ) ) )
+  {
+    disksave_close( &dimg->writer );
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+// A write into the delta file went wrong, so everything that should be
+// in there has to be written again
+static void diskimage_redirty( struct diskimage *dimg )
+{
+  Uint32 i;
+
+  if( ( !dimg->dirty ) || ( !dimg->deltamap ) ) return;
+
+  for( i=0; i<dimg->numdirty; i++ )
+    dimg->dirty[i] |= dimg->deltamap[i];
+}
+
+// Stop saving changes into a delta file
+static void diskimage_dropdelta( struct diskimage *dimg )
+{
+  if( dimg->deltamap ) free( dimg->deltamap );
+  if( dimg->deltaname ) free( dimg->deltaname );
+  dimg->deltamap  = NULL;
+  dimg->deltaname = NULL;
+  dimg->deltabase = 0;
+}
+
+// Find the delta file for an image in "diskdeltapath", and put the
+// tracks in it over the image. If there isn't one yet, it is created.
+static SDL_bool diskimage_opendelta( struct diskimage *dimg )
+{
+  FILE *f;
+  Uint8 hdr[DISK_DELTAHDR];
+  char *name;
+  Uint32 i, offs, len, crc;
+  int j;
+
+  // The delta is named after the image, in the delta directory
+  name = dimg->filename;
+  for( j=(int)strlen( dimg->filename )-1; j>=0; j-- )
+  {
+    if( ( dimg->filename[j] == '/' ) || ( dimg->filename[j] == '\\' ) || ( dimg->filename[j] == ':' ) )
+    {
+      name = &dimg->filename[j+1];
+      break;
+    }
+  }
+
+  dimg->deltaname = malloc( strlen( diskdeltapath ) + strlen( name ) + strlen( DISK_DELTAEXT ) + 2 );
+  dimg->deltamap  = malloc( dimg->numdirty+1 );
+  if( ( !dimg->deltaname ) || ( !dimg->deltamap ) || ( !dimg->dirty ) )
+  {
+    diskimage_dropdelta( dimg );
+    return SDL_FALSE;
+  }
+
+  strcpy( dimg->deltaname, diskdeltapath );
+  j = (int)strlen( dimg->deltaname );
+  if( ( j > 0 ) && ( dimg->deltaname[j-1] != '/' ) && ( dimg->deltaname[j-1] != '\\' ) && ( dimg->deltaname[j-1] != ':' ) )
+    strcat( dimg->deltaname, "/" );
+  strcat( dimg->deltaname, name );
+  strcat( dimg->deltaname, DISK_DELTAEXT );
+
+  dimg->deltabase = (DISK_DELTAHDR+dimg->numdirty+DISK_DELTAALIGN-1)&~(DISK_DELTAALIGN-1);
+  memset( dimg->deltamap, 0, dimg->numdirty+1 );
+
+  // The image is still as it was loaded, so this identifies it
+  diskimage_inflate( dimg, dimg->rawimagelen );
+  crc = arc_crc( 0, dimg->rawimage, dimg->rawimagelen );
+
+  // Finish off an autosave into it that was cut short
+  if( !disksave_recover( dimg->deltaname ) )
+  {
+    diskimage_dropdelta( dimg );
+    return SDL_FALSE;
+  }
+
+  f = fopen( dimg->deltaname, "rb" );
+  if( !f )
+  {
+    // No changes yet. Write an empty one for the autosave to update.
+    memcpy( hdr, DISK_DELTAMAGIC, 8 );
+    for( i=0; i<4; i++ )
+    {
+      hdr[8+i]  = (dimg->rawimagelen>>(i*8))&0xff;
+      hdr[12+i] = (dimg->numdirty>>(i*8))&0xff;
+      hdr[16+i] = (crc>>(i*8))&0xff;
+    }
+
+    f = fopen( dimg->deltaname, "wb" );
+    if( ( !f ) ||
+        ( fwrite( hdr, DISK_DELTAHDR, 1, f ) != 1 ) ||
+        ( fwrite( dimg->deltamap, dimg->numdirty, 1, f ) != 1 ) )
+    {
+      if( f ) fclose( f );
+      diskimage_dropdelta( dimg );
+      return SDL_FALSE;
+    }
+    fclose( f );
+    return SDL_TRUE;
+  }
+
+  // Is it the delta for this image?
+  if( ( fread( hdr, DISK_DELTAHDR, 1, f ) != 1 ) ||
+      ( memcmp( hdr, DISK_DELTAMAGIC, 8 ) != 0 ) ||
+      ( ((hdr[11]<<24)|(hdr[10]<<16)|(hdr[9]<<8)|hdr[8]) != dimg->rawimagelen ) ||
+      ( ((hdr[15]<<24)|(hdr[14]<<16)|(hdr[13]<<8)|hdr[12]) != dimg->numdirty ) ||
+      ( (((Uint32)hdr[19]<<24)|(hdr[18]<<16)|(hdr[17]<<8)|hdr[16]) != crc ) ||
+      ( fread( dimg->deltamap, dimg->numdirty, 1, f ) != 1 ) )
+  {
+    fclose( f );
+    diskimage_dropdelta( dimg );
+    return SDL_FALSE;
+  }
+
+  // Only the tracks that changed are copied over the image (and so
+  // only their pages of a mapped image stop being shared)
+  for( i=0; i<dimg->numdirty; i++ )
+  {
+    if( !dimg->deltamap[i] ) continue;
+
+    offs = dimg->trackbase + i*dimg->tracklen;
+    len  = dimg->tracklen;
+    if( len > dimg->rawimagelen-offs ) len = dimg->rawimagelen-offs;
+
+    // A compressed image must be inflated past the track first
+    diskimage_inflate( dimg, offs+len );
+
+    if( ( fseek( f, dimg->deltabase+offs, SEEK_SET ) != 0 ) ||
+        ( fread( &dimg->rawimage[offs], len, 1, f ) != 1 ) )
+    {
+      fclose( f );
+      diskimage_dropdelta( dimg );
+      return SDL_FALSE;
+    }
+  }
+
+  fclose( f );
+  return SDL_TRUE;
 }
 
 // This saves a diskimage back to disk.
@@ -248,14 +638,52 @@ void diskimage_cachetrack( struct diskimage *dimg, int track, int side )
 // memory back to disk.
 SDL_bool diskimage_save( struct machine *oric, char *fname, int drive )
 {
+  struct diskimage *dimg = oric->wddisk.disk[drive];
   FILE *f;
+  SDL_bool ok;
 
   // Make sure there is a disk in the drive!
-  if( !oric->wddisk.disk[drive] ) return SDL_FALSE;
+  if( !dimg ) return SDL_FALSE;
 
   if( oric->drivetype == DRV_PRAVETZ )
     disk_pravetz_write_image(&oric->pravetz.drv[drive]);
 
+  // Saving it where it came from only needs the tracks that changed
+  if( ( fname == dimg->filename ) && ( dimg->ondisk ) )
+  {
+    ok = diskimage_queuedirty( dimg );
+    if( !disksave_close( &dimg->writer ) ) ok = SDL_FALSE;
+
+    if( ok )
+    {
+      dimg->modified = SDL_FALSE;
+      dimg->modified_time = 0;
+      refreshdisks = SDL_TRUE;
+      return SDL_TRUE;
+    }
+
+    // The image behind a delta file is never written to
+    if( dimg->deltaname )
+    {
+      diskimage_redirty( dimg );
+      do_popup( oric, "\x14\x15Save failed" );
+      return SDL_FALSE;
+    }
+  }
+
+  // Anything still being autosaved has to be out of the way first
+  disksave_close( &dimg->writer );
+
+  // Anything not looked at yet still has to be written
+  diskimage_inflate( dimg, dimg->rawimagelen );
+
+  // The file could be the one that is mapped
+  if( !diskimage_unmap( dimg ) )
+  {
+    do_popup( oric, "\x14\x15Out of memory" );
+    return SDL_FALSE;
+  }
+
   // Open the file for writing
   f = fopen( fname, "wb" );
   if( !f )
@@ -275,66 +703,184 @@ SDL_bool diskimage_save( struct machine *oric, char *fname, int drive )
   // All done!
   fclose( f );
     
-  // If we are not just overwriting the original file, remember the new filename
+  // If we are not just overwriting the original file, remember the new filename.
+  // The new file has all the changes, so it doesn't need a delta.
   if( fname != oric->wddisk.disk[drive]->filename )
   {
     strncpy( oric->wddisk.disk[drive]->filename, fname, 4096+512 );
     oric->wddisk.disk[drive]->filename[4096+511] = 0;
+    diskimage_dropdelta( oric->wddisk.disk[drive] );
   }
 
   // The image in memory is no longer different to the last saved version
   oric->wddisk.disk[drive]->modified = SDL_FALSE;
   oric->wddisk.disk[drive]->modified_time = 0;
+  oric->wddisk.disk[drive]->ondisk = SDL_TRUE;
+  diskimage_settracks( oric, oric->wddisk.disk[drive] );
+  disksave_dropjournal( fname );
 
   // Remember to update the GUI
   refreshdisks = SDL_TRUE;
   return SDL_TRUE;
 }
 
+// Called once a frame with autosave on. A little while after the disk
+// was last written to, the tracks that changed are handed over to be
+// written into the image file in the background.
+void diskimage_autosave( struct machine *oric, int drive )
+{
+  struct diskimage *dimg = oric->wddisk.disk[drive];
+
+  if( !dimg ) return;
+
+  // Did the writer have trouble? Then the whole file needs writing
+  // (or everything in the delta file, since the image can't be).
+  if( ( dimg->writer ) && ( disksave_failed( dimg->writer ) ) )
+  {
+    disksave_close( &dimg->writer );
+    if( dimg->deltaname )
+      diskimage_redirty( dimg );
+    else
+      dimg->ondisk = SDL_FALSE;
+    if( !dimg->modified ) refreshdisks = SDL_TRUE;
+    dimg->modified = SDL_TRUE;
+  }
+
+  if( !dimg->modified ) return;
+  if( ++dimg->modified_time < DISK_AUTOSAVE_FRAMES ) return;
+
+  if( oric->drivetype == DRV_PRAVETZ )
+    disk_pravetz_write_image( &oric->pravetz.drv[drive] );
+
+  // Until the file holds the whole image, it can't be updated in place
+  if( ( !dimg->ondisk ) || ( !diskimage_queuedirty( dimg ) ) )
+  {
+    if( dimg->deltaname )
+    {
+      diskimage_redirty( dimg );
+      do_popup( oric, "\x14\x15Save failed" );
+      dimg->modified_time = 0;
+      return;
+    }
+
+    diskimage_save( oric, dimg->filename, drive );
+    return;
+  }
+
+  dimg->modified = SDL_FALSE;
+  dimg->modified_time = 0;
+  refreshdisks = SDL_TRUE;
+}
+
+// With a delta directory set, changes to a disk that has just been
+// loaded go into a delta file there, and the image itself is left alone
+static SDL_bool diskimage_loaddelta( struct machine *oric, int drive )
+{
+  if( !diskdeltapath[0] ) return SDL_TRUE;
+
+  if( !diskimage_opendelta( oric->wddisk.disk[drive] ) )
+  {
+    disk_eject( oric, drive );
+    do_popup( oric, "\x14\x15""Bad delta file" );
+    return SDL_FALSE;
+  }
+
+  oric->wddisk.disk[drive]->ondisk = SDL_TRUE;
+  return SDL_TRUE;
+}
+
 // This routine "inserts" a disk image into a virtual drive
 SDL_bool diskimage_load( struct machine *oric, char *fname, int drive )
 {
-  FILE *f;
-  Uint32 len;
+  struct arcfile *f;
+  Uint32 len, n;
+  Uint8 *mapped;
+
+  // Finish off an autosave that was cut short
+  if( !disksave_recover( fname ) )
+    do_popup( oric, "\x14\x15""Autosave recovery failed" );
 
-  // Open the file
-  f = fopen( fname, "rb" );
+  // Open the file (it can be gzipped, or the first disk image in a zip)
+  f = arc_open( fname, arc_diskexts );
   if( !f ) return SDL_FALSE;
 
   // The file exists, so eject any currently inserted disk
   disk_eject( oric, drive );
 
   // Determine the size of the disk image
-  fseek( f, 0, SEEK_END );
-  len = (int)ftell( f );
-  fseek( f, 0, SEEK_SET );
+  len = f->size;
 
   // Empty file!?
   if( len <= 0 )
   {
-    fclose( f );
+    arc_close( &f );
     return SDL_FALSE;
   }
 
-  // Allocate a new disk image structure and space for the raw image
-  oric->wddisk.disk[drive] = diskimage_alloc( len );
+  // Allocate a new disk image structure and space for the raw image.
+  // With "diskmap", a plain file is mapped copy-on-write instead, so the
+  // pages are read as they are used and shared with anything else that
+  // has it mapped. Only the pages that get written to are copied. It is
+  // off by default since touching a page of a file that has since been
+  // truncated raises SIGBUS.
+  mapped = NULL;
+#ifdef HAVE_MMAP
+  if( ( oric->diskmap ) && ( f->type == ARC_NONE ) )
+  {
+    mapped = mmap( NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno( f->f ), 0 );
+    if( mapped == MAP_FAILED ) mapped = NULL;
+  }
+#endif
+
+  oric->wddisk.disk[drive] = diskimage_alloc( mapped ? 0 : len );
   if( !oric->wddisk.disk[drive] )
   {
+#ifdef HAVE_MMAP
+    if( mapped ) munmap( mapped, len );
+#endif
     do_popup( oric, "\x14\x15""Out of memory" );
-    fclose( f );
+    arc_close( &f );
     return SDL_FALSE;
   }
 
-  // Read the image file into memory
-  if( fread( oric->wddisk.disk[drive]->rawimage, len, 1, f ) != 1 )
+  if( mapped )
   {
-    fclose( f );
-    disk_eject( oric, drive );
-    do_popup( oric, "\x14\x15""Read error" );
-    return SDL_FALSE;
+    oric->wddisk.disk[drive]->rawimage    = mapped;
+    oric->wddisk.disk[drive]->rawimagelen = len;
+    oric->wddisk.disk[drive]->inflated    = len;
+    oric->wddisk.disk[drive]->mapped      = SDL_TRUE;
+    n = len;
   }
+  else
+  {
+    // Read the image file into memory. For compressed MFM images, that's
+    // just the header for now. The tracks are inflated as they are used.
+    n = len;
+    if( ( f->type != ARC_NONE ) && ( oric->drivetype != DRV_PRAVETZ ) && ( len > 256 ) )
+      n = 256;
 
-  fclose( f );
+    if( ( arc_read( f, oric->wddisk.disk[drive]->rawimage, n ) != n ) || ( !arc_ok( f ) ) )
+    {
+      arc_close( &f );
+      disk_eject( oric, drive );
+      do_popup( oric, "\x14\x15""Read error" );
+      return SDL_FALSE;
+    }
+    oric->wddisk.disk[drive]->inflated = n;
+  }
+
+  // Remember the filename of the image for this drive. Changes to a
+  // compressed image get saved to an uncompressed one next to it.
+  strncpy( oric->wddisk.disk[drive]->filename, f->plainname ? f->plainname : fname, 4096+512 );
+  oric->wddisk.disk[drive]->filename[4096+511] = 0;
+  oric->wddisk.disk[drive]->ondisk = ( f->type == ARC_NONE );
+
+  if( n < len )
+    oric->wddisk.disk[drive]->arc = f;
+  else
+    arc_close( &f );
+
+  diskimage_settracks( oric, oric->wddisk.disk[drive] );
   
   if( oric->drivetype == DRV_PRAVETZ )
   {
@@ -359,6 +905,8 @@ SDL_bool diskimage_load( struct machine *oric, char *fname, int drive )
       return SDL_FALSE;
     }
 
+    if( !diskimage_loaddelta( oric, drive ) ) return SDL_FALSE;
+
     // Get some basic image info
     for (t_idx = 0; t_idx < PRAV_TRACKS_PER_DISK; t_idx++)
     {
@@ -407,16 +955,14 @@ SDL_bool diskimage_load( struct machine *oric, char *fname, int drive )
       do_popup( oric, "\x14\x15""Invalid disk image" );
       return SDL_FALSE;
     }
+
+    if( !diskimage_loaddelta( oric, drive ) ) return SDL_FALSE;
   }
 
   // Nobody has written to this disk yet
   oric->wddisk.disk[drive]->modified = SDL_FALSE;
   oric->wddisk.disk[drive]->modified_time = 0;
 
-  // Remember the filename of the image for this drive
-  strncpy( oric->wddisk.disk[drive]->filename, fname, 4096+512 );
-  oric->wddisk.disk[drive]->filename[4096+511] = 0;
-
   // Come up with a suitable short name for popups etc.
   if( strlen( fname ) > 31 )
   {
@@ -625,8 +1171,9 @@ void wd17xx_seek_track( struct wd17xx *wd, Uint8 track, SDL_bool dofudge )
 // the ID and data fields if the sector is found.
 struct mfmsector *wd17xx_find_sector( struct wd17xx *wd, Uint8 secid )
 {
-  int revs=0;
   struct diskimage *dimg;
+  struct disktrack *dt;
+  Uint8 s;
 
   // Save some typing...
   dimg = wd->disk[wd->c_drive];
@@ -641,26 +1188,35 @@ struct mfmsector *wd17xx_find_sector( struct wd17xx *wd, Uint8 secid )
   if( dimg->numsectors < 1 )
     return NULL;
 
-  // We do this more realistically than we need to since this is not
-  // a super-accurate emulation (for now). Never mind. Lets go
-  // around the track up to two times.
-  while( revs < 2 )
+  // The head goes around the track from the current sector until the
+  // ID turns up, so it's the next sector along with that ID (up to a
+  // whole revolution away).
+  dt = &dimg->tracks[wd->c_side*dimg->numtracks+wd->c_track];
+  if( wd->c_sector >= dimg->numsectors ) wd->c_sector %= dimg->numsectors;
+
+  s = dt->first[secid];
+  while( ( s != DISK_NOSECTOR ) && ( s <= wd->c_sector ) )
+    s = dt->nextsame[s];
+
+  if( s != DISK_NOSECTOR )
   {
-    // Move on to the next sector
-    wd->c_sector = (wd->c_sector+1)%dimg->numsectors;
+    wd->c_sector = s;
+    return &dimg->sector[wd->c_sector];
+  }
 
-    // If we passed through the start of the track, set the pulse bit in the status register
-    if( !wd->c_sector )
-    {
-      revs++;
-      wd->r_status |= WSFI_PULSE;
-    }
+  // Passing through the start of the track sets the pulse bit in the status register
+  wd->r_status |= WSFI_PULSE;
 
-    // Found the required sector?
-    if( dimg->sector[wd->c_sector].id_ptr[3] == secid )
-      return &dimg->sector[wd->c_sector];
+  s = dt->first[secid];
+  if( s != DISK_NOSECTOR )
+  {
+    wd->c_sector = s;
+    return &dimg->sector[wd->c_sector];
   }
 
+  // It went around twice without finding it
+  wd->c_sector = 0;
+
   // The search failed :-(
 #if GENERAL_DISK_DEBUG
   dbg_printf( "Couldn't find sector %u", secid );
@@ -1113,6 +1669,8 @@ void wd17xx_write( struct machine *oric, struct wd17xx *wd, unsigned short addr,
               dbg_printf( "DISK: (%04X) Write track", oric->cpu.pc-1 );
 #endif
               wd->currentop = COP_WRITE_TRACK;
+              if( wd->disk[wd->c_drive] )
+                diskimage_trackchanged( wd->disk[wd->c_drive], wd->c_track, wd->c_side );
               refreshdisks = SDL_TRUE;
               break;
           }
@@ -1144,7 +1702,13 @@ void wd17xx_write( struct machine *oric, struct wd17xx *wd, unsigned short addr,
             refreshdisks = SDL_TRUE;
             break;
           }
-          if( wd->curroffs == 0 ) wd->currsector->data_ptr[wd->curroffs++]=0xfb;
+          if( wd->curroffs == 0 )
+          {
+            // Mark the track for autosave (and the next one, if the sector runs into it)
+            diskimage_markdirty( wd->disk[wd->c_drive], (Uint32)(wd->currsector->data_ptr - wd->disk[wd->c_drive]->rawimage) );
+            diskimage_markdirty( wd->disk[wd->c_drive], (Uint32)(wd->currsector->data_ptr - wd->disk[wd->c_drive]->rawimage) + wd->currseclen + 2 );
+            wd->currsector->data_ptr[wd->curroffs++]=0xfb;
+          }
           wd->currsector->data_ptr[wd->curroffs++] = wd->r_data;
           wd->crc = calc_crc( wd->crc, wd->r_data );
           if( !wd->disk[wd->c_drive]->modified ) refreshdisks = SDL_TRUE;
@@ -80,6 +80,24 @@
 #define PRAV_TRACKS_PER_DISK          35
 #define PRAV_RAW_TRACK_SIZE           6200
 
+/******************** AUTOSAVE *********************/
+#define DISK_AUTOSAVE_FRAMES 20         // Frames after the last write before saving
+
+/******************** DELTA FILES *********************/
+// A delta file keeps the tracks one emulator has changed, so the
+// image it was loaded from is never written to.
+// Header: magic, then the image length, track count and CRC-32 of the
+// image it was made from (little-endian), then one byte per track
+// saying if it is in the file. The CRC stops a delta being put over a
+// different image that happens to have the same name and size. After that, starting at
+// the next multiple of DISK_DELTAALIGN (deltabase), is a sparse copy of
+// the image: each stored track is at deltabase plus its offset in the
+// image, and the rest is never written.
+#define DISK_DELTAEXT   ".delta"
+#define DISK_DELTAMAGIC "ORICDLTA"
+#define DISK_DELTAHDR   20
+#define DISK_DELTAALIGN 4096
+
 // Current operation
 enum
 {
@@ -106,6 +124,22 @@ struct mfmsector
   Uint8 *data_ptr;
 };
 
+#define DISK_MAXSECTORS 32              // Most sectors looked for in one track
+#define DISK_NOSECTOR   0xff
+
+// Where the sectors are in one track of a disk image. A track is scanned
+// for its ID and data marks the first time it is used, then this is
+// kept until the disk is ejected (or the track is written again).
+struct disktrack
+{
+  SDL_bool indexed;                     // Set once the track has been scanned
+  Uint8    numsectors;
+  Uint16   id_offs[DISK_MAXSECTORS];    // Offset of each ID mark in the track
+  Uint16   data_offs[DISK_MAXSECTORS];  // Offset of its data mark (or 0 for none)
+  Uint8    nextsame[DISK_MAXSECTORS];   // Next sector along with the same ID (or DISK_NOSECTOR)
+  Uint8    first[256];                  // First sector with each ID (or DISK_NOSECTOR)
+};
+
 // A disk image in memory
 // When the disk controller seeks to a track, we "cache" the entire
 // track in the sector array. This is just an array of pointers to
@@ -119,11 +153,23 @@ struct diskimage
   Sint16   cachedtrack;           // Currently cached track (or -1 for none)
   Sint16   cachedside;            // Currently cached side (or -1 for none)
   Uint32   numsectors;            // Number of sectors cached (= number of valid sectors in the current track)
-  struct   mfmsector sector[32];  // Cache of pointers to sectors
+  struct   mfmsector sector[DISK_MAXSECTORS]; // Cache of pointers to sectors
+  struct   disktrack *tracks;     // Sector index for each track and side (or NULL until one is used)
   Uint8   *rawimage;              // The raw disk image file loaded into memory
   Uint32   rawimagelen;           // Size of the raw image file
+  struct arcfile *arc;            // Compressed image still being inflated (or NULL)
+  Uint32   inflated;              // How much of rawimage has been inflated so far
   SDL_bool modified;              // Set to TRUE if the image in memory has been modified
-  Sint32   modified_time;         // Cycles since it was last modified
+  Sint32   modified_time;         // Frames since it was last modified (with autosave on)
+  Uint32   trackbase, tracklen;   // Where the tracks are in rawimage, for saving them one by one
+  Uint32   numdirty;              // Number of tracks in "dirty"
+  Uint8   *dirty;                 // Tracks written to since the last save (or NULL)
+  SDL_bool ondisk;                // "filename" holds the image as it was last saved
+  struct disksave_handle *writer; // Writes autosaved tracks in the background (or NULL)
+  SDL_bool mapped;                // rawimage is a private (copy-on-write) mapping of the file
+  char    *deltaname;             // Changes are saved to this delta file, not the image (or NULL)
+  Uint32   deltabase;             // Where the tracks start in the delta file
+  Uint8   *deltamap;              // Tracks that are in the delta file
   char     filename[4096+512];    // Full path and filename of the current image file
 };
 
@@ -191,6 +237,7 @@ struct pravetz_drive
   Uint16   half_track;
   Uint8   *sector_ptr;
   SDL_bool dirty;
+  Uint8    dirtytrack[PRAV_TRACKS_PER_DISK];
   struct diskimage *pimg;
   SDL_bool prot;
 };
@@ -208,6 +255,10 @@ struct pravetz
 SDL_bool diskimage_load( struct machine *oric, char *fname, int drive ); 
 SDL_bool diskimage_save( struct machine *oric, char *fname, int drive );
 void diskimage_cachetrack( struct diskimage *dimg, int track, int side );
+void diskimage_trackchanged( struct diskimage *dimg, int track, int side );
+SDL_bool diskimage_inflate( struct diskimage *dimg, Uint32 upto );
+void diskimage_markdirty( struct diskimage *dimg, Uint32 offs );
+void diskimage_autosave( struct machine *oric, int drive );
 struct mfmsector *wd17xx_find_sector( struct wd17xx *wd, Uint8 secid );
 
 // Call this to emulate some cycles of disk activity
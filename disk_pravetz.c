@@ -318,6 +318,10 @@ void disk_pravetz_write_image(struct pravetz_drive *d_ptr)
     tb_idx = 0;
     for (t_idx = 0; t_idx < PRAV_TRACKS_PER_DISK; t_idx++)
     {
+        /* only the tracks written to need decoding */
+        if (!d_ptr->dirtytrack[t_idx])
+            continue;
+
         sector_count = 16;
 
 find_sector:
@@ -407,12 +411,15 @@ find_sector:
                 (PRAV_BYTES_PER_SECTOR * skewing[s_idx]);
 
         memcpy(&d_ptr->pimg->rawimage[f_pos], temp_sector_buffer, PRAV_BYTES_PER_SECTOR);
+        diskimage_markdirty(d_ptr->pimg, f_pos);
         d_ptr->pimg->modified = SDL_TRUE;
         d_ptr->pimg->modified_time = 0;
         sector_count--;
 
         if (sector_count)
             goto find_sector;
+
+        d_ptr->dirtytrack[t_idx] = 0;
     }
 
     d_ptr->dirty = SDL_FALSE;
@@ -439,6 +446,7 @@ static void  disk_pravetz_writebyte(struct machine *oric, Uint8  w_byte)
         return;
 
     drv->dirty = SDL_TRUE;
+    drv->dirtytrack[drv->half_track / 2] = 1;
     drv->image[drv->half_track / 2][drv->byte] = w_byte;
 
     /*
@@ -0,0 +1,445 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Background write-back of modified disk tracks
+**
+**  Autosave hands over copies of the tracks that changed, and a thread
+**  writes them into the image file in place. Each batch goes into a
+**  journal next to the image first, so if we crash while the image is
+**  half written, the batch is finished off the next time it is loaded.
+**
+**  Journal: "OJNL", track count, then offset, length and data for each
+**  track, then an Adler-32 of everything after "OJNL". All little-endian.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+
+#if defined(HAVE_PWRITE)
+#include <unistd.h>
+#elif defined(WIN32)
+#include <io.h>
+#endif
+
+#include "disksave.h"
+
+static void disksave_putu32( Uint8 *p, Uint32 val )
+{
+  p[0] = val&0xff;
+  p[1] = (val>>8)&0xff;
+  p[2] = (val>>16)&0xff;
+  p[3] = (val>>24)&0xff;
+}
+
+static Uint32 disksave_getu32( Uint8 *p )
+{
+  return (p[3]<<24)|(p[2]<<16)|(p[1]<<8)|p[0];
+}
+
+// Adler-32
+static Uint32 disksave_sum( Uint32 sum, Uint8 *p, Uint32 len )
+{
+  Uint32 a = sum&0xffff, b = sum>>16;
+
+  while( len-- )
+  {
+    a = (a + *(p++)) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b<<16)|a;
+}
+
+static char *disksave_jnlname( char *fname )
+{
+  char *jnlname;
+
+  jnlname = malloc( strlen( fname ) + strlen( DISKSAVE_JNLEXT ) + 1 );
+  if( !jnlname ) return NULL;
+
+  strcpy( jnlname, fname );
+  strcat( jnlname, DISKSAVE_JNLEXT );
+  return jnlname;
+}
+
+static void disksave_freelist( struct disksave_track *list )
+{
+  struct disksave_track *next;
+
+  while( list )
+  {
+    next = list->next;
+    free( list );
+    list = next;
+  }
+}
+
+// Push everything written to "f" out to the disk itself
+static SDL_bool disksave_flush( FILE *f )
+{
+  if( fflush( f ) != 0 ) return SDL_FALSE;
+#if defined(HAVE_PWRITE)
+  if( fsync( fileno( f ) ) != 0 ) return SDL_FALSE;
+#elif defined(WIN32)
+  if( _commit( _fileno( f ) ) != 0 ) return SDL_FALSE;
+#endif
+  return SDL_TRUE;
+}
+
+// Write some tracks into place in an image file
+static SDL_bool disksave_apply( char *fname, struct disksave_track *list )
+{
+  FILE *f;
+  SDL_bool ok = SDL_TRUE;
+
+  f = fopen( fname, "r+b" );
+  if( !f ) return SDL_FALSE;
+
+  for( ; ( ok ) && ( list ); list = list->next )
+  {
+#ifdef HAVE_PWRITE
+    if( pwrite( fileno( f ), list->data, list->len, (off_t)list->offs ) != (ssize_t)list->len )
+      ok = SDL_FALSE;
+#else
+    if( ( fseek( f, (long)list->offs, SEEK_SET ) != 0 ) ||
+        ( fwrite( list->data, list->len, 1, f ) != 1 ) )
+      ok = SDL_FALSE;
+#endif
+  }
+
+  if( ( ok ) && ( !disksave_flush( f ) ) ) ok = SDL_FALSE;
+  if( fclose( f ) != 0 ) ok = SDL_FALSE;
+  return ok;
+}
+
+static SDL_bool disksave_putjournal( FILE *f, struct disksave_track *list )
+{
+  struct disksave_track *t;
+  Uint8 word[8];
+  Uint32 count, sum;
+
+  for( count=0, t=list; t; t=t->next )
+    count++;
+
+  disksave_putu32( word, count );
+  sum = disksave_sum( 1, word, 4 );
+  if( ( fwrite( "OJNL", 4, 1, f ) != 1 ) || ( fwrite( word, 4, 1, f ) != 1 ) )
+    return SDL_FALSE;
+
+  for( t=list; t; t=t->next )
+  {
+    disksave_putu32( &word[0], t->offs );
+    disksave_putu32( &word[4], t->len );
+    sum = disksave_sum( sum, word, 8 );
+    sum = disksave_sum( sum, t->data, t->len );
+    if( ( fwrite( word, 8, 1, f ) != 1 ) || ( fwrite( t->data, t->len, 1, f ) != 1 ) )
+      return SDL_FALSE;
+  }
+
+  disksave_putu32( word, sum );
+  return fwrite( word, 4, 1, f ) == 1;
+}
+
+// Journal, then image, then the journal goes
+static SDL_bool disksave_batch( struct disksave_handle *dh, struct disksave_track *list )
+{
+  FILE *f;
+  SDL_bool ok;
+
+  f = fopen( dh->jnlname, "wb" );
+  if( !f ) return SDL_FALSE;
+
+  ok = disksave_putjournal( f, list ) && disksave_flush( f );
+  if( fclose( f ) != 0 ) ok = SDL_FALSE;
+  if( !ok )
+  {
+    // The image hasn't been touched, so a partial journal is no use
+    remove( dh->jnlname );
+    return SDL_FALSE;
+  }
+
+  // If this fails, the journal stays for disksave_recover
+  if( !disksave_apply( dh->fname, list ) )
+    return SDL_FALSE;
+
+  remove( dh->jnlname );
+  return SDL_TRUE;
+}
+
+// The writer thread. Takes whatever is queued and writes it as one
+// batch, until told to quit.
+static int disksave_writer( void *data )
+{
+  struct disksave_handle *dh = (struct disksave_handle *)data;
+  struct disksave_track *list;
+  SDL_bool quit;
+  int i;
+
+  for( ;; )
+  {
+    SDL_mutexP( dh->mutex );
+    list = dh->queue;
+    dh->queue = NULL;
+    quit = dh->quit;
+    SDL_mutexV( dh->mutex );
+
+    if( !list )
+    {
+      if( quit ) break;
+      SDL_Delay( DISKSAVE_POLLMS );
+      continue;
+    }
+
+    if( !disksave_batch( dh, list ) )
+    {
+      SDL_mutexP( dh->mutex );
+      dh->failed = SDL_TRUE;
+      SDL_mutexV( dh->mutex );
+    }
+    disksave_freelist( list );
+
+    // Let more tracks collect, so there are fewer fsyncs. Don't hold
+    // things up when we're being closed, though.
+    for( i=0; ( !quit ) && ( i<DISKSAVE_BATCHMS/DISKSAVE_POLLMS ); i++ )
+    {
+      SDL_Delay( DISKSAVE_POLLMS );
+      SDL_mutexP( dh->mutex );
+      quit = dh->quit;
+      SDL_mutexV( dh->mutex );
+    }
+  }
+
+  return 0;
+}
+
+// Start a writer for an image file. The file must already hold the
+// whole image; only changed tracks are written to it.
+struct disksave_handle *disksave_open( char *fname )
+{
+  struct disksave_handle *dh;
+
+  dh = malloc( sizeof( struct disksave_handle ) );
+  if( !dh ) return NULL;
+  memset( dh, 0, sizeof( struct disksave_handle ) );
+
+  dh->fname = malloc( strlen( fname ) + 1 );
+  dh->jnlname = disksave_jnlname( fname );
+  dh->mutex = SDL_CreateMutex();
+  if( ( !dh->fname ) || ( !dh->jnlname ) || ( !dh->mutex ) )
+  {
+    if( dh->mutex ) SDL_DestroyMutex( dh->mutex );
+    free( dh->jnlname );
+    free( dh->fname );
+    free( dh );
+    return NULL;
+  }
+  strcpy( dh->fname, fname );
+
+  dh->thread = SDL_COMPAT_CreateThread( disksave_writer, "disksave", dh );
+  if( !dh->thread )
+  {
+    SDL_DestroyMutex( dh->mutex );
+    free( dh->jnlname );
+    free( dh->fname );
+    free( dh );
+    return NULL;
+  }
+
+  return dh;
+}
+
+// Queue a copy of a track to be written at "offs". A newer copy of a
+// track replaces one still waiting.
+SDL_bool disksave_queue( struct disksave_handle *dh, Uint32 offs, Uint8 *data, Uint32 len )
+{
+  struct disksave_track *t, **pp;
+
+  t = malloc( sizeof( struct disksave_track ) + len );
+  if( !t ) return SDL_FALSE;
+
+  t->offs = offs;
+  t->len  = len;
+  t->data = (Uint8 *)&t[1];
+  memcpy( t->data, data, len );
+
+  SDL_mutexP( dh->mutex );
+  for( pp=&dh->queue; ( *pp ) && ( (*pp)->offs < offs ); pp=&(*pp)->next )
+    ;
+  if( ( *pp ) && ( (*pp)->offs == offs ) )
+  {
+    t->next = (*pp)->next;
+    free( *pp );
+  }
+  else
+  {
+    t->next = *pp;
+  }
+  *pp = t;
+  SDL_mutexV( dh->mutex );
+
+  return SDL_TRUE;
+}
+
+// Has a batch failed to make it into the file?
+SDL_bool disksave_failed( struct disksave_handle *dh )
+{
+  SDL_bool failed;
+
+  SDL_mutexP( dh->mutex );
+  failed = dh->failed;
+  SDL_mutexV( dh->mutex );
+  return failed;
+}
+
+// Write out everything queued and stop the writer. Returns SDL_FALSE
+// if anything didn't make it into the file.
+SDL_bool disksave_close( struct disksave_handle **dh )
+{
+  SDL_bool ok;
+
+  if( ( !dh ) || ( !(*dh) ) ) return SDL_TRUE;
+
+  SDL_mutexP( (*dh)->mutex );
+  (*dh)->quit = SDL_TRUE;
+  SDL_mutexV( (*dh)->mutex );
+  SDL_WaitThread( (*dh)->thread, NULL );
+
+  ok = !(*dh)->failed;
+  disksave_freelist( (*dh)->queue );
+  SDL_DestroyMutex( (*dh)->mutex );
+  free( (*dh)->jnlname );
+  free( (*dh)->fname );
+  free( *dh );
+  *dh = NULL;
+  return ok;
+}
+
+// Split a journal into its tracks. Returns SDL_FALSE if it isn't
+// complete, or leaves "*tracks" NULL if there wasn't the memory.
+static SDL_bool disksave_parsejournal( Uint8 *buf, Uint32 len, struct disksave_track **tracks_out )
+{
+  struct disksave_track *tracks;
+  Uint32 count, pos, i;
+
+  *tracks_out = NULL;
+  if( ( len < 12 ) || ( memcmp( buf, "OJNL", 4 ) != 0 ) ) return SDL_FALSE;
+
+  count = disksave_getu32( &buf[4] );
+  if( ( count == 0 ) || ( count > len/8 ) ) return SDL_FALSE;
+
+  tracks = malloc( sizeof( struct disksave_track ) * count );
+  if( !tracks ) return SDL_TRUE;
+
+  pos = 8;
+  for( i=0; i<count; i++ )
+  {
+    if( pos+8 > len-4 ) break;
+    tracks[i].offs = disksave_getu32( &buf[pos] );
+    tracks[i].len  = disksave_getu32( &buf[pos+4] );
+    pos += 8;
+
+    if( tracks[i].len > (len-4)-pos ) break;
+    tracks[i].data = &buf[pos];
+    tracks[i].next = ( i < count-1 ) ? &tracks[i+1] : NULL;
+    pos += tracks[i].len;
+  }
+
+  if( ( i < count ) ||
+      ( pos != len-4 ) ||
+      ( disksave_sum( 1, &buf[4], pos-4 ) != disksave_getu32( &buf[pos] ) ) )
+  {
+    free( tracks );
+    return SDL_FALSE;
+  }
+
+  *tracks_out = tracks;
+  return SDL_TRUE;
+}
+
+// Finish off a batch that was interrupted, before loading an image.
+// Returns SDL_FALSE if there was one and it couldn't be applied.
+SDL_bool disksave_recover( char *fname )
+{
+  struct disksave_track *tracks;
+  char *jnlname;
+  Uint8 *buf;
+  FILE *f;
+  long len;
+  SDL_bool ok;
+
+  jnlname = disksave_jnlname( fname );
+  if( !jnlname ) return SDL_FALSE;
+
+  f = fopen( jnlname, "rb" );
+  if( !f )
+  {
+    free( jnlname );
+    return SDL_TRUE;
+  }
+
+  // Leave alone anything that isn't one of ours
+  buf = NULL;
+  len = 0;
+  if( ( fseek( f, 0, SEEK_END ) == 0 ) &&
+      ( ( len = ftell( f ) ) >= 4 ) &&
+      ( len <= DISKSAVE_MAXJNL ) &&
+      ( fseek( f, 0, SEEK_SET ) == 0 ) )
+  {
+    buf = malloc( len );
+    if( ( buf ) && ( fread( buf, len, 1, f ) != 1 ) )
+    {
+      free( buf );
+      buf = NULL;
+    }
+  }
+  fclose( f );
+
+  if( ( !buf ) || ( memcmp( buf, "OJNL", 4 ) != 0 ) )
+  {
+    if( buf ) free( buf );
+    free( jnlname );
+    return SDL_TRUE;
+  }
+
+  // An incomplete journal means the image was never touched
+  ok = SDL_TRUE;
+  if( disksave_parsejournal( buf, (Uint32)len, &tracks ) )
+    ok = ( tracks ) && ( disksave_apply( fname, tracks ) );
+  if( ok )
+    remove( jnlname );
+
+  if( tracks ) free( tracks );
+  free( buf );
+  free( jnlname );
+  return ok;
+}
+
+// Forget any unfinished batch, once the image has been written in full
+void disksave_dropjournal( char *fname )
+{
+  char *jnlname;
+
+  jnlname = disksave_jnlname( fname );
+  if( !jnlname ) return;
+
+  remove( jnlname );
+  free( jnlname );
+}
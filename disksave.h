@@ -0,0 +1,54 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Background write-back of modified disk tracks
+**
+*/
+
+#define DISKSAVE_POLLMS  20               // How often the writer looks for more
+#define DISKSAVE_BATCHMS 200              // Least time between batches (and so fsyncs)
+#define DISKSAVE_JNLEXT  ".jnl"           // Journal, next to the disk image
+#define DISKSAVE_MAXJNL  (16*1024*1024)   // Anything bigger isn't one of ours
+
+// A copy of a track, as it was when it was queued
+struct disksave_track
+{
+  struct disksave_track *next;
+  Uint32 offs, len;                       // Where it goes in the image file
+  Uint8 *data;
+};
+
+struct disksave_handle
+{
+  char       *fname, *jnlname;
+
+  // Shared with the writer thread
+  SDL_mutex  *mutex;
+  struct disksave_track *queue;           // Sorted by offset, one per track
+  SDL_bool    quit;
+  SDL_bool    failed;                     // A batch didn't make it into the file
+
+  SDL_Thread *thread;
+};
+
+struct disksave_handle *disksave_open( char *fname );
+SDL_bool disksave_queue( struct disksave_handle *dh, Uint32 offs, Uint8 *data, Uint32 len );
+SDL_bool disksave_failed( struct disksave_handle *dh );
+SDL_bool disksave_close( struct disksave_handle **dh );
+SDL_bool disksave_recover( char *fname );
+void disksave_dropjournal( char *fname );
@@ -73,7 +73,7 @@ void shut_filerequester( struct machine *oric )
 
 SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fname, int type )
 {
-  char *pat, ppat[16*2+2];
+  char *pat, ppat[32*2+2];
   BOOL dosavemode = FALSE;
   
   switch( type )
@@ -95,7 +95,7 @@ SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fna
       break;
 
     case FR_TAPELOAD:
-      pat = "#?.(tap|ort|wav)";
+      pat = "#?.(tap|ort|wav|gz|zip)";
       break;
     
     case FR_ROMS:
@@ -119,7 +119,7 @@ SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fna
       break;
   }
   
-  if( pat ) ParsePatternNoCase( pat, ppat, 16*2+2 );
+  if( pat ) ParsePatternNoCase( pat, ppat, 32*2+2 );
   
   if( !AslRequestTags( req,
          ASLFR_TitleText,     title,
@@ -80,6 +80,11 @@ SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fna
       filter = gtk_file_filter_new();
       gtk_file_filter_set_name(filter, "Disk images");
       gtk_file_filter_add_pattern(filter, "*.dsk");
+      if( type == FR_DISKLOAD )
+      {
+        gtk_file_filter_add_pattern(filter, "*.gz");
+        gtk_file_filter_add_pattern(filter, "*.zip");
+      }
       break;
 
     case FR_TAPESAVETAP:
@@ -102,6 +107,8 @@ SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fna
       gtk_file_filter_add_pattern(filter, "*.tap");
       gtk_file_filter_add_pattern(filter, "*.wav");
       gtk_file_filter_add_pattern(filter, "*.ort");
+      gtk_file_filter_add_pattern(filter, "*.gz");
+      gtk_file_filter_add_pattern(filter, "*.zip");
       break;
 
     case FR_ROMS:
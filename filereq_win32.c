@@ -73,11 +73,15 @@ SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fna
   {
     case FR_DISKSAVE:
       ofn.Flags = OFN_PATHMUSTEXIST;
-    case FR_DISKLOAD:
       ofn.lpstrFilter = "All Files\0*.*\0Disk Images (*.dsk)\0*.DSK\0";
       ofn.nFilterIndex = 2;
       break;
-    
+
+    case FR_DISKLOAD:
+      ofn.lpstrFilter = "All Files\0*.*\0Disk Images (*.dsk, *.gz, *.zip)\0*.DSK;*.GZ;*.ZIP\0";
+      ofn.nFilterIndex = 2;
+      break;
+
     case FR_TAPESAVETAP:
       ofn.Flags = OFN_PATHMUSTEXIST;
       ofn.lpstrFilter = "All Files\0*.*\0Tape Images (*.tap)\0*.TAP\0";
@@ -91,7 +95,7 @@ SDL_bool filerequester( struct machine *oric, char *title, char *path, char *fna
       break;
 
     case FR_TAPELOAD:
-      ofn.lpstrFilter = "All Files\0*.*\0Tape Images (*.tap, *.ort, *.wav)\0*.TAP;*.ORT;*.WAV\0";
+      ofn.lpstrFilter = "All Files\0*.*\0Tape Images (*.tap, *.ort, *.wav, *.gz, *.zip)\0*.TAP;*.ORT;*.WAV;*.GZ;*.ZIP\0";
       ofn.nFilterIndex = 2;
       break;
 
@@ -66,6 +66,8 @@
 #include "snapshot.h"
 #include "msgbox.h"
 #include "keyboard.h"
+#include "aydump.h"
+#include "wavcap.h"
 
 extern SDL_bool fullscreen;
 
@@ -73,6 +75,7 @@ char tapepath[4096], tapefile[512];
 char diskpath[4096], diskfile[512];
 char telediskpath[4096], telediskfile[512];
 char pravdiskpath[4096], pravdiskfile[512];
+char diskdeltapath[4096];
 extern char atmosromfile[];
 extern char oric1romfile[];
 extern char mdiscromfile[];
@@ -86,8 +89,14 @@ char filetmp[4096+512];
 SDL_bool refreshstatus = SDL_TRUE, refreshdisks = SDL_TRUE, refreshavi = SDL_TRUE, refreshtape = SDL_TRUE,
     refreshkeyboard = SDL_TRUE;
 extern struct avi_handle *vidcap;
-
-extern SDL_bool need_sdl_quit;
+extern struct aydump_handle *aydump;
+extern char aydumpname[];
+extern int aydumpcount;
+extern struct wavcap_handle *wavcap;
+extern char wavcapname[];
+extern int wavcapcount;
+
+extern SDL_bool need_sdl_quit, headless;
 extern SDL_AudioSpec obtained;
 extern Uint32 cyclespersample;
 
@@ -164,17 +173,25 @@ static char* aciabackends[ACIA_TYPE_LAST] = {
 void toggletapenoise( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglesound( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void inserttape( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void tapebrowser( struct machine *oric, struct osdmenuitem *mitem, int first );
+void tapeseek( struct machine *oric, struct osdmenuitem *mitem, int entry );
 void insertdisk( struct machine *oric, struct osdmenuitem *mitem, int drive );
 void resetoric( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void toggletapeturbo( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void toggletapeinstant( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void toggleautowind( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void toggleautoinsrt( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglesymbolsauto( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglecasesyms( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglevsynchack( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void toggleaudiosync( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void toggleaydump( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void togglewavcap( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void setaystereo( struct machine *oric, struct osdmenuitem *mitem, int mode );
 void swap_render_mode( struct machine *oric, struct osdmenuitem *mitem, int newrendermode );
 void togglehstretch( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglepalghost( struct machine *oric, struct osdmenuitem *mitem, int dummy );
+void toggleswpalghost( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglescanlines( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void togglelightpen( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void toggleaciabackend( struct machine *oric, struct osdmenuitem *mitem, int dummy );
@@ -199,6 +216,7 @@ void clipbd_paste_gui( struct machine *oric, struct osdmenuitem *mitem, int dumm
 // square brackets
 struct osdmenuitem mainitems[] = { { "Insert tape...",         "T",    't',      inserttape,      0, 0 },
                                    { "Save tape output...",    "[F9]", SDLK_F9,  toggletapecap,   0, 0 },
+                                   { "Tape contents...",       "B",    'b',      tapebrowser,     0, 0 },
                                    { "Insert disk 0...",       "0",    SDLK_0,   insertdisk,      0, 0 },
                                    { "Insert disk 1...",       "1",    SDLK_1,   insertdisk,      1, 0 },
                                    { "Insert disk 2...",       "2",    SDLK_2,   insertdisk,      2, 0 },
@@ -245,6 +263,7 @@ struct osdmenuitem hwopitems[] = { { " Oric-1",                "1",    SDLK_1,
                                    { " Pravetz 8D disk",       "P",    'p',      setdrivetype,    DRV_PRAVETZ, 0 },
                                    { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
                                    { " Turbo tape",            NULL,   0,        toggletapeturbo, 0, 0 },
+                                   { " Instant tape load",     NULL,   0,        toggletapeinstant, 0, 0 },
                                    { " Autoinsert tape",       NULL,   0,        toggleautoinsrt, 0, 0 },
                                    { " Autorewind tape",       NULL,   0,        toggleautowind,  0, 0 },
                                    { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
@@ -258,6 +277,14 @@ struct osdmenuitem hwopitems[] = { { " Oric-1",                "1",    SDLK_1,
 
 struct osdmenuitem auopitems[] = { { " Sound enabled",         NULL,   0,        togglesound,     0, 0 },
                                    { " Tape noise",            NULL,   0,        toggletapenoise, 0, 0 },
+                                   { " Audio sync",            NULL,   0,        toggleaudiosync, 0, 0 },
+                                   { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
+                                   { " Mono",                  NULL,   0,        setaystereo,     AYSTEREO_MONO, 0 },
+                                   { " ABC stereo",            NULL,   0,        setaystereo,     AYSTEREO_ABC, 0 },
+                                   { " ACB stereo",            NULL,   0,        setaystereo,     AYSTEREO_ACB, 0 },
+                                   { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
+                                   { " Record AY music",       NULL,   0,        toggleaydump,    0, 0 },
+                                   { " Record audio",          NULL,   0,        togglewavcap,    0, 0 },
                                    { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
                                    { "Back",                   "\x17", SDLK_BACKSPACE,gotomenu,   0, 0 },
                                    { NULL, } };
@@ -286,12 +313,14 @@ struct osdmenuitem vdopitems[] = { { " OpenGL rendering",      "O",    'o',
                                    { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
                                    { " Fullscreen",         "[F8]",    SDLK_F8,  togglefullscreen, 0, 0 },
                                    { " Scanlines",             "C",    'c',      togglescanlines, 0, 0 },
+                                   { " PAL ghosting",          "P",    'p',      toggleswpalghost, 0, 0 },
                                    { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
                                    { "Back",                   "\x17", SDLK_BACKSPACE,gotomenu,   0, 0 },
                                    { NULL, } };
 #else
 struct osdmenuitem vdopitems[] = { { " Fullscreen",            "F",    'f',      togglefullscreen, 0, 0 },
                                    { " Scanlines",             "C",    'c',      togglescanlines, 0, 0 },
+                                   { " PAL ghosting",          "P",    'p',      toggleswpalghost, 0, 0 },
                                    { OSDMENUBAR,               NULL,   0,        NULL,            0, 0 },
                                    { "Back",                   "\x17", SDLK_BACKSPACE,gotomenu,   0, 0 },
                                    { NULL, } };
@@ -339,6 +368,11 @@ struct osdmenuitem ovopitems[] = { { "  1mhz (None)", "1",    '1', setoverclock,
                                    { "Back",         "\x17", SDLK_BACKSPACE,gotomenu,0, 0 },
                                    { NULL, } };
 
+// The tape browser is filled in from the tape index when it is opened
+#define TAPEMENU_PAGE 24
+struct osdmenuitem tapeitems[TAPEMENU_PAGE+5];
+static char tapeitemnames[TAPEMENU_PAGE][40];
+
 #define LAST_ITEM(x) ((sizeof(x)/sizeof(struct osdmenuitem))-2)
 
 struct osdmenu menus[] = { { "Main Menu",        LAST_ITEM(mainitems)-4, mainitems },
@@ -348,7 +382,8 @@ struct osdmenu menus[] = { { "Main Menu",        LAST_ITEM(mainitems)-4, mainite
                            { "Video options",    LAST_ITEM(vdopitems),  vdopitems },
                            { "About Oricutron",  LAST_ITEM(aboutitems), aboutitems },
                            { "Overclock",        LAST_ITEM(ovopitems),  ovopitems },
-                           { "Keyboard options", LAST_ITEM(keopitems),  keopitems }};
+                           { "Keyboard options", LAST_ITEM(keopitems),  keopitems },
+                           { "Tape contents",    0,                     tapeitems }};
 
 // Load a 24bit BMP for the GUI
 SDL_bool gimg_load( struct guiimg *gi )
@@ -497,7 +532,7 @@ void draw_tape( struct machine *oric )
     return;
   }
 
-  if( !oric->tapebuf )
+  if( !oric->tape.buf )
   {
     oric->render_gimg( GIMG_TAPE_EJECTED, GIMG_POS_TAPEX, GIMG_POS_SBARY );
     return;
@@ -509,7 +544,7 @@ void draw_tape( struct machine *oric )
     return;
   }
 
-  if( oric->tapeoffs >= oric->tapelen )
+  if( oric->tape.offs >= oric->tape.len )
   {
     oric->render_gimg( GIMG_TAPE_STOP, GIMG_POS_TAPEX, GIMG_POS_SBARY );
     return;
@@ -585,7 +620,14 @@ void render( struct machine *oric )
           perc = 200000/(frametimeave?frametimeave:1);
         else
           perc = 166667/(frametimeave?frametimeave:1);
-        sprintf( oric->statusstr, "%4d.%02d%% - %4dFPS", perc/100, perc%100, fps/100 );
+        if( oric->frameskip_max > 0 )
+          sprintf( oric->statusstr, "%4d.%02d%%/%d%% %4dFPS skip %d/%d", perc/100, perc%100, oric->frameskip_target, fps/100, oric->frameskip, oric->frameskip_max );
+        else
+          sprintf( oric->statusstr, "%4d.%02d%%/%d%% - %4dFPS", perc/100, perc%100, oric->frameskip_target, fps/100 );
+
+        // Add the measured sound latency
+        if( oric->ay.soundon )
+          sprintf( &oric->statusstr[strlen(oric->statusstr)], " %3dms", (int)oric->ay.latency );
         oric->newstatusstr = SDL_TRUE;
       }
       if( oric->popuptime > 0 )
@@ -759,12 +801,106 @@ SDL_bool in_textzone( struct textzone *tz, int x, int y )
   return SDL_FALSE;
 }
 
+// Textzones are drawn in order, each one over the ones before it. A
+// textzone drawn since the frame started is underneath anything drawn
+// from now on.
+static Uint32 tz_drawseq = 0, tz_framestart = 0;
+
+// Make the textzone cells under an area of the screen get redrawn next
+// time. A cell's last drawn colour is set to one that can't happen.
+static void tz_invalidate_cells( struct textzone *ptz, int x, int y, int w, int h )
+{
+  int cx0, cy0, cx1, cy1, cx, cy;
+
+  cx0 = x-ptz->x;
+  cy0 = y-ptz->y;
+  cx1 = cx0+w;
+  cy1 = cy0+h;
+  if( cx0 < 0 ) cx0 = 0;
+  if( cy0 < 0 ) cy0 = 0;
+  cx0 /= 8;
+  cy0 /= 12;
+  cx1 = (cx1+7)/8;
+  cy1 = (cy1+11)/12;
+  if( cx1 > ptz->w ) cx1 = ptz->w;
+  if( cy1 > ptz->h ) cy1 = ptz->h;
+
+  for( cy=cy0; cy<cy1; cy++ )
+    for( cx=cx0; cx<cx1; cx++ )
+      ptz->ofc[cy*ptz->w+cx] = 0xff;
+}
+
+// Something was drawn over an area of the screen, so any textzone cells
+// there must be redrawn next time they are rendered.
+// "except" is a textzone to leave alone, or -1.
+void tz_invalidate_rect( int x, int y, int w, int h, int except )
+{
+  int i;
+
+  for( i=0; i<NUM_TZ; i++ )
+  {
+    if( ( !tz[i] ) || ( i == except ) ) continue;
+
+    if( ( x < (tz[i]->x+tz[i]->w*8) ) && ( (x+w) > tz[i]->x ) &&
+        ( y < (tz[i]->y+tz[i]->h*12) ) && ( (y+h) > tz[i]->y ) )
+      tz_invalidate_cells( tz[i], x, y, w, h );
+  }
+}
+
+// A new frame is being rendered, so nothing is on top of anything yet
+void tz_newframe( void )
+{
+  tz_framestart = tz_drawseq;
+}
+
+// Textzone "i" is being drawn, on top of everything so far this frame
+void tz_begindraw( int i )
+{
+  tz[i]->drawseq = ++tz_drawseq;
+}
+
+// Textzone "i" drew cells over an area of the screen. Textzones it is
+// on top of will stay covered there, but ones still to be drawn (or not
+// shown this frame) have to put their cells back.
+void tz_drawn_over( int i, int x, int y, int w, int h )
+{
+  int j;
+
+  for( j=0; j<NUM_TZ; j++ )
+  {
+    if( ( !tz[j] ) || ( j == i ) ) continue;
+
+    // Drawn since the frame started? (This way round survives the counter wrapping.)
+    if( ( tz[j]->drawseq - tz_framestart - 1 ) < ( tz_drawseq - tz_framestart ) ) continue;
+
+    if( ( x < (tz[j]->x+tz[j]->w*8) ) && ( (x+w) > tz[j]->x ) &&
+        ( y < (tz[j]->y+tz[j]->h*12) ) && ( (y+h) > tz[j]->y ) )
+      tz_invalidate_cells( tz[j], x, y, w, h );
+  }
+}
+
+// Does a textzone cell need drawing? If so, it is assumed
+// the caller will draw it.
+SDL_bool tz_cell_changed( struct textzone *ptz, int o )
+{
+  if( ( !ptz->redraw ) &&
+      ( ptz->otx[o] == ptz->tx[o] ) &&
+      ( ptz->ofc[o] == ptz->fc[o] ) &&
+      ( ptz->obc[o] == ptz->bc[o] ) )
+    return SDL_FALSE;
+
+  ptz->otx[o] = ptz->tx[o];
+  ptz->ofc[o] = ptz->fc[o];
+  ptz->obc[o] = ptz->bc[o];
+  return SDL_TRUE;
+}
+
 // Allocate a textzone structure
 SDL_bool alloc_textzone( struct machine *oric, int i, int x, int y, int w, int h, char *title )
 {
   struct textzone *ntz;
 
-  ntz = malloc( sizeof( struct textzone ) + w*h*3 );
+  ntz = malloc( sizeof( struct textzone ) + w*h*6 );
   if( !ntz ) return SDL_FALSE;
 
   ntz->x = x;
@@ -775,6 +911,11 @@ SDL_bool alloc_textzone( struct machine *oric, int i, int x, int y, int w, int h
   ntz->tx = (unsigned char *)(&ntz[1]);
   ntz->fc = &ntz->tx[w*h];
   ntz->bc = &ntz->fc[w*h];
+  ntz->otx = &ntz->bc[w*h];
+  ntz->ofc = &ntz->otx[w*h];
+  ntz->obc = &ntz->ofc[w*h];
+  ntz->redraw = SDL_TRUE;
+  ntz->drawseq = tz_framestart;
 
   tzsettitle( ntz, title );
 
@@ -1381,6 +1522,188 @@ void toggletapenoise( struct machine *oric, struct osdmenuitem *mitem, int dummy
   mitem->name = "\x0e""Tape noise";
 }
 
+// Toggle pacing the emulation by the audio output
+void toggleaudiosync( struct machine *oric, struct osdmenuitem *mitem, int dummy )
+{
+  if( oric->audiosync )
+  {
+    oric->audiosync = SDL_FALSE;
+    mitem->name = " Audio sync";
+  }
+  else
+  {
+    oric->audiosync = SDL_TRUE;
+    mitem->name = "\x0e""Audio sync";
+  }
+
+#ifdef __OPENGL_AVAILABLE__
+  SDL_COMPAT_GL_SetSwapInterval( oric->audiosync ? 1 : 0 );
+#endif
+}
+
+// Choose where the AY channels go
+void setaystereo( struct machine *oric, struct osdmenuitem *mitem, int mode )
+{
+  oric->aystereo = mode;
+  ay_setstereo( &oric->ay, mode );
+  setmenutoggles( oric );
+}
+
+static void settapeitem( struct osdmenuitem *mitem, char *name, char *key, int sdlkey, void (*func)(struct machine *,struct osdmenuitem *,int), int arg )
+{
+  mitem->name   = name;
+  mitem->key    = key;
+  mitem->sdlkey = sdlkey;
+  mitem->func   = func;
+  mitem->arg    = arg;
+  mitem->flags  = 0;
+}
+
+// List the files on the tape, a page at a time
+void tapebrowser( struct machine *oric, struct osdmenuitem *mitem, int first )
+{
+  struct tapeentry *te;
+  int i, n, cur;
+
+  cur = tape_currententry( oric );
+  menus[8].citem = -1;
+
+  for( i=first, n=0; ( i<oric->tapeindexlen ) && ( n<TAPEMENU_PAGE ); i++, n++ )
+  {
+    te = &oric->tapeindex[i];
+    snprintf( tapeitemnames[n], 40, "%c%-16s %s %04X-%04X",
+      (i==cur) ? 0x0e : ' ',
+      te->name[0] ? te->name : "(no name)",
+      tape_typename( te ),
+      te->start, te->end );
+    tapeitemnames[n][39] = 0;
+    settapeitem( &tapeitems[n], tapeitemnames[n], NULL, 0, tapeseek, i );
+    if( ( i == cur ) || ( menus[8].citem < 0 ) ) menus[8].citem = n;
+  }
+
+  if( !n )
+    settapeitem( &tapeitems[n++], oric->tape.buf ? " No files found" : " No tape inserted", NULL, 0, NULL, 0 );
+
+  settapeitem( &tapeitems[n++], OSDMENUBAR, NULL, 0, NULL, 0 );
+  if( i < oric->tapeindexlen )
+    settapeitem( &tapeitems[n++], "Next page", "N", 'n', tapebrowser, i );
+  else if( first > 0 )
+    settapeitem( &tapeitems[n++], "First page", "N", 'n', tapebrowser, 0 );
+  settapeitem( &tapeitems[n++], "Back", "\x17", SDLK_BACKSPACE, gotomenu, 0 );
+  if( menus[8].citem < 0 ) menus[8].citem = n-1;
+  tapeitems[n].name = NULL;
+
+  gotomenu( oric, NULL, 8 );
+}
+
+// Wind the tape to a file picked in the tape browser
+void tapeseek( struct machine *oric, struct osdmenuitem *mitem, int entry )
+{
+  char tmp[40];
+
+  tape_seekentry( oric, entry );
+  snprintf( tmp, 40, "\x0f\x10 %s", oric->tapeindex[entry].name );
+  tmp[39] = 0;
+  do_popup( oric, tmp );
+  setemumode( oric, NULL, EM_RUNNING );
+}
+
+// Start/stop dumping the AY registers to a YM file
+void toggleaydump( struct machine *oric, struct osdmenuitem *mitem, int dummy )
+{
+  if( aydump )
+  {
+    aydump_close( &aydump );
+    mitem->name = " Record AY music";
+    do_popup( oric, "AY recording stopped" );
+    return;
+  }
+
+  sprintf( aydumpname, "Recording to aydump%02d.ym", aydumpcount );
+  aydump = aydump_open( &aydumpname[13], oric->vid_freq ? SDL_TRUE : SDL_FALSE );
+  if( !aydump )
+  {
+    do_popup( oric, "Unable to record AY music" );
+    return;
+  }
+
+  aydumpcount++;
+  mitem->name = "\x0e""Record AY music";
+  do_popup( oric, aydumpname );
+}
+
+// Start capturing the sound output to a WAV (or raw float) file. The
+// audio thread picks "wavcap" up, so only swap it with the audio locked.
+SDL_bool startwavcap( struct machine *oric, char *filename, int rate )
+{
+  struct wavcap_handle *wh;
+
+  wh = wavcap_open( filename, rate, 2 );
+  if( !wh ) return SDL_FALSE;
+
+  if( soundavailable ) SDL_LockAudio();
+  wavcap = wh;
+  if( soundavailable ) SDL_UnlockAudio();
+  return SDL_TRUE;
+}
+
+// Stop capturing. The writer thread is waited for outside the audio lock.
+// Returns SDL_FALSE if the file couldn't be written; samples lost along
+// the way are counted in "dropped" for the caller to report.
+SDL_bool stopwavcap( struct machine *oric, Uint32 *dropped )
+{
+  struct wavcap_handle *wh;
+
+  if( soundavailable ) SDL_LockAudio();
+  wh = wavcap;
+  wavcap = NULL;
+  if( soundavailable ) SDL_UnlockAudio();
+
+  return wavcap_close( &wh, dropped );
+}
+
+// Start/stop capturing the sound output to a WAV file
+void togglewavcap( struct machine *oric, struct osdmenuitem *mitem, int dummy )
+{
+  if( wavcap )
+  {
+    Uint32 dropped;
+    char tmp[64];
+
+    mitem->name = " Record audio";
+    if( !stopwavcap( oric, &dropped ) )
+    {
+      msgbox( oric, MSGBOX_OK, "Error writing audio capture" );
+      return;
+    }
+    if( dropped )
+    {
+      snprintf( tmp, sizeof( tmp ), "Audio capture dropped %u samples", dropped );
+      msgbox( oric, MSGBOX_OK, tmp );
+      return;
+    }
+    do_popup( oric, "Audio recording stopped" );
+    return;
+  }
+
+  if( !soundavailable )
+  {
+    do_popup( oric, "No sound to record" );
+    return;
+  }
+
+  sprintf( wavcapname, "Recording to audio%02d.wav", wavcapcount );
+  if( !startwavcap( oric, &wavcapname[13], obtained.freq ) )
+  {
+    do_popup( oric, "Unable to record audio" );
+    return;
+  }
+
+  wavcapcount++;
+  mitem->name = "\x0e""Record audio";
+  do_popup( oric, wavcapname );
+}
+
 // Toggle sound on/off
 void togglesound( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 {
@@ -1402,6 +1725,7 @@ void togglesound( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 // Toggle turbotape on/off
 void toggletapeturbo( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 {
+  tape_sync( oric );
   oric->tapeturbo_forceoff = SDL_FALSE;
 
   if( oric->tapeturbo )
@@ -1415,9 +1739,24 @@ void toggletapeturbo( struct machine *oric, struct osdmenuitem *mitem, int dummy
   mitem->name = "\x0e""Turbo tape";
 }
 
+// Toggle instant loading of TAP programs (needs turbotape)
+void toggletapeinstant( struct machine *oric, struct osdmenuitem *mitem, int dummy )
+{
+  if( oric->tapeinstant )
+  {
+    oric->tapeinstant = SDL_FALSE;
+    mitem->name = " Instant tape load";
+    return;
+  }
+
+  oric->tapeinstant = SDL_TRUE;
+  mitem->name = "\x0e""Instant tape load";
+}
+
 // Toggle VSync Hack
 void togglevsynchack( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 {
+  tape_sync( oric );
   if( oric->vsynchack )
   {
     oric->vsynchack = SDL_FALSE;
@@ -1506,6 +1845,7 @@ void toggleautowind( struct machine *oric, struct osdmenuitem *mitem, int dummy
 // Toggle autoinsert on/off
 void toggleautoinsrt( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 {
+  tape_sync( oric );
   if( oric->autoinsert )
   {
     oric->autoinsert = SDL_FALSE;
@@ -1561,6 +1901,22 @@ void togglepalghost( struct machine *oric, struct osdmenuitem *mitem, int dummy
   mitem->name = "\x0e""PAL ghosting";
 }
 
+// Toggle PAL ghosting on/off for software rendering
+void toggleswpalghost( struct machine *oric, struct osdmenuitem *mitem, int dummy )
+{
+  if( oric->swpalghost )
+  {
+    oric->swpalghost = SDL_FALSE;
+    mitem->name = " PAL ghosting";
+    ula_set_dirty( oric );
+    return;
+  }
+
+  oric->swpalghost = SDL_TRUE;
+  mitem->name = "\x0e""PAL ghosting";
+  ula_set_dirty( oric );
+}
+
 // Toggle scanlines on/off
 void togglescanlines( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 {
@@ -2166,11 +2522,35 @@ void setmenutoggles( struct machine *oric )
   else
     find_item_by_function(auopitems, toggletapenoise)->name = " Tape noise";
 
+  if( oric->audiosync )
+    find_item_by_function(auopitems, toggleaudiosync)->name = "\x0e""Audio sync";
+  else
+    find_item_by_function(auopitems, toggleaudiosync)->name = " Audio sync";
+
+  find_item_by_function_and_arg(auopitems, setaystereo, AYSTEREO_MONO)->name = oric->aystereo==AYSTEREO_MONO ? "\x0e""Mono"       : " Mono";
+  find_item_by_function_and_arg(auopitems, setaystereo, AYSTEREO_ABC )->name = oric->aystereo==AYSTEREO_ABC  ? "\x0e""ABC stereo" : " ABC stereo";
+  find_item_by_function_and_arg(auopitems, setaystereo, AYSTEREO_ACB )->name = oric->aystereo==AYSTEREO_ACB  ? "\x0e""ACB stereo" : " ACB stereo";
+
+  if( aydump )
+    find_item_by_function(auopitems, toggleaydump)->name = "\x0e""Record AY music";
+  else
+    find_item_by_function(auopitems, toggleaydump)->name = " Record AY music";
+
+  if( wavcap )
+    find_item_by_function(auopitems, togglewavcap)->name = "\x0e""Record audio";
+  else
+    find_item_by_function(auopitems, togglewavcap)->name = " Record audio";
+
   if( oric->tapeturbo )
     find_item_by_function(hwopitems, toggletapeturbo)->name = "\x0e""Turbo tape";
   else
     find_item_by_function(hwopitems, toggletapeturbo)->name = " Turbo tape";
 
+  if( oric->tapeinstant )
+    find_item_by_function(hwopitems, toggletapeinstant)->name = "\x0e""Instant tape load";
+  else
+    find_item_by_function(hwopitems, toggletapeinstant)->name = " Instant tape load";
+
   if( oric->autoinsert )
     find_item_by_function(hwopitems, toggleautoinsrt)->name = "\x0e""Autoinsert tape";
   else
@@ -2231,6 +2611,11 @@ void setmenutoggles( struct machine *oric )
   else
     find_item_by_function(glopitems, togglepalghost)->name = " PAL ghosting";
 
+  if( oric->swpalghost )
+    find_item_by_function(vdopitems, toggleswpalghost)->name = "\x0e""PAL ghosting";
+  else
+    find_item_by_function(vdopitems, toggleswpalghost)->name = " PAL ghosting";
+
 
   find_item_by_function_and_arg(hwopitems, swapmach, (0xffff<<16)|MACH_ORIC1      )->name = oric->type==MACH_ORIC1     ? "\x0e""Oric-1"     : " Oric-1";
   find_item_by_function_and_arg(hwopitems, swapmach, (0xffff<<16)|MACH_ORIC1_16K  )->name = oric->type==MACH_ORIC1_16K ? "\x0e""Oric-1 16K" : " Oric-1 16K";
@@ -2282,23 +2667,31 @@ SDL_bool init_gui( struct machine *oric, Sint32 rendermode )
   if( !alloc_textzone( oric, TZ_AY,       400, 228, 30, 21, "AY Status"            ) ) return SDL_FALSE;
   if( !alloc_textzone( oric, TZ_DISK,     400, 228, 30, 21, "Disk Status"          ) ) return SDL_FALSE;
 
-  // Set up SDL audio
-  wanted.freq     = AUDIO_FREQ;
+  // Set up SDL audio. SDL wants a power of two buffer length.
+  for( i=AUDIO_BUFLEN_MIN; i<oric->audio_buflen; i<<=1 ) ;
+  wanted.freq     = oric->audio_rate;
   wanted.format   = AUDIO_S16SYS;
   wanted.channels = 2; /* 1 = mono, 2 = stereo */
-  wanted.samples  = AUDIO_BUFLEN;
+  wanted.samples  = i;
 
   wanted.callback = (void*)ay_callback;
   wanted.userdata = &oric->ay;
 
   soundavailable = SDL_FALSE;
   soundon = SDL_FALSE;
-  if( SDL_OpenAudio( &wanted, &obtained ) >= 0 )
+  if( ( !headless ) && ( SDL_OpenAudio( &wanted, &obtained ) >= 0 ) )
   {
     soundon = SDL_TRUE;
     soundavailable = SDL_TRUE;
     soundsilence = obtained.silence * 8192;
     cyclespersample = ((CYCLESPERSECOND<<FPBITS)/obtained.freq);
+
+    if( !ay_setbuffers( &oric->ay, obtained.samples ) )
+    {
+      SDL_CloseAudio();
+      soundon = SDL_FALSE;
+      soundavailable = SDL_FALSE;
+    }
   }
 
   setmenutoggles( oric );
@@ -59,6 +59,9 @@ struct textzone
   unsigned char *tx;        // Text buffer
   unsigned char *fc, *bc;   // Colour buffers
   SDL_bool modified;
+  unsigned char *otx, *ofc, *obc; // What the renderer last drew in each cell
+  SDL_bool redraw;          // Renderer must redraw every cell next time
+  Uint32 drawseq;           // When it was last drawn, to tell which textzones are on top
 };
 
 // "on screen display" menus
@@ -121,6 +124,11 @@ enum
 SDL_bool alloc_textzone( struct machine *oric, int i, int x, int y, int w, int h, char *title );
 void free_textzone( struct machine *oric, int i );
 SDL_bool in_textzone( struct textzone *tz, int x, int y );
+void tz_invalidate_rect( int x, int y, int w, int h, int except );
+void tz_newframe( void );
+void tz_begindraw( int i );
+void tz_drawn_over( int i, int x, int y, int w, int h );
+SDL_bool tz_cell_changed( struct textzone *ptz, int o );
 
 void do_popup( struct machine *oric, char *str );
 void makebox( struct textzone *ptz, int x, int y, int w, int h, int fg, int bg );
@@ -137,6 +145,8 @@ void gotosite( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void gotomenu( struct machine *oric, struct osdmenuitem *mitem, int menunum );
 SDL_bool menu_event( SDL_Event *ev, struct machine *oric, SDL_bool *needrender );
 void setmenutoggles( struct machine *oric );
+SDL_bool startwavcap( struct machine *oric, char *filename, int rate );
+SDL_bool stopwavcap( struct machine *oric, Uint32 *dropped );
 void set_render_mode( struct machine *oric, int whichrendermode );
 
 void render( struct machine *oric );
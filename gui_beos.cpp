@@ -46,6 +46,7 @@ extern "C" {
 #include "monitor.h"
 #include "6551.h"
 #include "machine.h"
+#include "basic.h"
 }
 
 static rgb_color oric_colors[] = {
@@ -281,7 +282,7 @@ SDL_bool clipboard_paste( struct machine *oric )
 			BString t(text, textLen);
 			t.ReplaceAll('\n', '\r');
 			t.ReplaceAll('\t', ' ');
-			queuekeys( (char *)t.String() );
+			basic_paste( oric, (char *)t.String() );
 		}
 		be_clipboard->Unlock();
 	}
@@ -37,6 +37,7 @@
 #include "monitor.h"
 #include "6551.h"
 #include "machine.h"
+#include "basic.h"
 
 extern struct osdmenu menus[];
 
@@ -145,7 +146,7 @@ SDL_bool clipboard_paste( struct machine *oric )
 	for (NSString *t in copiedItems) {
 		t = [t stringByReplacingOccurrencesOfString: @"\n" withString: @"\r"];
 		t = [t stringByReplacingOccurrencesOfString: @"\t" withString: @" "];
-		queuekeys( (char *)[t UTF8String] );
+		basic_paste( oric, (char *)[t UTF8String] );
 	}
 #endif
 
@@ -38,6 +38,7 @@
 #include "monitor.h"
 #include "6551.h"
 #include "machine.h"
+#include "basic.h"
 
 static HWND SDL_Window;
 
@@ -174,7 +175,7 @@ SDL_bool clipboard_paste( struct machine *oric )
       }
       p++;
     }
-    queuekeys(text);
+    basic_paste(oric, text);
   }
   return SDL_TRUE;
 }
@@ -36,6 +36,7 @@
 #include "monitor.h"
 #include "6551.h"
 #include "machine.h"
+#include "basic.h"
 
 #include <limits.h>   /* for INT_MAX */
 
@@ -301,7 +302,7 @@ SDL_bool clipboard_paste( struct machine *oric )
       }
       p++;
     }
-    queuekeys(text);
+    basic_paste(oric, text);
   }
   return SDL_TRUE;
 }
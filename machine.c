@@ -39,12 +39,14 @@
 #include "6551.h"
 #include "machine.h"
 #include "avi.h"
+#include "aydump.h"
 #include "filereq.h"
 #include "main.h"
 #include "ula.h"
 #include "joystick.h"
 #include "tape.h"
 #include "keyboard.h"
+#include "arcfile.h"
 
 extern SDL_bool warpspeed, soundavailable, soundon;
 extern char diskpath[], diskfile[], filetmp[];
@@ -62,6 +64,12 @@ char telebankfiles[8][1024];
 struct avi_handle *vidcap = NULL;
 char vidcapname[128];
 int vidcapcount = 0;
+struct aydump_handle *aydump = NULL;
+char aydumpname[128];
+int aydumpcount = 0;
+struct wavcap_handle *wavcap = NULL;
+char wavcapname[128];
+int wavcapcount = 0;
 
 unsigned char rom_microdisc[8912], rom_jasmin[2048], rom_pravetz[512];
 struct symboltable sym_microdisc, sym_jasmin, sym_pravetz;
@@ -100,21 +108,20 @@ static Uint8 ftdos_detect[] =
 
 int detect_image_type(char *filename)
 {
-  FILE *f;
+  struct arcfile *f;
   size_t size;
   unsigned char tmp[6400];
 
-  f = fopen(filename, "rb");
+  /* .gz and .zip files are judged by what's in them */
+  f = arc_open(filename, arc_imageexts);
   if (!f)
     return IMG_I_DUNNO;
 
-  fseek(f, 0, SEEK_END);
-  size = ftell(f);
-  fseek(f, 0, SEEK_SET);
+  size = f->size;
 
-  if (1 != fread(tmp, 8, 1, f))
+  if (8 != arc_read(f, tmp, 8))
   {
-    fclose(f);
+    arc_close(&f);
     return IMG_I_DUNNO;
   }
 
@@ -125,14 +132,14 @@ int detect_image_type(char *filename)
       (memcmp(tmp, "RIFF", 4) == 0) ||
       (memcmp(tmp, "ORT\x00", 4) == 0))
   {
-    fclose(f);
+    arc_close(&f);
     return IMG_TAPE;
   }
 
-  /* Look for snapshot header */
-  if (memcmp(tmp, "OSN\x00", 4)==0)
+  /* Look for snapshot header (snapshots can't be compressed) */
+  if ((f->type == ARC_NONE) && (memcmp(tmp, "OSN\x00", 4)==0))
   {
-    fclose(f);
+    arc_close(&f);
     return IMG_SNAPSHOT;
   }
 
@@ -144,9 +151,10 @@ int detect_image_type(char *filename)
     SDL_bool gotsector = SDL_FALSE;
 
     /* Read side 0, track 0 */
-    fseek(f, 256, SEEK_SET);
-    fread(tmp, 6400, 1, f);
-    fclose(f);
+    memset(tmp, 0, 6400);
+    arc_seek(f, 256);
+    arc_read(f, tmp, 6400);
+    arc_close(&f);
 
     /* Find the first sector */
     ptr = tmp;
@@ -209,7 +217,7 @@ int detect_image_type(char *filename)
     return IMG_GUESS_MICRODISC;
   }
 
-  fclose(f);
+  arc_close(&f);
 
   /* Maybe its a pravetz disk... */
   if (size == 143360)
@@ -261,22 +269,31 @@ void setemumode( struct machine *oric, struct osdmenuitem *mitem, int mode )
 
 void setromon( struct machine *oric )
 {
+  SDL_bool romon;
+
   // Determine if the ROM is currently active
-  oric->romon = SDL_TRUE;
+  romon = SDL_TRUE;
   if( oric->drivetype == DRV_JASMIN )
   {
     if( oric->jasmin.olay == 0 )
     {
-      oric->romon = !oric->romdis;
+      romon = !oric->romdis;
     } else {
-      oric->romon = SDL_FALSE;
+      romon = SDL_FALSE;
     }
   }
   else if( oric->drivetype == DRV_PRAVETZ )
   {
-    oric->romon = !oric->pravetz.olay;
+    romon = !oric->pravetz.olay;
   } else {
-    oric->romon = !oric->romdis;
+    romon = !oric->romdis;
+  }
+
+  // Turbotape only works with the ROM paged in
+  if( romon != oric->romon )
+  {
+    tape_sync( oric );
+    oric->romon = romon;
   }
 }
 
@@ -294,6 +311,7 @@ void atmoswrite( struct m6502 *cpu, unsigned short addr, unsigned char data )
     return;
   }
   oric->mem[addr] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr );
 }
 
 // 16k oric-1 CPU write
@@ -311,6 +329,7 @@ void o16kwrite( struct m6502 *cpu, unsigned short addr, unsigned char data )
   }
 
   oric->mem[addr&0x3fff] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr&0x3fff );
 }
 
 // Oric Telestrat CPU write
@@ -359,6 +378,7 @@ void telestratwrite( struct m6502 *cpu, unsigned short addr, unsigned char data
   }
 
   oric->mem[addr] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr );
 }
 
 // Atmos + jasmin
@@ -391,6 +411,7 @@ void jasmin_atmoswrite( struct m6502 *cpu, unsigned short addr, unsigned char da
     return;
   }
   oric->mem[addr] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr );
 }
 
 // 16k + jasmin
@@ -424,6 +445,7 @@ void jasmin_o16kwrite( struct m6502 *cpu, unsigned short addr, unsigned char dat
   }
 
   oric->mem[addr&0x3fff] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr&0x3fff );
 }
 
 // Atmos + microdisc
@@ -451,6 +473,7 @@ void microdisc_atmoswrite( struct m6502 *cpu, unsigned short addr, unsigned char
     return;
   }
   oric->mem[addr] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr );
 }
 
 // Atmos + microdisc
@@ -478,6 +501,7 @@ void microdisc_o16kwrite( struct m6502 *cpu, unsigned short addr, unsigned char
     return;
   }
   oric->mem[addr&0x3fff] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr&0x3fff );
 }
 
 // Pravetz
@@ -486,6 +510,7 @@ void pravetz_atmoswrite( struct m6502 *cpu, unsigned short addr, unsigned char d
   struct machine *oric = (struct machine *)cpu->userdata;
 
   oric->mem[addr] = data;
+  ULA_CHECK_CHARSET_WRITE( oric, addr );
 
   if( 0x300 <= addr && addr <= 0x30f )
   {
@@ -873,12 +898,16 @@ void preinit_machine( struct machine *oric )
   oric->mem = NULL;
   oric->rom = NULL;
 
-  oric->tapebuf = NULL;
-  oric->tapelen = 0;
+  oric->tape.buf = NULL;
+  oric->tape.stream = NULL;
+  oric->tapeindex = NULL;
+  oric->tapeindexlen = 0;
+  oric->tape.len = 0;
   oric->tapemotor = SDL_FALSE;
   oric->vsynchack = SDL_FALSE;
   oric->tapeturbo = SDL_TRUE;
   oric->tapeturbo_forceoff = SDL_FALSE;
+  oric->tapeinstant = SDL_FALSE;
   oric->autorewind = SDL_FALSE;
   oric->autoinsert = SDL_TRUE;
   oric->symbolsautoload = SDL_TRUE;
@@ -890,6 +919,13 @@ void preinit_machine( struct machine *oric )
   oric->lasttapefile[0] = 0;
   oric->keymap = KMAP_QWERTY;
   oric->statusbar_mode = STATUSBARMODE_FULL;
+  oric->frameskip_max = 4;
+  oric->frameskip_target = 100;
+  oric->frameskip = 0;
+  oric->audiosync = SDL_FALSE;
+  oric->audio_buflen = AUDIO_BUFLEN;
+  oric->audio_rate = AUDIO_FREQ;
+  oric->aystereo = AYSTEREO_MONO;
   oric->popupstr[0] = 0;
   oric->newpopupstr = SDL_FALSE;
   oric->popuptime = 0;
@@ -899,8 +935,10 @@ void preinit_machine( struct machine *oric )
   oric->sdljoy_b = NULL;
   oric->rampattern = 0;
   oric->tapecap = NULL;
+  oric->tapeticks = 0;
+  oric->tapeticklen = 0;
   oric->tapenoise = SDL_FALSE;
-  oric->rawtape = SDL_FALSE;
+  oric->tape.raw = SDL_FALSE;
 
   oric->joy_iface = JOYIFACE_NONE;
   oric->joymode_a = JOYMODE_KB1;
@@ -932,6 +970,7 @@ void preinit_machine( struct machine *oric )
     oric->diskname[i][0] = 0;
   }
   oric->diskautosave = SDL_FALSE;
+  oric->diskmap = SDL_FALSE;
   oric->auto_jasmin_reset = SDL_TRUE;
 
   oric->lightpen  = SDL_FALSE;
@@ -1310,8 +1349,12 @@ void clear_patches( struct machine *oric )
   oric->pch_tt_putbyte_end_pc          = -1;
   oric->pch_tt_csave_end_pc            = -1;
   oric->pch_tt_store_end_pc            = -1;
+  oric->pch_tt_getdata_pc              = -1;
+  oric->pch_tt_getdata_end_pc          = -1;
+  oric->pch_tt_getdata_ptr_addr        = -1;
   oric->pch_tt_available               = SDL_FALSE;
   oric->pch_tt_save_available          = SDL_FALSE;
+  oric->pch_tt_instant_available       = SDL_FALSE;
 
   oric->keymap = KMAP_QWERTY;
 }
@@ -1384,6 +1427,9 @@ void load_patches( struct machine *oric, char *fname )
     if( read_config_int(    &filetmp[i], "tt_store_end_pc",            &oric->pch_tt_store_end_pc, 0, 65535 ) )            continue;
     if( read_config_int(    &filetmp[i], "tt_writeleader_pc",          &oric->pch_tt_writeleader_pc, 0, 65535 ) )          continue;
     if( read_config_int(    &filetmp[i], "tt_writeleader_end_pc",      &oric->pch_tt_writeleader_end_pc, 0, 65535 ) )      continue;
+    if( read_config_int(    &filetmp[i], "tt_getdata_pc",              &oric->pch_tt_getdata_pc, 0, 65535 ) )              continue;
+    if( read_config_int(    &filetmp[i], "tt_getdata_end_pc",          &oric->pch_tt_getdata_end_pc, 0, 65535 ) )          continue;
+    if( read_config_int(    &filetmp[i], "tt_getdata_ptr_addr",        &oric->pch_tt_getdata_ptr_addr, 0, 65535 ) )        continue;
     if( read_config_option( &filetmp[i], "keymap",                     &oric->keymap, keymapnames ) )                      continue;
     
     /*
@@ -1437,6 +1483,11 @@ void load_patches( struct machine *oric, char *fname )
   if( ( oric->pch_tt_putbyte_pc != -1 ) &&
       ( oric->pch_tt_putbyte_end_pc != -1 ) )
     oric->pch_tt_save_available = SDL_TRUE;
+
+  if( ( oric->pch_tt_available ) &&
+      ( oric->pch_tt_getdata_pc != -1 ) &&
+      ( oric->pch_tt_getdata_end_pc != -1 ) )
+    oric->pch_tt_instant_available = SDL_TRUE;
 }
 
 static void setup_for_microdisc( struct machine *oric, void *readptr, void *writeptr )
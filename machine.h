@@ -81,6 +81,30 @@ struct telebankinfo
   unsigned char *ptr;
 };
 
+// The signal from a tape image, as the ROM sees it. tape_ticktock plays
+// it in step with the CPU and tape_to_wav plays it into a WAV file, both
+// through tape_nextpulse (see tape.c).
+struct tapeplayer
+{
+  unsigned char *buf;             // The image
+  int len, offs;
+  struct wavstream *stream;       // Long WAVs, decoded as they play (buf is just the ORT header)
+  SDL_bool raw;                   // ORT image: raw pulse counts, with non-raw sections
+  int nonrawend;                  // End of the current non-raw section
+  int hitend;                     // Pulses sent since running off the end (3 = stopped)
+
+  unsigned char bit, out, parity; // Bit of the current byte (0-13), signal level, parity so far
+  int count;                      // Cycles until the next edge
+  int time;                       // Length of the current half-bit
+  int dupbytes;                   // Extra sync bytes to send before the leader
+  int hdrend;                     // Where the header ends, and the gap after it starts
+  int delay;                      // Cycles left of the gap after a header
+
+  SDL_bool slow;                  // Send each bit in the ROM's slow format (tape_to_wav only)
+  int reps;                       // Slow format half-bits still to send of the current bit
+  struct tapestats *stats;        // Count what was sent here, if set (tape_to_wav only)
+};
+
 struct machine
 {
   Uint8 type;
@@ -120,6 +144,7 @@ struct machine
   int vid_chline;
   int frames;
   SDL_bool vid_dirty[224];
+  Uint32 vid_chargen;      // Bumped whenever a character set is written to
   void (*vid_block_func)( struct machine *, SDL_bool, int, int );
 
   int overclockmult, overclockshift;
@@ -147,27 +172,28 @@ struct machine
   struct pravetz   pravetz;
   char diskname[MAX_DRIVES][32];
   SDL_bool diskautosave;
+  SDL_bool diskmap;               // Map uncompressed disk images instead of reading them in
   SDL_bool auto_jasmin_reset;
 
   FILE *prf;
   int prclose, prclock;
 
-  unsigned char tapebit, tapeout, tapeparity;
-  int tapelen, tapeoffs, tapecount, tapetime, tapedupbytes, tapehdrend, tapedelay;
-  unsigned char *tapebuf;
+  struct tapeplayer tape;
+  int tapeticks, tapeticklen;     // Cycles until tape_ticktock is next due, counted down by the VIA
+  struct tapeentry *tapeindex;    // Every file on the tape, found when it was inserted
+  int tapeindexlen;
   SDL_bool tapemotor, tapenoise, tapeturbo, autorewind, autoinsert;
   SDL_bool tapeturbo_forceoff;
+  SDL_bool tapeinstant;           // Copy whole programs in at the CLOAD data trap
   SDL_bool symbolsautoload, symbolscase;
-  SDL_bool rawtape;
-  int nonrawend, tapehitend;
   char lasttapefile[20];
   char tapename[32];
   int tapeturbo_syncstack;
-  FILE *tapecap;
+  struct tapecap_handle *tapecap; // Buffered, written out by a background thread
   int tapecapcount;
   int tapecaplastbit;
   int tapecapsavbytes;
-  int tapecapsavoffs;
+  Uint64 tapecapsavoffs;
 
   // Filename decoding patch addresses
   int pch_fd_cload_getname_pc;
@@ -191,14 +217,19 @@ struct machine
   int pch_tt_store_end_pc;
   int pch_tt_writeleader_pc;
   int pch_tt_writeleader_end_pc;
+  int pch_tt_getdata_pc;
+  int pch_tt_getdata_end_pc;
+  int pch_tt_getdata_ptr_addr;
   SDL_bool pch_tt_readbyte_setcarry;
   SDL_bool pch_tt_available;
   SDL_bool pch_tt_save_available;
-  FILE *tsavf;
+  SDL_bool pch_tt_instant_available;
+  struct tapecap_handle *tsavf;
 
   Sint32 keymap;
 
   SDL_bool hstretch, scanlines, palghost;
+  SDL_bool swpalghost; // PAL ghosting in the 16/32bpp software renderer
   Sint32 sw_depth; // Bit depth of the emulator video mode
 
   int rendermode;
@@ -226,6 +257,19 @@ struct machine
 
   int statusbar_mode;
 
+  // Adaptive frameskip
+  int frameskip_max;       // Maximum number of frames to skip rendering (0 = never skip)
+  int frameskip_target;    // Target emulation speed in percent
+  int frameskip;           // Number of frames currently being skipped
+
+  // Pace the emulation by the audio output rather than the timer
+  SDL_bool audiosync;
+
+  // Audio setup
+  int audio_buflen;        // Buffer length in samples
+  int audio_rate;          // Sample rate in Hz
+  Sint32 aystereo;         // AYSTEREO_MONO, _ABC or _ACB
+
   int rampattern;
 
   Sint32 joy_iface;
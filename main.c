@@ -48,6 +48,9 @@
 #include "filereq.h"
 #include "msgbox.h"
 #include "avi.h"
+#include "aydump.h"
+#include "wavcap.h"
+#include "basic.h"
 #include "main.h"
 #include "ula.h"
 #include "render_sw.h"
@@ -55,18 +58,30 @@
 #include "render_gl.h"
 #include "joystick.h"
 #include "tape.h"
+#include "tapeconv.h"
 #include "snapshot.h"
 #include "keyboard.h"
 
 #define FRAMES_TO_AVERAGE 8
+#define FRAMESKIP_WARP    3    // Frames skipped between renders in warp speed
 
 SDL_bool need_sdl_quit = SDL_FALSE;
 SDL_bool fullscreen, hwsurface;
+SDL_bool headless = SDL_FALSE;   // Ripping with no window or sound device
+static int ripframes = 0;
 extern SDL_bool warpspeed, soundon;
 Uint32 lastframetimes[FRAMES_TO_AVERAGE], frametimeave;
+
+// Running averages of the host time spent emulating and rendering a
+// frame, in 1/16ths of a millisecond so the millisecond timer is still
+// useful for short frames.
+static Uint32 emutimeave16 = 0, rendertimeave16 = 0;
 extern char mon_bpmsg[];
 extern struct avi_handle *vidcap;
-extern char tapepath[], diskpath[], telediskpath[], pravdiskpath[];
+extern struct aydump_handle *aydump;
+extern struct wavcap_handle *wavcap;
+extern SDL_AudioSpec obtained;
+extern char tapepath[], diskpath[], telediskpath[], pravdiskpath[], diskdeltapath[];
 extern char atmosromfile[];
 extern char oric1romfile[];
 extern char mdiscromfile[];
@@ -98,6 +113,9 @@ struct start_opts
   char     start_tape[1024];
   char     start_syms[1024];
   char     start_snapshot[1024];
+  char     start_aydump[1024];
+  char     start_wavcap[1024];
+  char     start_basic[1024];
   char    *start_breakpoint;
 };
 
@@ -142,6 +160,11 @@ static char *rendermodes[] = { "{{INVALID}}",
 
 static char *swdepths[] = { "8", "16", "32", NULL };
 
+static char *stereomodes[] = { "mono",
+                               "abc",
+                               "acb",
+                               NULL };
+
 static SDL_bool istokend( char c )
 {
   if( isws( c ) ) return SDL_TRUE;
@@ -385,6 +408,7 @@ static void load_config( struct start_opts *sto, struct machine *oric )
     if( read_config_bool(   &sto->lctmp[i], "scanlines",    &oric->scanlines ) ) continue;
     if( read_config_bool(   &sto->lctmp[i], "hstretch",     &oric->hstretch ) ) continue;
     if( read_config_bool(   &sto->lctmp[i], "palghosting",  &oric->palghost ) ) continue;
+    if( read_config_bool(   &sto->lctmp[i], "swpalghosting", &oric->swpalghost ) ) continue;
     if( read_config_string( &sto->lctmp[i], "diskimage",    sto->start_disk, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "tapeimage",    sto->start_tape, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "symbols",      sto->start_syms, 1024 ) ) continue;
@@ -392,6 +416,7 @@ static void load_config( struct start_opts *sto, struct machine *oric )
     if( read_config_string( &sto->lctmp[i], "diskpath",     diskpath, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "telediskpath", telediskpath, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "pravdiskpath", pravdiskpath, 1024 ) ) continue;
+    if( read_config_string( &sto->lctmp[i], "diskdelta",    diskdeltapath, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "atmosrom",     atmosromfile, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "oric1rom",     oric1romfile, 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "mdiscrom",     mdiscromfile, 1024 ) ) continue;
@@ -399,6 +424,12 @@ static void load_config( struct start_opts *sto, struct machine *oric )
     if( read_config_string( &sto->lctmp[i], "pravetzrom",   pravetzromfile[0], 1024 ) ) continue;
     if( read_config_string( &sto->lctmp[i], "pravetz8drom", pravetzromfile[1], 1024 ) ) continue;
     if( read_config_int(    &sto->lctmp[i], "rampattern",   &oric->rampattern, 0, 1 ) ) continue;
+    if( read_config_int(    &sto->lctmp[i], "frameskip",    &oric->frameskip_max, 0, 9 ) ) continue;
+    if( read_config_int(    &sto->lctmp[i], "targetspeed",  &oric->frameskip_target, 10, 1000 ) ) continue;
+    if( read_config_bool(   &sto->lctmp[i], "audiosync",    &oric->audiosync ) ) continue;
+    if( read_config_int(    &sto->lctmp[i], "audiobuffer",  &oric->audio_buflen, AUDIO_BUFLEN_MIN, AUDIO_BUFLEN_MAX ) ) continue;
+    if( read_config_int(    &sto->lctmp[i], "audiorate",    &oric->audio_rate, 8000, 96000 ) ) continue;
+    if( read_config_option( &sto->lctmp[i], "stereo",       &oric->aystereo, stereomodes ) ) continue;
     if( read_config_option( &sto->lctmp[i], "swdepth",      &oric->sw_depth, swdepths ) )
     {
       /* Convert index to depth */
@@ -424,6 +455,7 @@ static void load_config( struct start_opts *sto, struct machine *oric )
       if( read_config_string( &sto->lctmp[i], tbtmp, telebankfiles[j], 1024 ) ) break;
     }
     if( read_config_bool(   &sto->lctmp[i], "lightpen",     &oric->lightpen ) ) continue;
+    if( read_config_bool(   &sto->lctmp[i], "instanttape",  &oric->tapeinstant ) ) continue;
     if( read_config_string( &sto->lctmp[i], "serial",       oric->aciabackendname, ACIA_BACKEND_NAME_LEN ) )
     {
       if(!strcasecmp("none", oric->aciabackendname))
@@ -480,6 +512,7 @@ static void load_config( struct start_opts *sto, struct machine *oric )
     if( read_config_joykey( &sto->lctmp[i], "kbjoy2_fire1", &oric->kbjoy2[4] ) ) continue;
     if( read_config_joykey( &sto->lctmp[i], "kbjoy2_fire2", &oric->kbjoy2[5] ) ) continue;
     if( read_config_bool(   &sto->lctmp[i], "diskautosave", &oric->diskautosave ) ) continue;
+    if( read_config_bool(   &sto->lctmp[i], "diskmap",      &oric->diskmap ) ) continue;
     if( read_config_bool(   &sto->lctmp[i], "show_keyboard", &oric->show_keyboard ) ) continue;
     if( read_config_bool(   &sto->lctmp[i], "sticky_mod_keys", &oric->sticky_mod_keys ) )continue;
     if( read_config_string( &sto->lctmp[i], "autoload_keyboard_mapping", keymap_file, 4096 ) )
@@ -515,6 +548,9 @@ static void usage( int ret )
           "                       \"pravetz\" or \"p\" for Pravetz\n"
           "\n"
           "  -s / --symbols     = Load symbols from a file\n"
+          "  --basic <file>     = Put a BASIC listing straight into memory\n"
+          "  --diskdelta <dir>  = Save changes to disks into delta files in this\n"
+          "                       directory, leaving the disk images untouched\n"
           "  -f / --fullscreen  = Run oricutron fullscreen\n"
           "  -w / --window      = Run oricutron in a window\n"
 #ifdef __OPENGL_AVAILABLE__
@@ -528,9 +564,30 @@ static void usage( int ret )
           "  -r / --breakpoint  = Set a breakpoint\n"
           "\n"
           "  --turbotape on|off = Enable or disable turbotape\n"
+          "  --instanttape on|off = Copy TAP programs straight into memory on CLOAD\n"
           "  --lightpen on|off  = Enable or disable lightpen\n"
           "  --vsynchack on|off = Enable or disable VSync hack\n"
           "  --scanlines on|off = Enable or disable scanline simulation\n"
+          "  --frameskip <n>    = Skip rendering up to n frames when the host is too slow\n"
+          "                       (0 to 9, 0 renders every frame)\n"
+          "  --speed <percent>  = Target emulation speed (10 to 1000)\n"
+          "  --audiosync on|off = Pace the emulation by the sound output\n"
+          "  --audio-buffer <n> = Sound buffer length in samples (64 to 8192)\n"
+          "  --audio-rate <hz>  = Sound sample rate (8000 to 96000)\n"
+          "  --stereo <layout>  = AY channel layout: \"mono\", \"abc\" or \"acb\"\n"
+          "  --aydump <file>    = Record the AY registers to a YM6 file\n"
+          "                       (.ym5 for YM5, .psg for PSG)\n"
+          "  --wavcap <file>    = Record the sound output to a WAV file\n"
+          "                       (.raw or .f32 for raw 32bit floats)\n"
+          "  --rip <frames>     = Run for n frames with no window or sound, then quit\n"
+          "                       (use with --aydump and/or --wavcap)\n"
+          "  --tapeconvert <path> = Convert a WAV, or all the WAVs in a directory, to\n"
+          "                       .ort and .tap files with no window, then quit\n"
+          "  --tapeexport <path> = Write a TAP or ORT, or all of them in a directory,\n"
+          "                       out as WAVs with no window, then quit (can be\n"
+          "                       given more than once)\n"
+          "  --export-rate <hz> = Sample rate for --tapeexport (22050 to 192000)\n"
+          "  --export-speed <s> = \"fast\" (the default) or \"slow\" for --tapeexport\n"
           "\n"
           "  --serial <type>    = Set serial card back-end emulation:\n"
           "                        'none' - no serial\n"
@@ -591,6 +648,25 @@ static SDL_bool on_or_off( char *arg, char *option, SDL_bool *storage )
   return SDL_FALSE;
 }
 
+static SDL_bool int_in_range( char *arg, char *option, int *storage, int min, int max )
+{
+  char *end;
+  long val;
+
+  if( option )
+  {
+    val = strtol( option, &end, 10 );
+    if( ( end != option ) && ( *end == 0 ) && ( val >= min ) && ( val <= max ) )
+    {
+      *storage = (int)val;
+      return SDL_TRUE;
+    }
+  }
+
+  error_printf("Parameter '%s' should be followed by a number from %d to %d", arg, min, max);
+  return SDL_FALSE;
+}
+
 SDL_bool init( struct machine *oric, int argc, char *argv[] )
 {
   Sint32 i;
@@ -611,6 +687,9 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
   sto->start_tape[0]  = 0;
   sto->start_syms[0]  = 0;
   sto->start_snapshot[0] = 0;
+  sto->start_aydump[0] = 0;
+  sto->start_wavcap[0] = 0;
+  sto->start_basic[0] = 0;
   sto->start_breakpoint = NULL;
   fullscreen          = SDL_FALSE;
 #ifdef WIN32
@@ -630,8 +709,18 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
 
   kbd_init(oric);
 
+  // A rip runs without a window, so pick the dummy video driver
+  // before SDL gets going
+  for( i=1; i<argc; i++ )
+  {
+    if( strcasecmp( argv[i], "--rip" ) == 0 )
+      headless = SDL_TRUE;
+  }
+  if( headless )
+    putenv( "SDL_VIDEODRIVER=dummy" );
+
   // Go SDL!
-  if( SDL_Init( SDL_INIT_VIDEO | SDL_INIT_AUDIO ) < 0 )
+  if( SDL_Init( headless ? SDL_INIT_VIDEO : (SDL_INIT_VIDEO | SDL_INIT_AUDIO) ) < 0 )
   {
     error_printf( "SDL init failed" );
     return SDL_FALSE;
@@ -685,6 +774,12 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
             continue;
           }
 
+          if( strcasecmp( tmp, "instanttape" ) == 0 )
+          {
+            if( !on_or_off( argv[i-1], opt_arg, &oric->tapeinstant ) ) exit( EXIT_FAILURE );
+            continue;
+          }
+
           if( strcasecmp( tmp, "lightpen" ) == 0 )
           {
             if( !on_or_off( argv[i-1], opt_arg, &oric->lightpen ) ) exit( EXIT_FAILURE );
@@ -741,6 +836,110 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
             if( !on_or_off( argv[i-1], opt_arg, &oric->scanlines ) ) exit( EXIT_FAILURE );
             continue;
           }
+
+          if( strcasecmp( tmp, "frameskip" ) == 0 )
+          {
+            if( !int_in_range( argv[i-1], opt_arg, &oric->frameskip_max, 0, 9 ) ) exit( EXIT_FAILURE );
+            continue;
+          }
+
+          if( strcasecmp( tmp, "speed" ) == 0 )
+          {
+            if( !int_in_range( argv[i-1], opt_arg, &oric->frameskip_target, 10, 1000 ) ) exit( EXIT_FAILURE );
+            continue;
+          }
+
+          if( strcasecmp( tmp, "audiosync" ) == 0 )
+          {
+            if( !on_or_off( argv[i-1], opt_arg, &oric->audiosync ) ) exit( EXIT_FAILURE );
+            continue;
+          }
+
+          if( strcasecmp( tmp, "audio-buffer" ) == 0 )
+          {
+            if( !int_in_range( argv[i-1], opt_arg, &oric->audio_buflen, AUDIO_BUFLEN_MIN, AUDIO_BUFLEN_MAX ) ) exit( EXIT_FAILURE );
+            continue;
+          }
+
+          if( strcasecmp( tmp, "audio-rate" ) == 0 )
+          {
+            if( !int_in_range( argv[i-1], opt_arg, &oric->audio_rate, 8000, 96000 ) ) exit( EXIT_FAILURE );
+            continue;
+          }
+
+          if( strcasecmp( tmp, "stereo" ) == 0 )
+          {
+            int j;
+
+            for( j=0; ( opt_arg ) && ( stereomodes[j] ); j++ )
+            {
+              if( strcasecmp( opt_arg, stereomodes[j] ) == 0 )
+                break;
+            }
+
+            if( ( !opt_arg ) || ( !stereomodes[j] ) )
+            {
+              error_printf( "Parameter '%s' should be followed by 'mono', 'abc' or 'acb'", argv[i-1] );
+              exit( EXIT_FAILURE );
+            }
+
+            oric->aystereo = j;
+            continue;
+          }
+
+          if( strcasecmp( tmp, "aydump" ) == 0 )
+          {
+            if( !opt_arg )
+            {
+              error_printf( "Parameter '%s' should be followed by a filename", argv[i-1] );
+              exit( EXIT_FAILURE );
+            }
+            strncpy( sto->start_aydump, opt_arg, 1024 );
+            sto->start_aydump[1023] = 0;
+            continue;
+          }
+
+          if( strcasecmp( tmp, "wavcap" ) == 0 )
+          {
+            if( !opt_arg )
+            {
+              error_printf( "Parameter '%s' should be followed by a filename", argv[i-1] );
+              exit( EXIT_FAILURE );
+            }
+            strncpy( sto->start_wavcap, opt_arg, 1024 );
+            sto->start_wavcap[1023] = 0;
+            continue;
+          }
+
+          if( strcasecmp( tmp, "basic" ) == 0 )
+          {
+            if( !opt_arg )
+            {
+              error_printf( "Parameter '%s' should be followed by a filename", argv[i-1] );
+              exit( EXIT_FAILURE );
+            }
+            strncpy( sto->start_basic, opt_arg, 1024 );
+            sto->start_basic[1023] = 0;
+            continue;
+          }
+
+          if( strcasecmp( tmp, "diskdelta" ) == 0 )
+          {
+            if( !opt_arg )
+            {
+              error_printf( "Parameter '%s' should be followed by a directory", argv[i-1] );
+              exit( EXIT_FAILURE );
+            }
+            strncpy( diskdeltapath, opt_arg, 1024 );
+            diskdeltapath[1023] = 0;
+            continue;
+          }
+
+          if( strcasecmp( tmp, "rip" ) == 0 )
+          {
+            if( !int_in_range( argv[i-1], opt_arg, &ripframes, 1, 0x7fffffff ) ) exit( EXIT_FAILURE );
+            continue;
+          }
           break;
 
         default:
@@ -1082,6 +1281,16 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
     if( tape_load_tap( oric, sto->start_tape ) )
       queuekeys( "CLOAD\"\"\x0d" );
   }
+  if( sto->start_basic[0] )
+  {
+    char *err = basic_queuefile( oric, sto->start_basic );
+    if( err )
+    {
+      error_printf( "%s", err );
+      free( sto );
+      return SDL_FALSE;
+    }
+  }
 
   mon_init( oric );
   if( sto->start_syms[0] )
@@ -1108,6 +1317,43 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
   if( sto->start_debug )
     setemumode( oric, NULL, EM_DEBUG );
 
+  if( sto->start_aydump[0] )
+  {
+    aydump = aydump_open( sto->start_aydump, oric->vid_freq ? SDL_TRUE : SDL_FALSE );
+    if( !aydump )
+    {
+      error_printf( "Unable to create '%s'", sto->start_aydump );
+      free( sto );
+      return SDL_FALSE;
+    }
+    setmenutoggles( oric );
+  }
+
+  if( sto->start_wavcap[0] )
+  {
+    // With no sound device, the audio is made as fast as we can emulate
+    if( ( headless ) && ( !ay_initheadless( &oric->ay, oric->audio_rate, oric->audio_buflen ) ) )
+    {
+      free( sto );
+      return SDL_FALSE;
+    }
+
+    if( !startwavcap( oric, sto->start_wavcap, obtained.freq ? obtained.freq : oric->audio_rate ) )
+    {
+      error_printf( "Unable to create '%s'", sto->start_wavcap );
+      free( sto );
+      return SDL_FALSE;
+    }
+    setmenutoggles( oric );
+  }
+
+  if( ( ripframes ) && ( !aydump ) && ( !wavcap ) )
+  {
+    error_printf( "Nothing to rip. Use --aydump or --wavcap to say where to put it." );
+    free( sto );
+    return SDL_FALSE;
+  }
+
   free( sto );
   return SDL_TRUE;
 }
@@ -1115,6 +1361,8 @@ SDL_bool init( struct machine *oric, int argc, char *argv[] )
 void shut( struct machine *oric )
 {
   if( vidcap ) avi_close( &vidcap );
+  if( aydump ) aydump_close( &aydump );
+  if( wavcap ) stopwavcap( oric, NULL );
 #if defined(DEBUG_CPU_TRACE) && DEBUG_CPU_TRACE > 0
   dump_cputrace(oric);
 #endif
@@ -1129,6 +1377,9 @@ void shut( struct machine *oric )
     shut_gui( oric );
   }
   if( need_sdl_quit ) SDL_COMPAT_Quit();
+
+  // The audio is closed now, so the buffers can go
+  if( oric ) ay_freebuffers( &oric->ay );
 }
 
 void frameloop_overclock( struct machine *oric, SDL_bool *framedone, SDL_bool *needrender )
@@ -1243,31 +1494,181 @@ void frameloop_normal( struct machine *oric, SDL_bool *framedone, SDL_bool *need
   }
 }
 
+static void frameskip_measure( Uint32 *ave16, Uint32 ms )
+{
+  *ave16 = *ave16 - (*ave16/FRAMES_TO_AVERAGE) + (ms*16)/FRAMES_TO_AVERAGE;
+}
+
+/* Choose how many frames to skip rendering so that emulation plus
+   our share of the rendering time fits in the frame time budget */
+static void update_frameskip( struct machine *oric, Uint32 frame_us )
+{
+  Uint32 budget16 = (frame_us*16)/1000;
+  int skip;
+
+  if( oric->frameskip_max <= 0 )
+  {
+    oric->frameskip = 0;
+    return;
+  }
+
+  for( skip=0; skip<oric->frameskip_max; skip++ )
+  {
+    if( ( emutimeave16 + rendertimeave16/(skip+1) ) <= budget16 )
+      break;
+  }
+
+  // Skip more straight away, but only skip less once there is some headroom
+  if( skip > oric->frameskip )
+  {
+    oric->frameskip = skip;
+  }
+  else if( ( skip < oric->frameskip ) &&
+           ( ( emutimeave16 + rendertimeave16/oric->frameskip ) <= (budget16*7)/8 ) )
+  {
+    oric->frameskip--;
+  }
+}
+
 /* Tasks to do once per emulated frame */
 void once_per_frame( struct machine *oric )
 {
   int i;
 
+  if( aydump )
+  {
+    if( !aydump_frame( &aydump, &oric->ay ) )
+    {
+      do_popup( oric, "AY recording failed" );
+      setmenutoggles( oric );
+    }
+  }
+
   if( oric->diskautosave )
   {
     for( i=0; i<4; i++ )
+      diskimage_autosave( oric, i );
+  }
+}
+
+/* Run a program flat out for "ripframes" frames, with nothing rendered or played */
+static void rip( struct machine *oric )
+{
+  SDL_bool framedone, needrender;
+  Sint32 frames = 0;
+  Uint32 start = SDL_GetTicks();
+
+  while( ( frames < ripframes ) && ( oric->emu_mode == EM_RUNNING ) )
+  {
+    framedone = SDL_FALSE;
+    needrender = SDL_FALSE;
+    if( oric->overclockmult==1 )
+      frameloop_normal( oric, &framedone, &needrender );
+    else
+      frameloop_overclock( oric, &framedone, &needrender );
+
+    if( framedone )
     {
-      if( ( oric->wddisk.disk[i] ) && ( oric->wddisk.disk[i]->modified ) )
-      {
-        oric->wddisk.disk[i]->modified_time++;
-        if( oric->wddisk.disk[i]->modified_time >= 20 )
-        {
-          diskimage_save( oric, oric->wddisk.disk[i]->filename, i );
-        }
-      }
+      once_per_frame( oric );
+      ay_headlessaudio( &oric->ay );
+      frames++;
     }
+
+    if( ( !aydump ) && ( !wavcap ) ) break;
   }
+
+  if( frames < ripframes )
+    error_printf( "Rip stopped after %d frames", frames );
+  else
+    printf( "Ripped %d frames in %u ms\n", frames, SDL_GetTicks()-start );
 }
 
 int main( int argc, char *argv[] )
 {
   static struct machine oric;
-  SDL_bool isinit;
+  SDL_bool isinit, exportslow = SDL_FALSE;
+  Uint32 exportrate = TAPECONV_DEFRATE;
+  char **exportpaths = NULL;
+  Uint32 dropped;
+  int i, numexports = 0;
+
+  // Batch tape conversion and export don't need an Oric at all
+  for( i=1; i<argc; i++ )
+  {
+    if( ( strcasecmp( argv[i], "--tapeconvert" ) == 0 ) ||
+        ( strcasecmp( argv[i], "--tapeexport" ) == 0 ) ||
+        ( strcasecmp( argv[i], "--export-rate" ) == 0 ) ||
+        ( strcasecmp( argv[i], "--export-speed" ) == 0 ) )
+    {
+      if( i+1 >= argc )
+      {
+        error_printf( "Parameter '%s' needs a value", argv[i] );
+        return EXIT_FAILURE;
+      }
+    }
+
+    if( strcasecmp( argv[i], "--tapeexport" ) == 0 )
+    {
+      // Every one given goes into the same batch
+      if( !exportpaths )
+      {
+        exportpaths = malloc( sizeof( char * ) * argc );
+        if( !exportpaths )
+        {
+          error_printf( "Out of memory" );
+          return EXIT_FAILURE;
+        }
+      }
+      exportpaths[numexports++] = argv[++i];
+    }
+    else if( strcasecmp( argv[i], "--export-rate" ) == 0 )
+    {
+      exportrate = atoi( argv[++i] );
+      if( ( exportrate < TAPECONV_MINRATE ) || ( exportrate > TAPECONV_MAXRATE ) )
+      {
+        error_printf( "Export rate should be from %d to %d", TAPECONV_MINRATE, TAPECONV_MAXRATE );
+        return EXIT_FAILURE;
+      }
+    }
+    else if( strcasecmp( argv[i], "--export-speed" ) == 0 )
+    {
+      i++;
+      if( strcasecmp( argv[i], "slow" ) == 0 )
+        exportslow = SDL_TRUE;
+      else if( strcasecmp( argv[i], "fast" ) == 0 )
+        exportslow = SDL_FALSE;
+      else
+      {
+        error_printf( "Export speed should be \"fast\" or \"slow\"" );
+        return EXIT_FAILURE;
+      }
+    }
+    else if( strcasecmp( argv[i], "--tapeconvert" ) == 0 )
+    {
+      if( SDL_Init( 0 ) < 0 )
+      {
+        error_printf( "SDL init failed" );
+        return EXIT_FAILURE;
+      }
+      isinit = tapeconv_run( argv[i+1], 0 );
+      SDL_Quit();
+      return isinit ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if( exportpaths )
+  {
+    if( SDL_Init( 0 ) < 0 )
+    {
+      error_printf( "SDL init failed" );
+      free( exportpaths );
+      return EXIT_FAILURE;
+    }
+    isinit = tapeconv_export_run( exportpaths, numexports, exportrate, exportslow, 0 );
+    SDL_Quit();
+    free( exportpaths );
+    return isinit ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
   // This should center SDL window
 #ifndef __MORPHOS__
@@ -1294,12 +1695,16 @@ int main( int argc, char *argv[] )
     //printf("Current Path: %s\n", path);
 #endif
 
-  if( ( isinit = init( &oric, argc, argv ) ) )
+  if( ( isinit = init( &oric, argc, argv ) ) && ( ripframes ) )
+  {
+    rip( &oric );
+  }
+  else if( isinit )
   {
     Uint64 nextframe_us;
-    Uint32 nextframe_ms, now=0, then;
+    Uint32 nextframe_ms, now=0, then, frame_us, emuticks=0, ticks;
     SDL_bool done, needrender, framedone;
-    Sint32 i;
+    Sint32 i, skipcount=0, lead;
 
     now = SDL_GetTicks();
     nextframe_ms = now;
@@ -1324,33 +1729,47 @@ int main( int argc, char *argv[] )
 
       if( oric.emu_mode == EM_RUNNING )
       {
+        ticks = SDL_GetTicks();
         if( oric.overclockmult==1 )
           frameloop_normal( &oric, &framedone, &needrender );
         else
           frameloop_overclock( &oric, &framedone, &needrender );
+        emuticks += SDL_GetTicks()-ticks;
 
         ay_unlockaudio( &oric.ay );
 
         if( framedone )
         {
-          nextframe_us += oric.vid_freq ? 20000LL : 16667LL;
+          frame_us = ((oric.vid_freq ? 20000 : 16667)*100)/oric.frameskip_target;
+          nextframe_us += frame_us;
           nextframe_ms = (Uint32)(nextframe_us/1000LL);
 
-          if (warpspeed)
+          frameskip_measure( &emutimeave16, emuticks );
+          emuticks = 0;
+
+          if( !warpspeed )
+            update_frameskip( &oric, frame_us );
+
+          // The raster is always emulated, but we only draw it when
+          // there is time to do so
+          if( skipcount >= (warpspeed ? FRAMESKIP_WARP : oric.frameskip) )
           {
-            if ((oric.frames&3)==0)
-              needrender = SDL_TRUE;
+            needrender = SDL_TRUE;
+            skipcount = 0;
           }
           else
           {
-            needrender = SDL_TRUE;
+            skipcount++;
           }
         }
 
         if( needrender )
         {
+          ticks = SDL_GetTicks();
           render( &oric );
           needrender = SDL_FALSE;
+          if( framedone )
+            frameskip_measure( &rendertimeave16, SDL_GetTicks()-ticks );
         }
 
         if( framedone )
@@ -1374,6 +1793,20 @@ int main( int argc, char *argv[] )
             nextframe_ms = now;
             nextframe_us = ((Uint64)nextframe_ms)*1000;
           }
+          else if( ( ay_audiosync_wanted( &oric ) ) && ( ay_audiolead( &oric.ay, &lead ) ) )
+          {
+            // Paced by the audio clock. Wait until the sound output has
+            // caught up to within "synclead" cycles of the emulation.
+            while( lead > (Sint32)oric.ay.synclead )
+            {
+              SDL_Delay( (lead-oric.ay.synclead)/(CYCLESPERSECOND/1000) + 1 );
+              if( !ay_audiolead( &oric.ay, &lead ) ) break;
+            }
+
+            // Keep the timer in step in case we fall back to it
+            nextframe_ms = SDL_GetTicks();
+            nextframe_us = ((Uint64)nextframe_ms)*1000;
+          }
           else
           {
             if (now > nextframe_ms)
@@ -1438,6 +1871,22 @@ int main( int argc, char *argv[] )
     }
     ay_unlockaudio( &oric.ay );
   }
+
+  // A capture that didn't make it to disk intact fails the run, so
+  // scripted rips can tell
+  if( wavcap )
+  {
+    if( !stopwavcap( &oric, &dropped ) )
+    {
+      error_printf( "Error writing audio capture" );
+      isinit = SDL_FALSE;
+    }
+    else if( dropped )
+    {
+      error_printf( "Audio capture dropped %u samples", dropped );
+      isinit = SDL_FALSE;
+    }
+  }
   shut( &oric );
 
   return isinit ? EXIT_SUCCESS : EXIT_FAILURE;
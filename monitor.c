@@ -42,6 +42,7 @@
 #include "ula.h"
 #include "tape.h"
 #include "snapshot.h"
+#include "basic.h"
 
 #define LOG_DEBUG 0
 
@@ -1376,18 +1377,18 @@ void mon_update_via( struct machine *oric, struct textzone *vtz, struct via *v,
   }
 
   tzprintfpos( vtz, 2, 18, "---------- TAPE ----------");
-  tzprintfpos( vtz, 2, 19, "OFS %08u  LEN %08u", oric->tapeoffs, oric->tapelen );
+  tzprintfpos( vtz, 2, 19, "OFS %08u  LEN %08u", oric->tape.offs, oric->tape.len );
 
 
 /*
   if( v == &oric->via )
   {
-    tzprintfpos( vtz, 2, 11, "TAPE OFFS = %07d", oric->tapeoffs );
-    tzprintfpos( vtz, 2, 12, "TAPE LEN  = %07d", oric->tapelen );
-    tzprintfpos( vtz, 2, 13, "COUNT     = %07d", oric->tapecount );
+    tzprintfpos( vtz, 2, 11, "TAPE OFFS = %07d", oric->tape.offs );
+    tzprintfpos( vtz, 2, 12, "TAPE LEN  = %07d", oric->tape.len );
+    tzprintfpos( vtz, 2, 13, "COUNT     = %07d", oric->tape.count );
     tzprintfpos( vtz, 2, 14, "BIT = %02X  DATA = %1X",
-      oric->tapebit,
-      oric->tapetime == TAPE_1_PULSE );
+      oric->tape.bit,
+      oric->tape.time == TAPE_1_PULSE );
     tzprintfpos( vtz, 2, 15, "MOTOR = %1X", oric->tapemotor );
   }
 
@@ -2550,6 +2551,7 @@ SDL_bool mon_cmd( char *cmd, struct machine *oric, SDL_bool *needrender )
   unsigned char *tmem;
   struct msym *tmpsym;
   FILE *f;
+  char *tmp;
 
   i=0;
   while( isws( cmd[i] ) ) i++;
@@ -3070,7 +3072,7 @@ SDL_bool mon_cmd( char *cmd, struct machine *oric, SDL_bool *needrender )
         case REG_VIA_T1C:  mon_set_modified( oric ); oric->via.t1c = v;                             break;
         case REG_VIA_CA1:  mon_set_modified( oric ); via_write_CA1( &oric->via, v );                break;
         case REG_VIA_CA2:  mon_set_modified( oric ); via_write_CA2( &oric->via, v );                break;
-        case REG_VIA_CB1:  mon_set_modified( oric ); via_write_CB1( &oric->via, v );                break;
+        case REG_VIA_CB1:  mon_set_modified( oric ); tape_sync( oric ); via_write_CB1( &oric->via, v ); break;
         case REG_VIA_CB2:  mon_set_modified( oric ); via_write_CB2( &oric->via, v );                break;
         case REG_VIA_T2C:  mon_set_modified( oric ); oric->via.t2c = v;                             break;
 
@@ -3211,6 +3213,96 @@ SDL_bool mon_cmd( char *cmd, struct machine *oric, SDL_bool *needrender )
       }
       break;
 
+    case 'l':
+      lastcmd = 0;
+      i++;
+      switch( cmd[i] )
+      {
+        case 'b':  // BASIC listing
+          i++;
+          while( isws( cmd[i] ) ) i++;
+          if( !cmd[i] )
+          {
+            mon_str( "Filename expected" );
+            break;
+          }
+
+          tmp = basic_injectfile( oric, &cmd[i] );
+          if( tmp )
+            mon_printf( "%s", tmp );
+          else
+            mon_printf( "BASIC listing loaded from '%s'", &cmd[i] );
+          break;
+
+        default:
+          mon_str( "???" );
+          break;
+      }
+      break;
+
+    case 't':
+      lastcmd = 0;
+      i++;
+      switch( cmd[i] )
+      {
+        case 'l':  // List the tape
+          if( !oric->tape.buf )
+          {
+            mon_str( "No tape inserted" );
+            break;
+          }
+
+          if( !oric->tapeindexlen )
+          {
+            mon_str( "No files found on the tape" );
+            break;
+          }
+
+          k = tape_currententry( oric );
+          for( j=0; j<oric->tapeindexlen; j++ )
+          {
+            mon_printf( "%c%3d: %-16s %s %04X-%04X%s",
+              (j==k) ? '>' : ' ',
+              j,
+              oric->tapeindex[j].name,
+              tape_typename( &oric->tapeindex[j] ),
+              oric->tapeindex[j].start,
+              oric->tapeindex[j].end,
+              oric->tapeindex[j].autorun ? " A" : "" );
+          }
+          break;
+
+        case 's':  // Seek to a file
+          i++;
+          while( isws( cmd[i] ) ) i++;
+          if( !cmd[i] )
+          {
+            mon_str( "File number or name expected" );
+            break;
+          }
+
+          j = tape_findentry( oric, &cmd[i] );
+          if( j < 0 )
+          {
+            tmp = &cmd[i];
+            j = (int)strtol( &cmd[i], &tmp, 10 );
+            if( ( tmp == &cmd[i] ) || ( *tmp ) || ( j < 0 ) || ( j >= oric->tapeindexlen ) )
+            {
+              mon_printf( "'%s' is not on the tape", &cmd[i] );
+              break;
+            }
+          }
+
+          tape_seekentry( oric, j );
+          mon_printf( "Tape at %d: %s", j, oric->tapeindex[j].name );
+          break;
+
+        default:
+          mon_str( "???" );
+          break;
+      }
+      break;
+
     case '?':
       lastcmd = cmd[i];
       switch( helpcount )
@@ -3240,6 +3332,7 @@ SDL_bool mon_cmd( char *cmd, struct machine *oric, SDL_bool *needrender )
 
         case 1:
           mon_str( "  df <addr> <end> <file>- Disassemble to file" );
+          mon_str( "  lb <file>             - Load BASIC listing" );
           mon_str( "  m <addr>              - Dump memory" );
           mon_str( "  mm <addr> <value>     - Modify memory" );
           mon_str( "  mw <addr>             - Memory watch at addr" );
@@ -3248,6 +3341,11 @@ SDL_bool mon_cmd( char *cmd, struct machine *oric, SDL_bool *needrender )
           mon_str( "  r <reg> <val>         - Set <reg> to <val>" );
           mon_str( "  q, x or qm            - Quit monitor" );
           mon_str( "  qe                    - Quit emulator" );
+          mon_str( "---- MORE" );
+          helpcount++;
+          break;
+
+        case 2:
           mon_str( "  sa <name> <addr>      - Add or move user sym." );
           mon_str( "  sk <name>             - Kill user symbol" );
           mon_str( "  sc                    - Symbols not case-sens." );
@@ -3255,6 +3353,8 @@ SDL_bool mon_cmd( char *cmd, struct machine *oric, SDL_bool *needrender )
           mon_str( "  sl <file>             - Load user symbols" );
           mon_str( "  sx <file>             - Export user symbols" );
           mon_str( "  sz                    - Zap user symbols" );
+          mon_str( "  tl                    - List files on tape" );
+          mon_str( "  ts <num or name>      - Wind tape to a file" );
           mon_str( "  wm <addr> <len> <file>- Write mem to disk" );
           helpcount = 0;
           lastcmd = 0;
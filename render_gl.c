@@ -81,6 +81,10 @@ static Uint32 gpal[NUM_GUI_COLS];
 
 static float clrcol[3];
 
+// Font pre-rendered in RGBA for each GUI colour pair
+// (fg*NUM_GUI_COLS+bg), created the first time it is used
+static Uint32 *glyphs[NUM_GUI_COLS*NUM_GUI_COLS];
+
 extern unsigned char sgpal[];
 extern SDL_bool fullscreen;
 extern struct textzone *tz[NUM_TZ];
@@ -130,26 +134,90 @@ static void printchar( int i, int x, int y, unsigned char ch, Uint32 fcol, Uint3
   }
 }
 
+// Get (or make) the pre-rendered font for a colour pair
+static Uint32 *get_glyphs( int fc, int bc )
+{
+  Uint32 **pg, *dst;
+  const Uint8 *src_byte;
+  int i, mask;
+
+  if( ( fc >= NUM_GUI_COLS ) || ( bc >= NUM_GUI_COLS ) )
+    return NULL;
+
+  pg = &glyphs[fc*NUM_GUI_COLS+bc];
+  if( *pg ) return *pg;
+
+  *pg = malloc( 128*12*8*4 );
+  if( !*pg ) return NULL;
+
+  dst = *pg;
+  src_byte = thefont;
+  for( i=128*12; i!=0; --i, ++src_byte )
+  {
+    for( mask=0x80; mask; mask>>=1 )
+      *(dst++) = ((*src_byte)&mask) ? gpal[fc] : gpal[bc];
+  }
+
+  return *pg;
+}
+
+static void free_glyphs( void )
+{
+  int i;
+
+  for( i=0; i<NUM_GUI_COLS*NUM_GUI_COLS; i++ )
+  {
+    if( glyphs[i] ) free( glyphs[i] );
+    glyphs[i] = NULL;
+  }
+}
+
+// Redraw the changed cells of a textzone into its texture, and
+// upload the band of rows that contains them
 static void update_textzone_texture( struct machine *oric, int i )
 {
-  int x, y, px, py, o;
+  int x, y, px, py, o, cy, first = -1, last = -1;
+  struct texture *ptx = &tx[i+TEX_TZ];
+  Uint32 *src, *dst;
 
   if( !tz[i] ) return;
   if( !tz[i]->modified ) return;
-  if( !tx[i+TEX_TZ].buf ) return;
+  if( !ptx->buf ) return;
 
   o = 0;
 
   for( y=0, py=0; y<tz[i]->h; y++, py+=12 )
   {
     for( x=0, px=0; x<tz[i]->w; x++, o++, px+=8 )
-      printchar( i+TEX_TZ, px, py, tz[i]->tx[o], gpal[tz[i]->fc[o]], gpal[tz[i]->bc[o]], SDL_TRUE );
+    {
+      if( !tz_cell_changed( tz[i], o ) ) continue;
+
+      if( first < 0 ) first = py;
+      last = py+12;
+
+      if( tz[i]->tx[o] > 127 ) continue;
+
+      src = get_glyphs( tz[i]->fc[o], tz[i]->bc[o] );
+      if( !src )
+      {
+        printchar( i+TEX_TZ, px, py, tz[i]->tx[o], gpal[tz[i]->fc[o]], gpal[tz[i]->bc[o]], SDL_TRUE );
+        continue;
+      }
+
+      src += tz[i]->tx[o]*12*8;
+      dst = (Uint32 *)&ptx->buf[(py*ptx->w+px)*4];
+      for( cy=12; cy!=0; --cy, dst+=ptx->w, src+=8 )
+        memcpy( dst, src, 8*4 );
+    }
   }
-  
-  glBindTexture( GL_TEXTURE_2D, tex[i+TEX_TZ] );
-  glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, tx[i+TEX_TZ].w, tx[i+TEX_TZ].h, 0, GL_RGBA, GL_UNSIGNED_BYTE, tx[i+TEX_TZ].buf );
 
+  tz[i]->redraw = SDL_FALSE;
   tz[i]->modified = SDL_FALSE;
+
+  if( first < 0 ) return;
+
+  glBindTexture( GL_TEXTURE_2D, tex[i+TEX_TZ] );
+  glTexSubImage2D( GL_TEXTURE_2D, 0, 0, first, ptx->w, last-first, GL_RGBA, GL_UNSIGNED_BYTE, &ptx->buf[first*ptx->w*4] );
 }
 
 static void update_video_texture( struct machine *oric )
@@ -321,6 +389,7 @@ void render_textzone_alloc_gl( struct machine *oric, int i )
   glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, tx[i+TEX_TZ].w, tx[i+TEX_TZ].h, 0, GL_RGBA, GL_UNSIGNED_BYTE, tx[i+TEX_TZ].buf );
 
   tz[i]->modified = SDL_TRUE;
+  tz[i]->redraw = SDL_TRUE;
 }
 
 void render_textzone_free_gl( struct machine *oric, int i )
@@ -456,6 +525,9 @@ void preinit_render_gl( struct machine *oric )
     tx[i].h   = 0;
     tx[i].buf = NULL;
   }
+
+  for( i=0; i<NUM_GUI_COLS*NUM_GUI_COLS; i++ )
+    glyphs[i] = NULL;
 }
 
 SDL_bool render_togglefullscreen_gl( struct machine *oric )
@@ -507,6 +579,9 @@ SDL_bool init_render_gl( struct machine *oric )
   if( BitsPerPixel )
     depth = BitsPerPixel;
 
+  // With audio sync, show frames in step with the display refresh
+  SDL_COMPAT_GL_SetSwapInterval( oric->audiosync ? 1 : 0 );
+
   if (oric->show_keyboard) {
       screen = SDL_COMPAT_SetVideoMode( 640, 480+240, depth, fullscreen ? SDL_COMPAT_OPENGL|SDL_COMPAT_FULLSCREEN : SDL_COMPAT_OPENGL );
   } else {
@@ -614,6 +689,8 @@ void shut_render_gl( struct machine *oric )
     tx[i].w = 0;
     tx[i].h = 0;
   }
+
+  free_glyphs();
 }
 
 #endif //__OPENGL_AVAILABLE__
@@ -38,10 +38,16 @@ static struct SDL_Surface *screen;
 static Uint32 gpal[NUM_GUI_COLS];
 
 static Uint32 pixel_size, offset_top;
-static Uint32 pal[8*2]; // Palette
-static Uint32 dpal[8*2];
+// Output colours for each pair of adjacent Oric pixels, indexed by
+// [palghost][scanline row][(previous colour<<3)|colour]
+static Uint32 pal[2][2][8*8];
+static Uint32 dpal[2][2][8*8];  // pixel pairs for 16bpp
 static Uint8 *mgimg[NUM_GIMG];
 
+// Font pre-rendered in the screen format for each GUI colour
+// pair (fg*NUM_GUI_COLS+bg), created the first time it is used
+static Uint8 *glyphs[NUM_GUI_COLS*NUM_GUI_COLS];
+
 extern SDL_bool fullscreen, hwsurface;
 static SDL_bool needclr;
 extern struct textzone *tz[NUM_TZ];
@@ -101,6 +107,51 @@ DEFINE_printchar_X_bpp(32)
 
 // --- end of printchar template function -------------------------------------
 
+// Get (or make) the pre-rendered font for a colour pair
+static Uint8 *get_glyphs( int fc, int bc )
+{
+  Uint8 **pg, *dst;
+  const Uint8 *src_byte;
+  Uint32 c;
+  int i, mask;
+
+  if( ( fc >= NUM_GUI_COLS ) || ( bc >= NUM_GUI_COLS ) )
+    return NULL;
+
+  pg = &glyphs[fc*NUM_GUI_COLS+bc];
+  if( *pg ) return *pg;
+
+  *pg = malloc( 128*12*8*pixel_size );
+  if( !*pg ) return NULL;
+
+  dst = *pg;
+  src_byte = thefont;
+  for( i=128*12; i!=0; --i, ++src_byte )
+  {
+    for( mask=0x80; mask; mask>>=1, dst+=pixel_size )
+    {
+      c = ((*src_byte)&mask) ? gpal[fc] : gpal[bc];
+      if( pixel_size == 2 )
+        *((Uint16 *)dst) = (Uint16)c;
+      else
+        *((Uint32 *)dst) = c;
+    }
+  }
+
+  return *pg;
+}
+
+static void free_glyphs( void )
+{
+  int i;
+
+  for( i=0; i<NUM_GUI_COLS*NUM_GUI_COLS; i++ )
+  {
+    if( glyphs[i] ) free( glyphs[i] );
+    glyphs[i] = NULL;
+  }
+}
+
 void render_begin_sw( struct machine *oric )
 {
   int x, y;
@@ -109,6 +160,8 @@ void render_begin_sw( struct machine *oric )
   if( SDL_MUSTLOCK( screen ) )
     SDL_LockSurface( screen );
 
+  tz_newframe();
+
   if( oric->newpopupstr )
   {
     dst_scanline = (Uint8*)screen->pixels;
@@ -132,6 +185,7 @@ void render_begin_sw( struct machine *oric )
           *dst_pixel = gpal[0];
       }
     }
+    tz_invalidate_rect( 320, 0, 320, 12, -1 );
     oric->newpopupstr = SDL_FALSE;
   }
   
@@ -159,6 +213,7 @@ void render_end_sw( struct machine *oric )
 
       for( i=0; oric->popupstr[i]; i++, dst_pixel += char_pitch )
         printchar( dst_pixel, oric->popupstr[i], gpal[1], gpal[0], SDL_TRUE );
+      tz_invalidate_rect( 320, 0, i*8, 12, -1 );
     }
   
     if( oric->statusstr[0] )
@@ -168,6 +223,7 @@ void render_end_sw( struct machine *oric )
 
       for( i=0; oric->statusstr[i]; i++, dst_pixel += char_pitch )
         printchar( dst_pixel, oric->statusstr[i], gpal[1], 0, SDL_FALSE );
+      tz_invalidate_rect( 0, 466, i*8, 12, -1 );
     }
   }
 
@@ -185,27 +241,59 @@ void render_textzone_free_sw( struct machine *oric, int i )
 {
 }
 
+// Only the cells that changed since the textzone was last drawn are
+// redrawn, by copying them from the pre-rendered font.
 void render_textzone_sw( struct machine *oric, int i )
 {
-  int x, y, o;
+  int x, y, o, cy;
   Uint32 char_pitch;
   struct textzone *ptz = tz[i];
-  Uint8 *dst_scanline, *dst_pixel;
+  Uint8 *dst_scanline, *dst_pixel, *dst, *src;
+  int run;
 
   char_pitch = 8 * pixel_size;
 
   dst_scanline = (Uint8 *)screen->pixels;
   dst_scanline += screen->pitch * ptz->y + pixel_size * ptz->x;
 
+  tz_begindraw( i );
+
+  // Runs of cells drawn along each row are passed on to tz_drawn_over,
+  // since they may be over other textzones
   o = 0;
   for( y=ptz->h; y!=0; --y, dst_scanline+=12*screen->pitch )
   {
     dst_pixel = dst_scanline;
+    run = -1;
 
     for( x=ptz->w; x!=0; --x, ++o, dst_pixel+=char_pitch )
-      printchar( dst_pixel, ptz->tx[o], gpal[ptz->fc[o]], gpal[ptz->bc[o]], SDL_TRUE );
+    {
+      if( ( !tz_cell_changed( ptz, o ) ) || ( ptz->tx[o] > 127 ) )
+      {
+        if( run >= 0 )
+          tz_drawn_over( i, ptz->x+run*8, ptz->y+(ptz->h-y)*12, (ptz->w-x-run)*8, 12 );
+        run = -1;
+        continue;
+      }
+      if( run < 0 ) run = ptz->w-x;
+
+      src = get_glyphs( ptz->fc[o], ptz->bc[o] );
+      if( !src )
+      {
+        printchar( dst_pixel, ptz->tx[o], gpal[ptz->fc[o]], gpal[ptz->bc[o]], SDL_TRUE );
+        continue;
+      }
+
+      src += ptz->tx[o]*12*char_pitch;
+      for( cy=12, dst=dst_pixel; cy!=0; --cy, dst+=screen->pitch, src+=char_pitch )
+        memcpy( dst, src, char_pitch );
+    }
+
+    if( run >= 0 )
+      tz_drawn_over( i, ptz->x+run*8, ptz->y+(ptz->h-y)*12, (ptz->w-run)*8, 12 );
   }
 
+  ptz->redraw = SDL_FALSE;
 }
 
 // Clear an area to background
@@ -219,6 +307,8 @@ void render_clear_area_sw( int x, int y, int w, int h )
 
   for( i=0; i<h; i++, dst_scanline+=screen->pitch )
     memset( dst_scanline, 0, pixel_size*w );
+
+  tz_invalidate_rect( x, y, w, h, -1 );
 }
 
 // Draw a GUI image at X,Y
@@ -235,6 +325,8 @@ void render_gimg_sw( int img_id, Sint32 xp, Sint32 yp )
 
   for( i=gi->h; i!=0; --i, src_scanline+=pixel_size*gi->w, dst_scanline+=screen->pitch )
     memcpy( dst_scanline, src_scanline, pixel_size*gi->w );
+
+  tz_invalidate_rect( xp, yp, gi->w, gi->h, -1 );
 }
 
 // Draw part of an image (xp,yp = screen location, ox, oy = offset into image, w, h = dimensions)
@@ -253,15 +345,16 @@ void render_gimgpart_sw( int img_id, Sint32 xp, Sint32 yp, Sint32 ox, Sint32 oy,
   for( i=h; i!=0; --i, src_scanline+=pixel_size*gi->w, dst_scanline+=screen->pitch )
     memcpy( dst_scanline, src_scanline, pixel_size*w );
 
+  tz_invalidate_rect( xp, yp, w, h, -1 );
 }
 
 // Copy the video output buffer to the SDL surface, assuming 16bpp video mode
 void render_video_sw_16bpp( struct machine *oric, SDL_bool doublesize )
 {
-  int x, y;
+  int x, y, first = -1, last = -1;
   Uint8 *src_pixel;
   Sint32 dst_pitch_x2;
-  Uint32 c;
+  Uint32 c, prev, *even, *odd;
   Uint8 *dst_scanline, *dst_even_scanline, *dst_odd_scanline;
   Uint16 *dst_pixel;
   Uint32 *dst_even_pixel, *dst_odd_pixel;
@@ -274,6 +367,7 @@ void render_video_sw_16bpp( struct machine *oric, SDL_bool doublesize )
     if( needclr )
     {
       SDL_FillRect(screen, NULL, gpal[0]);
+      tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
       needclr = SDL_FALSE;
     }
 
@@ -286,54 +380,42 @@ void render_video_sw_16bpp( struct machine *oric, SDL_bool doublesize )
     dst_odd_scanline = dst_even_scanline;
     dst_odd_scanline += screen->pitch;
 
-    if( oric->scanlines )
+    even = dpal[oric->swpalghost ? 1 : 0][0];
+    odd  = dpal[oric->swpalghost ? 1 : 0][oric->scanlines ? 1 : 0];
+
+    for( y=0; y<224; y++, dst_even_scanline+=dst_pitch_x2, dst_odd_scanline+=dst_pitch_x2 )
     {
-      for( y=0; y<224; y++, dst_even_scanline+=dst_pitch_x2, dst_odd_scanline+=dst_pitch_x2 )
+      if (!oric->vid_dirty[y])
       {
-        if (!oric->vid_dirty[y])
-        {
-          src_pixel += 240;
-          continue;
-        }
-        dst_even_pixel = (Uint32*)dst_even_scanline;
-        dst_odd_pixel  = (Uint32*)dst_odd_scanline;
-
-        for( x=240; x!=0; --x )
-        {
-          c = *(src_pixel++);
-          *(dst_even_pixel++) = dpal[c];
-          *(dst_odd_pixel++)  = dpal[c+8];
-        }
-        oric->vid_dirty[y] = SDL_FALSE;
-
+        src_pixel += 240;
+        continue;
       }
-    } else {
-      for( y=0; y<224; y++, dst_even_scanline+=dst_pitch_x2, dst_odd_scanline+=dst_pitch_x2 )
-      {
-        if (!oric->vid_dirty[y])
-        {
-          src_pixel += 240;
-          continue;
-        }
-        dst_even_pixel = (Uint32*)dst_even_scanline;
-        dst_odd_pixel  = (Uint32*)dst_odd_scanline;
+      if( first < 0 ) first = y;
+      last = y;
+      dst_even_pixel = (Uint32*)dst_even_scanline;
+      dst_odd_pixel  = (Uint32*)dst_odd_scanline;
 
-        for( x=240; x!=0; --x ) 
-        {
-            c = dpal[*(src_pixel++)];
-            *(dst_even_pixel++) = c;
-            *(dst_odd_pixel++)  = c;
-        }
-        oric->vid_dirty[y] = SDL_FALSE;
+      for( x=240, prev=0; x!=0; --x )
+      {
+        c = (prev<<3) | *src_pixel;
+        prev = *(src_pixel++);
+        *(dst_even_pixel++) = even[c];
+        *(dst_odd_pixel++)  = odd[c];
       }
+      oric->vid_dirty[y] = SDL_FALSE;
     }
+
+    if( first >= 0 )
+      tz_invalidate_rect( 80, 14+first*2, 480, (last-first+1)*2, -1 );
     return;
   }
 
   needclr = SDL_TRUE;
+  tz_invalidate_rect( 0, 0, 240, 228, -1 );
 
   src_pixel = oric->scr;
   dst_scanline = (Uint8*)screen->pixels;
+  even = pal[oric->swpalghost ? 1 : 0][0];
 
   for( y=0; y<4; y++ )
   {
@@ -344,18 +426,22 @@ void render_video_sw_16bpp( struct machine *oric, SDL_bool doublesize )
   {
     dst_pixel = (Uint16*)dst_scanline;
 
-    for( x=240; x!=0; --x )
-      *(dst_pixel++) = (Uint16)pal[*(src_pixel++)];
+    for( x=240, prev=0; x!=0; --x )
+    {
+      c = (prev<<3) | *src_pixel;
+      prev = *(src_pixel++);
+      *(dst_pixel++) = (Uint16)even[c];
+    }
   }
 }
 
 // Copy the video output buffer to the SDL surface, assuming 32bpp video mode
 void render_video_sw_32bpp( struct machine *oric, SDL_bool doublesize )
 {
-  int x, y;
+  int x, y, first = -1, last = -1;
   Uint8 *src_pixel;
   Sint32 dst_pitch_x2;
-  Uint32 c, c2;
+  Uint32 c, c2, prev, *even, *odd;
   Uint8 *dst_scanline, *dst_even_scanline, *dst_odd_scanline;
   Uint32 *dst_pixel, *dst_even_pixel, *dst_odd_pixel;
 
@@ -367,6 +453,7 @@ void render_video_sw_32bpp( struct machine *oric, SDL_bool doublesize )
     if( needclr )
     {
       SDL_FillRect(screen, NULL, gpal[0]);
+      tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
       needclr = SDL_FALSE;
     }
 
@@ -379,62 +466,48 @@ void render_video_sw_32bpp( struct machine *oric, SDL_bool doublesize )
     dst_odd_scanline = dst_even_scanline;
     dst_odd_scanline += screen->pitch;
 
-    if( oric->scanlines )
+    even = pal[oric->swpalghost ? 1 : 0][0];
+    odd  = pal[oric->swpalghost ? 1 : 0][oric->scanlines ? 1 : 0];
+
+    for( y=0; y<224; y++, dst_even_scanline+=dst_pitch_x2, dst_odd_scanline+=dst_pitch_x2 )
     {
-      for( y=0; y<224; y++, dst_even_scanline+=dst_pitch_x2, dst_odd_scanline+=dst_pitch_x2 )
+      if (!oric->vid_dirty[y])
       {
-        if (!oric->vid_dirty[y])
-        {
-          src_pixel += 240;
-          continue;
-        }
-        dst_even_pixel = (Uint32*)dst_even_scanline;
-        dst_odd_pixel  = (Uint32*)dst_odd_scanline;
-
-        for( x=240; x!=0; --x )
-        {
-          c2 = pal[(*src_pixel)+8];
-          c = pal[*(src_pixel++)];
-
-          *(dst_even_pixel++) = c;
-          *(dst_even_pixel++) = c;
-          *(dst_odd_pixel++)  = c2;
-          *(dst_odd_pixel++)  = c2;
-        }
-
-        oric->vid_dirty[y] = SDL_FALSE;
-
+        src_pixel += 240;
+        continue;
       }
-    } else {
-      for( y=0; y<224; y++, dst_even_scanline+=dst_pitch_x2, dst_odd_scanline+=dst_pitch_x2 )
+      if( first < 0 ) first = y;
+      last = y;
+      dst_even_pixel = (Uint32*)dst_even_scanline;
+      dst_odd_pixel  = (Uint32*)dst_odd_scanline;
+
+      for( x=240, prev=0; x!=0; --x )
       {
-        if (!oric->vid_dirty[y])
-        {
-          src_pixel += 240;
-          continue;
-        }
-        dst_even_pixel = (Uint32*)dst_even_scanline;
-        dst_odd_pixel  = (Uint32*)dst_odd_scanline;
-
-        for( x=240; x!=0; --x ) 
-          {
-            c = pal[*(src_pixel++)];
-
-            *(dst_even_pixel++) = c;
-            *(dst_even_pixel++) = c;
-            *(dst_odd_pixel++)  = c;
-            *(dst_odd_pixel++)  = c;
-         }
-        oric->vid_dirty[y] = SDL_FALSE;
+        c = (prev<<3) | *src_pixel;
+        prev = *(src_pixel++);
+        c2 = odd[c];
+        c = even[c];
+
+        *(dst_even_pixel++) = c;
+        *(dst_even_pixel++) = c;
+        *(dst_odd_pixel++)  = c2;
+        *(dst_odd_pixel++)  = c2;
       }
+
+      oric->vid_dirty[y] = SDL_FALSE;
     }
+
+    if( first >= 0 )
+      tz_invalidate_rect( 80, 14+first*2, 480, (last-first+1)*2, -1 );
     return;
   }
 
   needclr = SDL_TRUE;
+  tz_invalidate_rect( 0, 0, 240, 228, -1 );
 
   src_pixel = oric->scr;
   dst_scanline = (Uint8*)screen->pixels;
+  even = pal[oric->swpalghost ? 1 : 0][0];
 
   for( y=0; y<4; y++ )
   {
@@ -446,8 +519,12 @@ void render_video_sw_32bpp( struct machine *oric, SDL_bool doublesize )
   {
     dst_pixel = (Uint32*)dst_scanline;
 
-    for( x=240; x!=0; --x )
-      *(dst_pixel++) = pal[*(src_pixel++)];
+    for( x=240, prev=0; x!=0; --x )
+    {
+      c = (prev<<3) | *src_pixel;
+      prev = *(src_pixel++);
+      *(dst_pixel++) = even[c];
+    }
   }
 }
 
@@ -483,6 +560,9 @@ void preinit_render_sw( struct machine *oric )
   // Images are not set yet
   for( i=0; i<NUM_GIMG; i++ )
     mgimg[i] = NULL;
+
+  for( i=0; i<NUM_GUI_COLS*NUM_GUI_COLS; i++ )
+    glyphs[i] = NULL;
 }
 
 SDL_bool render_togglefullscreen_sw( struct machine *oric )
@@ -492,6 +572,7 @@ SDL_bool render_togglefullscreen_sw( struct machine *oric )
   if( SDL_COMPAT_WM_ToggleFullScreen( screen ) )
   {
     fullscreen = !fullscreen;
+    tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
     return SDL_TRUE;
   }
 
@@ -540,8 +621,8 @@ DEFINE_guiimg_to_img_X_bpp(32)
 
 SDL_bool init_render_sw( struct machine *oric )
 {
-  int i;
-  unsigned char* pal_it;
+  int i, j, g, h, rgb[3];
+  unsigned char *pal_it, *prev_it;
   Sint32 surfacemode;
 
   pixel_size = oric->sw_depth / 8;
@@ -581,12 +662,28 @@ SDL_bool init_render_sw( struct machine *oric )
   for( i=0; i<NUM_GUI_COLS; i++, pal_it+=3 )
     gpal[i] = SDL_MapRGB( screen->format, pal_it[0], pal_it[1], pal_it[2] );
 
-  // Convert the Oric palette to the screen format bti depth
-  pal_it = oricpalette;
-  for( i=0; i<8; i++, pal_it+=3 )
+  // Convert the Oric palette to the screen format bit depth. PAL ghosting
+  // bleeds a quarter of the previous pixel into the current one (like the
+  // offset overlay in the OpenGL renderer), and scanline rows are drawn at
+  // half brightness. Doing it per pixel pair means the renderer needs just
+  // one table lookup per pixel, whichever options are on.
+  for( g=0; g<2; g++ )
   {
-    pal[i  ] = SDL_MapRGB( screen->format, pal_it[0],   pal_it[1],   pal_it[2] );
-    pal[i+8] = SDL_MapRGB( screen->format, pal_it[0]/2, pal_it[1]/2, pal_it[2]/2 );
+    for( h=0; h<2; h++ )
+    {
+      for( i=0; i<8*8; i++ )
+      {
+        prev_it = &oricpalette[(i>>3)*3];
+        pal_it  = &oricpalette[(i&7)*3];
+        for( j=0; j<3; j++ )
+        {
+          rgb[j] = g ? (pal_it[j]*3+prev_it[j])/4 : pal_it[j];
+          if( h ) rgb[j] /= 2;
+        }
+        pal[g][h][i]  = SDL_MapRGB( screen->format, rgb[0], rgb[1], rgb[2] );
+        dpal[g][h][i] = (pal[g][h][i]<<16)|pal[g][h][i];
+      }
+    }
   }
 
   // Get the images for the GUI
@@ -594,12 +691,12 @@ SDL_bool init_render_sw( struct machine *oric )
     if (!guiimg_to_img(mgimg + i, gimgs + i))
       return SDL_FALSE;
 
-  // Precompute pixels pairs for efficient rendering in 16 bpp mode
-  for( i=0; i<8*2; i++ )
-    dpal[i] = (pal[i]<<16)|pal[i];
+  // The GUI palette may have changed
+  free_glyphs();
 
   // For the first frame rendered, we need to clean the screen
   needclr = SDL_TRUE;
+  tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
   refreshstatus = SDL_TRUE;
 
   // Calculate the offset to render the screen
@@ -622,5 +719,7 @@ void shut_render_sw( struct machine *oric )
     mgimg[i] = NULL;
   }
 
+  free_glyphs();
+
   // The surface will be freed by SDL_Quit, or a call to SDL_COMPAT_SetVideoMode from a different render module
 }
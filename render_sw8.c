@@ -54,6 +54,10 @@ static Uint8 *mgimg[NUM_GIMG];
 static int next_gimgcol;
 static SDL_Color colours[256];
 
+// Font pre-rendered with the GUI pens for each colour
+// pair (fg*NUM_GUI_COLS+bg), created the first time it is used
+static Uint8 *glyphs[NUM_GUI_COLS*NUM_GUI_COLS];
+
 // Our "lovely" hand-coded font
 extern unsigned char thefont[];
 
@@ -91,6 +95,32 @@ static void printchar( Uint8* ptr, unsigned char ch, Uint8 fcol, Uint8 bcol, SDL
   }
 }
 
+// Get (or make) the pre-rendered font for a colour pair
+static Uint8 *get_glyphs( int fc, int bc )
+{
+  Uint8 **pg, *dst;
+  const Uint8 *src_byte;
+  int i, mask;
+
+  if( ( fc >= NUM_GUI_COLS ) || ( bc >= NUM_GUI_COLS ) )
+    return NULL;
+
+  pg = &glyphs[fc*NUM_GUI_COLS+bc];
+  if( *pg ) return *pg;
+
+  *pg = malloc( 128*12*8 );
+  if( !*pg ) return NULL;
+
+  dst = *pg;
+  src_byte = thefont;
+  for( i=128*12; i!=0; --i, ++src_byte )
+  {
+    for( mask=0x80; mask; mask>>=1 )
+      *(dst++) = GPAL_FIRSTPEN + (((*src_byte)&mask) ? fc : bc);
+  }
+
+  return *pg;
+}
 
 void render_begin_sw8( struct machine *oric )
 {
@@ -100,6 +130,8 @@ void render_begin_sw8( struct machine *oric )
   if( SDL_MUSTLOCK( screen ) )
     SDL_LockSurface( screen );
 
+  tz_newframe();
+
   if( oric->newpopupstr )
   {
     dst_scanline = (Uint8*)screen->pixels;
@@ -107,6 +139,7 @@ void render_begin_sw8( struct machine *oric )
 
     for( y=12; y!=0; --y, dst_scanline += screen->pitch)
       memset(dst_scanline, GPAL_FIRSTPEN, 320);
+    tz_invalidate_rect( 320, 0, 320, 12, -1 );
     oric->newpopupstr = SDL_FALSE;
   }
   
@@ -134,6 +167,7 @@ void render_end_sw8( struct machine *oric )
 
       for( i=0; oric->popupstr[i]; i++, dst_pixel += char_pitch )
         printchar( dst_pixel, oric->popupstr[i], GPAL_FIRSTPEN+1, GPAL_FIRSTPEN, SDL_TRUE );
+      tz_invalidate_rect( 320, 0, i*8, 12, -1 );
     }
   
     if( oric->statusstr[0] )
@@ -143,6 +177,7 @@ void render_end_sw8( struct machine *oric )
 
       for( i=0; oric->statusstr[i]; i++, dst_pixel += char_pitch )
         printchar( dst_pixel, oric->statusstr[i], GPAL_FIRSTPEN+1, 0, SDL_FALSE );
+      tz_invalidate_rect( 0, 466, i*8, 12, -1 );
     }
   }
 
@@ -160,23 +195,56 @@ void render_textzone_free_sw8( struct machine *oric, int i )
 {
 }
 
+// Only the cells that changed since the textzone was last drawn are
+// redrawn, by copying them from the pre-rendered font.
 void render_textzone_sw8( struct machine *oric, int i )
 {
-  int x, y, o;
+  int x, y, o, cy;
   struct textzone *ptz = tz[i];
-  Uint8 *dst_scanline, *dst_pixel;
+  Uint8 *dst_scanline, *dst_pixel, *dst, *src;
+  int run;
 
   dst_scanline = (Uint8 *)screen->pixels;
   dst_scanline += screen->pitch * ptz->y + ptz->x;
 
+  tz_begindraw( i );
+
+  // Runs of cells drawn along each row are passed on to tz_drawn_over,
+  // since they may be over other textzones
   o = 0;
   for( y=ptz->h; y!=0; --y, dst_scanline+=12*screen->pitch )
   {
     dst_pixel = dst_scanline;
+    run = -1;
 
     for( x=ptz->w; x!=0; --x, ++o, dst_pixel+=8 )
-      printchar( dst_pixel, ptz->tx[o], GPAL_FIRSTPEN+ptz->fc[o], GPAL_FIRSTPEN+ptz->bc[o], SDL_TRUE );
+    {
+      if( ( !tz_cell_changed( ptz, o ) ) || ( ptz->tx[o] > 127 ) )
+      {
+        if( run >= 0 )
+          tz_drawn_over( i, ptz->x+run*8, ptz->y+(ptz->h-y)*12, (ptz->w-x-run)*8, 12 );
+        run = -1;
+        continue;
+      }
+      if( run < 0 ) run = ptz->w-x;
+
+      src = get_glyphs( ptz->fc[o], ptz->bc[o] );
+      if( !src )
+      {
+        printchar( dst_pixel, ptz->tx[o], GPAL_FIRSTPEN+ptz->fc[o], GPAL_FIRSTPEN+ptz->bc[o], SDL_TRUE );
+        continue;
+      }
+
+      src += ptz->tx[o]*12*8;
+      for( cy=12, dst=dst_pixel; cy!=0; --cy, dst+=screen->pitch, src+=8 )
+        memcpy( dst, src, 8 );
+    }
+
+    if( run >= 0 )
+      tz_drawn_over( i, ptz->x+run*8, ptz->y+(ptz->h-y)*12, (ptz->w-run)*8, 12 );
   }
+
+  ptz->redraw = SDL_FALSE;
 }
 
 // Clear an area to background
@@ -190,6 +258,8 @@ void render_clear_area_sw8( int x, int y, int w, int h )
 
   for( i=0; i<h; i++, dst_scanline+=screen->pitch )
     memset( dst_scanline, 0, w );
+
+  tz_invalidate_rect( x, y, w, h, -1 );
 }
 
 // Draw a GUI image at X,Y
@@ -206,6 +276,8 @@ void render_gimg_sw8( int img_id, Sint32 xp, Sint32 yp )
 
   for( i=gi->h; i!=0; --i, src_scanline+=gi->w, dst_scanline+=screen->pitch )
     memcpy( dst_scanline, src_scanline, gi->w );
+
+  tz_invalidate_rect( xp, yp, gi->w, gi->h, -1 );
 }
 
 // Draw part of an image (xp,yp = screen location, ox, oy = offset into image, w, h = dimensions)
@@ -223,12 +295,14 @@ void render_gimgpart_sw8( int img_id, Sint32 xp, Sint32 yp, Sint32 ox, Sint32 oy
 
   for( i=h; i!=0; --i, src_scanline+=gi->w, dst_scanline+=screen->pitch )
     memcpy( dst_scanline, src_scanline, w );
+
+  tz_invalidate_rect( xp, yp, w, h, -1 );
 }
 
 // Copy the video output buffer to the SDL surface, assuming 16bpp video mode
 void render_video_sw8( struct machine *oric, SDL_bool doublesize )
 {
-  int x, y;
+  int x, y, first = -1, last = -1;
   Uint16 *src_pixel;
   Sint32 dst_pitch_x2;
   Uint32 c;
@@ -243,6 +317,7 @@ void render_video_sw8( struct machine *oric, SDL_bool doublesize )
     if( needclr )
     {
       SDL_FillRect(screen, NULL, GPAL_FIRSTPEN);
+      tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
       needclr = SDL_FALSE;
     }
 
@@ -264,6 +339,8 @@ void render_video_sw8( struct machine *oric, SDL_bool doublesize )
           src_pixel += 120;
           continue;
         }
+        if( first < 0 ) first = y;
+        last = y;
         dst_even_pixel = (Uint32*)dst_even_scanline;
         dst_odd_pixel  = (Uint32*)dst_odd_scanline;
 
@@ -284,6 +361,8 @@ void render_video_sw8( struct machine *oric, SDL_bool doublesize )
           src_pixel += 120;
           continue;
         }
+        if( first < 0 ) first = y;
+        last = y;
         dst_even_pixel = (Uint32*)dst_even_scanline;
         dst_odd_pixel  = (Uint32*)dst_odd_scanline;
 
@@ -296,10 +375,14 @@ void render_video_sw8( struct machine *oric, SDL_bool doublesize )
         oric->vid_dirty[y] = SDL_FALSE;
       }
     }
+
+    if( first >= 0 )
+      tz_invalidate_rect( 80, 14+first*2, 480, (last-first+1)*2, -1 );
     return;
   }
 
   needclr = SDL_TRUE;
+  tz_invalidate_rect( 0, 0, 240, 228, -1 );
 
   src_pixel = (Uint16 *)oric->scr;
   dst_scanline = (Uint8*)screen->pixels;
@@ -318,8 +401,13 @@ void render_video_sw8( struct machine *oric, SDL_bool doublesize )
 
 void preinit_render_sw8( struct machine *oric )
 {
+  int i;
+
   // Screen surface is not set yet
   screen = NULL;
+
+  for( i=0; i<NUM_GUI_COLS*NUM_GUI_COLS; i++ )
+    glyphs[i] = NULL;
 }
 
 SDL_bool render_togglefullscreen_sw8( struct machine *oric )
@@ -329,6 +417,7 @@ SDL_bool render_togglefullscreen_sw8( struct machine *oric )
   if( SDL_COMPAT_WM_ToggleFullScreen( screen ) )
   {
     fullscreen = !fullscreen;
+    tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
     return SDL_TRUE;
   }
 
@@ -460,6 +549,7 @@ SDL_bool init_render_sw8( struct machine *oric )
 
   // For the first frame rendered, we need to clean the screen
   needclr = SDL_TRUE;
+  tz_invalidate_rect( 0, 0, screen->w, screen->h, -1 );
   refreshstatus = SDL_TRUE;
 
   // Calculate the offset to render the screen
@@ -473,6 +563,14 @@ SDL_bool init_render_sw8( struct machine *oric )
 
 void shut_render_sw8( struct machine *oric )
 {
+  int i;
+
+  for( i=0; i<NUM_GUI_COLS*NUM_GUI_COLS; i++ )
+  {
+    if( glyphs[i] ) free( glyphs[i] );
+    glyphs[i] = NULL;
+  }
+
   // The surface will be freed by SDL_Quit, or a call to SDL_COMPAT_SetVideoMode from a different render module
 }
 
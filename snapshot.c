@@ -39,6 +39,7 @@
 #include "ula.h"
 #include "joystick.h"
 #include "tape.h"
+#include "wavstream.h"
 #include "msgbox.h"
 
 extern char diskpath[];
@@ -152,6 +153,9 @@ SDL_bool save_snapshot(struct machine *oric, char *filename)
   int i, j;
   FILE *f = NULL;
 
+  // Bring the lazily counted tape state up to date
+  tape_sync(oric);
+
   buf = malloc(MAX_BLOCK);
   if (!buf)
   {
@@ -182,23 +186,23 @@ SDL_bool save_snapshot(struct machine *oric, char *filename)
   DATABLOCK(oric->mem, oric->memsize);
 
   NEWBLOCK("TAP\x00");
-  PUTU8(oric->tapebit);
-  PUTU8(oric->tapeout);
-  PUTU8(oric->tapeparity);
-  PUTU32(oric->tapelen);
-  PUTU32(oric->tapeoffs);
-  PUTU32(oric->tapecount);
-  PUTU32(oric->tapetime);
-  PUTU32(oric->tapedupbytes);
-  PUTU32(oric->tapehdrend);
-  PUTU32(oric->tapedelay);
+  PUTU8(oric->tape.bit);
+  PUTU8(oric->tape.out);
+  PUTU8(oric->tape.parity);
+  PUTU32((oric->tape.stream ? 0 : oric->tape.len));   // Streamed WAVs aren't kept
+  PUTU32(oric->tape.offs);
+  PUTU32(oric->tape.count);
+  PUTU32(oric->tape.time);
+  PUTU32(oric->tape.dupbytes);
+  PUTU32(oric->tape.hdrend);
+  PUTU32(oric->tape.delay);
   PUTU8(oric->tapemotor);
   PUTU8(oric->tapeturbo_forceoff);
-  PUTU8(oric->rawtape);
-  PUTU32(oric->nonrawend);
-  PUTU32(oric->tapehitend);
+  PUTU8(oric->tape.raw);
+  PUTU32(oric->tape.nonrawend);
+  PUTU32(oric->tape.hitend);
   PUTU32(oric->tapeturbo_syncstack);
-  DATABLOCK(oric->tapebuf, oric->tapelen);
+  DATABLOCK(oric->tape.buf, oric->tape.stream ? 0 : oric->tape.len);
 
   // Patches
   NEWBLOCK("PCH\0x00");
@@ -249,7 +253,7 @@ SDL_bool save_snapshot(struct machine *oric, char *filename)
   PUTU8(oric->ay.creg);
   PUTDATA(&oric->ay.eregs[0], NUM_AY_REGS);
   for (i=0; i<8; i++)
-    PUTU8(oric->ay.keystates[i]);
+    PUTU8(oric->ay.keyrows[i]);
   for (i=0; i<3; i++)
     PUTU32(oric->ay.toneper[i]);
   PUTU32(oric->ay.noiseper);
@@ -415,6 +419,7 @@ SDL_bool save_snapshot(struct machine *oric, char *filename)
         PUTU16(oric->wddisk.disk[i]->cachedtrack);
         PUTU16(oric->wddisk.disk[i]->cachedside);
         PUTU32(oric->wddisk.disk[i]->rawimagelen);
+        diskimage_inflate(oric->wddisk.disk[i], oric->wddisk.disk[i]->rawimagelen);
         DATABLOCK(oric->wddisk.disk[i]->rawimage, oric->wddisk.disk[i]->rawimagelen);
       }
     }
@@ -793,6 +798,9 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
 
   back2mon = oric->emu_mode == EM_DEBUG;
 
+  // Whatever tape state is loaded gets rescheduled after the next instruction
+  tape_sync(oric);
+
   f = fopen(filename, "rb");
   if (!f)
   {
@@ -851,12 +859,15 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
 
   /* Clear things that will get replaced */
   clear_patches( oric );
-  if (oric->tapebuf)
+  if (oric->tape.stream)
+    wavstream_close(&oric->tape.stream);
+  if (oric->tape.buf)
   {
-    free(oric->tapebuf);
-    oric->tapebuf = NULL;
-    oric->tapelen = 0;
+    free(oric->tape.buf);
+    oric->tape.buf = NULL;
+    oric->tape.len = 0;
   }
+  tape_buildindex(oric);
 
   blk->offs = 1;
   oric->overclockmult  = getu32(blk);
@@ -929,7 +940,7 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
   getdata(blk, &oric->ay.eregs[0], NUM_AY_REGS);
   memcpy(&oric->ay.regs[0], &oric->ay.eregs[0], NUM_AY_REGS);
   for (i=0; i<8; i++)
-    oric->ay.keystates[i] = getu8(blk);
+    oric->ay.keyrows[i] = getu8(blk);
   for (i=0; i<3; i++)
     oric->ay.toneper[i] = getu32(blk);
   oric->ay.noiseper     = getu32(blk);
@@ -957,6 +968,7 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
   oric->ay.rndrack      = getu32(blk);
   oric->ay.keybitdelay  = getu32(blk);
   oric->ay.currkeyoffs  = getu32(blk);
+  ay_restore( &oric->ay );
 
   // Finished with this one
   free_block(blk);
@@ -1020,32 +1032,32 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
     return SDL_FALSE;
   }
 
-  oric->tapebit     = getu8 (blk);
-  oric->tapeout     = getu8 (blk);
-  oric->tapeparity  = getu8 (blk);
-  oric->tapelen     = getu32(blk);
-  oric->tapeoffs    = getu32(blk);
-  oric->tapecount   = getu32(blk);
-  oric->tapetime    = getu32(blk);
-  oric->tapedupbytes= getu32(blk);
-  oric->tapehdrend  = getu32(blk);
-  oric->tapedelay   = getu32(blk);
+  oric->tape.bit       = getu8 (blk);
+  oric->tape.out       = getu8 (blk);
+  oric->tape.parity    = getu8 (blk);
+  oric->tape.len       = getu32(blk);
+  oric->tape.offs      = getu32(blk);
+  oric->tape.count     = getu32(blk);
+  oric->tape.time      = getu32(blk);
+  oric->tape.dupbytes  = getu32(blk);
+  oric->tape.hdrend    = getu32(blk);
+  oric->tape.delay     = getu32(blk);
   oric->tapemotor   = getu8 (blk);
   oric->tapeturbo_forceoff= getu8(blk);
-  oric->rawtape     = getu8 (blk);
-  oric->nonrawend   = getu32(blk);
-  oric->tapehitend  = getu32(blk);
+  oric->tape.raw       = getu8 (blk);
+  oric->tape.nonrawend = getu32(blk);
+  oric->tape.hitend    = getu32(blk);
   oric->tapeturbo_syncstack = getu32(blk);
 
   if (!blk->datablock)
   {
-    oric->tapelen = 0;
-    oric->tapeoffs = 0;
+    oric->tape.len = 0;
+    oric->tape.offs = 0;
   }
   else
   {
-    oric->tapebuf = malloc(blk->datablock->size);
-    if (!oric->tapebuf)
+    oric->tape.buf = malloc(blk->datablock->size);
+    if (!oric->tape.buf)
     {
       msgbox(oric, MSGBOX_OK, "Snapshot load failed: Out of memory (19)");
       free_blockheaders();
@@ -1055,7 +1067,7 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
       return SDL_FALSE;
     }
 
-    if (!read_block(oric, blk->datablock, f, SDL_TRUE, oric->tapebuf))
+    if (!read_block(oric, blk->datablock, f, SDL_TRUE, oric->tape.buf))
     {
       free_blockheaders();
       fclose(f);
@@ -1064,6 +1076,7 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
       return SDL_FALSE;
     }
   }
+  tape_buildindex(oric);
 
   // Finished with this one
   free_block(blk);
@@ -1175,6 +1188,7 @@ SDL_bool load_snapshot(struct machine *oric, char *filename)
         oric->pravetz.drv[i].byte        = getu16(blk);
         oric->pravetz.drv[i].half_track  = getu16(blk);
         oric->pravetz.drv[i].dirty       = getu8(blk);
+        memset(oric->pravetz.drv[i].dirtytrack, oric->pravetz.drv[i].dirty ? 1 : 0, PRAV_TRACKS_PER_DISK);
         oric->pravetz.drv[i].prot        = getu8(blk);
       }
 
@@ -54,6 +54,21 @@
 
 #endif
 
+/* Platforms with POSIX mmap() */
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__HAIKU__)
+#define HAVE_MMAP 1
+#endif
+
+/* Platforms with POSIX pwrite() and fsync() */
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__HAIKU__)
+#define HAVE_PWRITE 1
+#endif
+
+/* Platforms with POSIX fseeko() */
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || defined(__HAIKU__)
+#define HAVE_FSEEKO 1
+#endif
+
 /* SDL related stuff */
 #include "system_sdl.h"
 
@@ -24,6 +24,14 @@
 
 #include "system.h"
 
+#if SDL_MAJOR_VERSION == 1
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
 #if SDL_MAJOR_VERSION == 1
 #ifdef __SPECIFY_SDL_DIR__
 #include <SDL/SDL_endian.h>
@@ -73,6 +81,7 @@ static int g_bpp = 0;
 static int g_width = 0;
 static int g_height = 0;
 
+static int g_swapinterval = 0;
 static int g_lastx = SDL_WINDOWPOS_CENTERED;
 static int g_lasty = SDL_WINDOWPOS_CENTERED;
 
@@ -321,6 +330,7 @@ SDL_Surface* SDL_COMPAT_SetVideoMode(int width, int height, int bitsperpixel, Ui
   {
     g_screen = SDL_GetWindowSurface(g_window);
     g_glcontext = SDL_GL_CreateContext(g_window);
+    SDL_GL_SetSwapInterval(g_swapinterval);
   }
   else
   {
@@ -375,16 +385,62 @@ void SDL_COMPAT_Quit(void)
 }
 #endif
 
+#if SDL_MAJOR_VERSION == 1
+SDL_Thread *SDL_COMPAT_CreateThread(int (*fn)(void *), const char *name, void *data)
+{
+  return SDL_CreateThread(fn, data);
+}
+#else
+SDL_Thread *SDL_COMPAT_CreateThread(int (*fn)(void *), const char *name, void *data)
+{
+  return SDL_CreateThread(fn, name, data);
+}
+#endif
+
+#if SDL_MAJOR_VERSION == 1
+int SDL_COMPAT_GetCPUCount(void)
+{
+#if defined(WIN32)
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (si.dwNumberOfProcessors > 0) ? si.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? n : 1;
+#else
+  return 1;
+#endif
+}
+#else
+int SDL_COMPAT_GetCPUCount(void)
+{
+  return SDL_GetCPUCount();
+}
+#endif
+
 #ifdef __OPENGL_AVAILABLE__
 #if SDL_MAJOR_VERSION == 1
 void SDL_COMPAT_GL_SwapBuffers(void)
 {
     SDL_GL_SwapBuffers();
 }
+
+// Only takes effect the next time the video mode is set
+void SDL_COMPAT_GL_SetSwapInterval(int interval)
+{
+    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, interval);
+}
 #else
 void SDL_COMPAT_GL_SwapBuffers(void)
 {
     SDL_GL_SwapWindow(g_window);
 }
+
+void SDL_COMPAT_GL_SetSwapInterval(int interval)
+{
+    g_swapinterval = interval;
+    if(g_glcontext)
+      SDL_GL_SetSwapInterval(interval);
+}
 #endif
 #endif
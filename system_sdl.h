@@ -144,9 +144,12 @@ SDL_Surface* SDL_COMPAT_SetVideoMode(int width, int height, int bitsperpixel, Ui
 int SDL_COMPAT_SetPalette(SDL_Surface *surface, int flags, SDL_Color *colors, int firstcolor, int ncolors);
 void SDL_COMPAT_SetEventFilter(SDL_EventFilter filter);
 void SDL_COMPAT_Quit(void);
+SDL_Thread *SDL_COMPAT_CreateThread(int (*fn)(void *), const char *name, void *data);
+int SDL_COMPAT_GetCPUCount(void);
 
 #ifdef __OPENGL_AVAILABLE__
 void SDL_COMPAT_GL_SwapBuffers(void);
+void SDL_COMPAT_GL_SetSwapInterval(int interval);
 #endif
 
 #endif /* ORICUTRON_SYSTEM_SDL_H */
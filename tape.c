@@ -36,6 +36,9 @@
 #include "filereq.h"
 #include "tape.h"
 #include "msgbox.h"
+#include "wavstream.h"
+#include "tapecap.h"
+#include "arcfile.h"
 
 extern char tapefile[], tapepath[];
 extern SDL_bool refreshtape;
@@ -62,13 +65,14 @@ void tape_popup( struct machine *oric )
 
 void toggletapecap( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 {
-  char ortheader[] = { 'O', 'R', 'T', 0 };  // Oric Raw Tape, Version 0
-
   /* If capturing, stop */
   if( oric->tapecap )
   {
-    fclose( oric->tapecap );
-    oric->tapecap = NULL;
+    // Finish off any section being CSAVEd into the capture first
+    if( oric->tsavf == oric->tapecap )
+      tape_stop_savepatch( oric );
+    if( !tapecap_close( &oric->tapecap ) )
+      msgbox( oric, MSGBOX_OK, "Error writing tape capture" );
     mitem->name = "Save tape output...";
     refreshtape = SDL_TRUE;
     return;
@@ -94,8 +98,8 @@ void toggletapecap( struct machine *oric, struct osdmenuitem *mitem, int dummy )
 
   joinpath( tapepath, tmptapename );
 
-  /* Open the file */
-  oric->tapecap = fopen( filetmp, "wb" );
+  /* Open the file (this writes the header) */
+  oric->tapecap = tapecap_open( filetmp, SDL_TRUE );
   if( !oric->tapecap )
   {
     /* Oh well */
@@ -103,9 +107,6 @@ void toggletapecap( struct machine *oric, struct osdmenuitem *mitem, int dummy )
     return;
   }
 
-  /* Write header */
-  fwrite( ortheader, 4, 1, oric->tapecap);
-  
   /* Counter reset */
   oric->tapecapcount = -1;
   oric->tapecaplastbit = (oric->via.orb&oric->via.ddrb)>>7;
@@ -115,47 +116,57 @@ void toggletapecap( struct machine *oric, struct osdmenuitem *mitem, int dummy )
   refreshtape = SDL_TRUE;
 }
 
-/* When we're loading a .tap file (or a non-raw section of a .ort file),
-** we have to do 2 things... First, we have to elongate the leader so the ROM
-** can see it, and secondly we have to add a delay after the header so that the
-** tape isn't several bytes into the program when the rom is ready to start
-** reading it.
-**
-** Only call it when you think you're at a tape leader since it doesn't do many
-** sanity checks.
+/* If there is a leader and header at "offs", return the offset just
+** past the end of the filename. Otherwise return 0.
 */
-void tape_setup_header( struct machine *oric )
+static int tape_headerend( unsigned char *buf, int offs, int len )
 {
   int i;
 
-  oric->tapedupbytes = 0;
-  oric->tapehdrend   = 0;
-
-  if( oric->tapebuf[oric->tapeoffs] != 0x16 )
-    return;
+  if( buf[offs] != 0x16 )
+    return 0;
 
   /* Does it look like a header? */
-  for( i=0; oric->tapebuf[oric->tapeoffs+i]==0x16; i++ )
+  for( i=0; buf[offs+i]==0x16; i++ )
   {
-    if( (oric->tapeoffs+i) >= oric->tapelen )
-      return;
+    if( (offs+i) >= len )
+      return 0;
   }
-  if( ( i < 3 ) || ( oric->tapebuf[oric->tapeoffs+i] != 0x24 ) )
-    return;
+  if( ( i < 3 ) || ( buf[offs+i] != 0x24 ) )
+    return 0;
   i++;
-  if( (oric->tapeoffs+i+9) >= oric->tapelen )
-    return;
+  if( (offs+i+9) >= len )
+    return 0;
   i+=9;
-  while( oric->tapebuf[oric->tapeoffs+i] != 0 )
+  while( buf[offs+i] != 0 )
   {
-    if( (oric->tapeoffs+i) >= oric->tapelen )
-      return;
+    if( (offs+i) >= len )
+      return 0;
     i++;
   }
   i++;
 
-  oric->tapedupbytes = 80;
-  oric->tapehdrend = oric->tapeoffs+i;
+  return offs+i;
+}
+
+/* When we're loading a .tap file (or a non-raw section of a .ort file),
+** we have to do 2 things... First, we have to elongate the leader so the ROM
+** can see it, and secondly we have to add a delay after the header so that the
+** tape isn't several bytes into the program when the rom is ready to start
+** reading it.
+**
+** Only call it when you think you're at a tape leader since it doesn't do many
+** sanity checks.
+*/
+void tape_setup_header( struct tapeplayer *tp )
+{
+  tp->dupbytes = 0;
+  tp->hdrend   = tape_headerend( tp->buf, tp->offs, tp->len );
+  if( tp->hdrend )
+  {
+    tp->dupbytes = 80;
+    if( tp->stats ) tp->stats->sections++;
+  }
 }
 
 
@@ -170,6 +181,9 @@ void tape_orbchange( struct via *via )
   
   /* Saving a tap section? */
   if( oric->tapecap == oric->tsavf ) return;
+
+  /* Bring tapecapcount up to date */
+  tape_sync( oric );
   
   tapebit = (via->orb & via->ddrb) >> 7;
   if( tapebit == oric->tapecaplastbit ) return;
@@ -181,7 +195,7 @@ void tape_orbchange( struct via *via )
   {
     /* Well, we found it */
     oric->tapecapcount = 0;
-    fputc( tapebit, oric->tapecap );
+    tapecap_putc( oric->tapecap, tapebit );
     return;
   }
 
@@ -213,7 +227,7 @@ void tape_orbchange( struct via *via )
     bufwrite = 3;
   }
 
-  fwrite( buffer, bufwrite, 1, oric->tapecap );
+  tapecap_write( oric->tapecap, buffer, bufwrite );
   oric->tapecapcount = 0;
 }
 
@@ -224,21 +238,23 @@ void tape_setmotor( struct machine *oric, SDL_bool motoron )
   if( motoron == oric->tapemotor )
     return;
 
+  tape_sync( oric );
+
   // Refresh the tape status icon in the status bar
   refreshtape = SDL_TRUE;
 
   // "Real" tape emulation?
   if( ( !oric->tapeturbo ) || ( !oric->pch_tt_available ) )
   {
-    if( ( !oric->rawtape ) || ( oric->tapeoffs < oric->nonrawend ) )
+    if( ( !oric->tape.raw ) || ( oric->tape.offs < oric->tape.nonrawend ) )
     {
       // If we're stopping part way through a byte, just move
       // the current position on to the start of the next byte
       if( !motoron )
       {
-        if( oric->tapebit > 0 )
-          oric->tapeoffs++;
-        oric->tapebit = 0;
+        if( oric->tape.bit > 0 )
+          oric->tape.offs++;
+        oric->tape.bit = 0;
       }
 
       // If we're starting the tape motor and the tape
@@ -246,11 +262,11 @@ void tape_setmotor( struct machine *oric, SDL_bool motoron )
       // sync bytes. This makes the Oric Atmos welcome tape
       // work without turbo tape enabled, for example.
       if( ( motoron ) &&
-          ( oric->tapebuf ) &&
-          ( oric->tapeoffs < oric->tapelen ) &&
-          ( oric->tapebuf[oric->tapeoffs] == 0x16 ) )
+          ( oric->tape.buf ) &&
+          ( oric->tape.offs < oric->tape.len ) &&
+          ( oric->tape.buf[oric->tape.offs] == 0x16 ) )
       {
-        tape_setup_header(oric);
+        tape_setup_header( &oric->tape );
       }
     }
   }
@@ -263,115 +279,406 @@ void tape_setmotor( struct machine *oric, SDL_bool motoron )
 // Free up the current tape image
 void tape_eject( struct machine *oric )
 {
-  if( oric->tapebuf ) free( oric->tapebuf );
-  oric->tapebuf = NULL;
-  oric->tapelen = 0;
+  tape_sync( oric );
+  if( oric->tape.stream ) wavstream_close( &oric->tape.stream );
+  if( oric->tape.buf ) free( oric->tape.buf );
+  oric->tape.buf = NULL;
+  oric->tape.len = 0;
+  tape_buildindex( oric );
   oric->tapename[0] = 0;
   tape_popup( oric );
   refreshtape = SDL_TRUE;
 }
 
-void tape_next_raw_count( struct machine *oric )
+// Read the next pulse length from a raw (ORT) image
+void tape_next_raw_count( struct tapeplayer *tp )
 {
   unsigned int n;
   int nonrawend;
 
-  if( oric->tapeoffs >= oric->tapelen )
+  // Streamed WAV? That's all raw, and decoded a bit at a time
+  if( tp->stream )
   {
-    if( oric->nonrawend != oric->tapelen )
-      oric->tapehitend = 3;
+    n = wavstream_next( tp->stream );
+    if( !n )
+    {
+      tp->offs = tp->len;
+      tp->hitend = 3;
+      return;
+    }
+
+    tp->count = n<<1;
+    tp->offs = wavstream_tell( tp->stream );
+    return;
+  }
+
+  if( tp->offs >= tp->len )
+  {
+    if( tp->nonrawend != tp->len )
+      tp->hitend = 3;
     return;
   }
 
-  n = oric->tapebuf[oric->tapeoffs++];
+  n = tp->buf[tp->offs++];
   if (n < 0xfc)
   {
-    oric->tapecount = n<<1;
+    tp->count = n<<1;
     return;
   }
 
   switch (n)
   {
     case 0xff: // non-raw section
-      if( oric->tapeoffs >= (oric->tapelen-1) )
-      {
-        oric->tapeoffs = oric->tapelen;
-        oric->tapehitend = 3;
-        return;
-      }
+      if( tp->offs >= (tp->len-1) )
+        break;
 
-      nonrawend = ((oric->tapebuf[oric->tapeoffs]<<8)|oric->tapebuf[oric->tapeoffs+1]) + oric->tapeoffs+2;
-      if( nonrawend > oric->tapelen )
-      {
-        oric->tapeoffs = oric->tapelen;
-        oric->tapehitend = 3;
-        return;
-      }
+      nonrawend = ((tp->buf[tp->offs]<<8)|tp->buf[tp->offs+1]) + tp->offs+2;
+      if( nonrawend > tp->len )
+        break;
 
-      oric->nonrawend    = nonrawend;
-      oric->tapeoffs    += 2;
-      oric->tapebit      = 0;
-      oric->tapecount    = 2;
-      oric->tapeout      = 0;
-      tape_setup_header( oric );
+      tp->nonrawend = nonrawend;
+      tp->offs     += 2;
+      tp->bit       = 0;
+      tp->count     = 2;
+      tp->out       = 0;
+      tp->reps      = 0;
+      tape_setup_header( tp );
       return;
 
     case 0xfc:
-      if( oric->tapeoffs >= oric->tapelen )
+      if( tp->offs >= tp->len )
       {
-        oric->tapehitend = 3;
+        tp->hitend = 3;
         return;
       }
 
-      oric->tapecount = oric->tapebuf[oric->tapeoffs++] << 1;
+      tp->count = tp->buf[tp->offs++] << 1;
       return;
     
     case 0xfd:
-      if( oric->tapeoffs >= (oric->tapelen-1) )
-      {
-        oric->tapeoffs = oric->tapelen;
-        oric->tapehitend = 3;
-        return;
-      }
+      if( tp->offs >= (tp->len-1) )
+        break;
       
-      oric->tapecount = (oric->tapebuf[oric->tapeoffs]<<9)|(oric->tapebuf[oric->tapeoffs+1]<<1);
-      oric->tapeoffs += 2;
+      tp->count = (tp->buf[tp->offs]<<9)|(tp->buf[tp->offs+1]<<1);
+      tp->offs += 2;
       return;
   }
 
-  // Invalid data
-  oric->tapeoffs = oric->tapelen;
-  oric->tapehitend = 3;
+  // Invalid or truncated data
+  tp->offs = tp->len;
+  tp->hitend = 3;
+}
+
+// Work out the next pulse, now that the signal has changed to "tp->out".
+// "cycles" of any gap after a header have gone by since the last change.
+// Returns SDL_TRUE if it moved on to the next byte of the image.
+static SDL_bool tape_nextpulse( struct tapeplayer *tp, int cycles )
+{
+  if( tp->delay > 0 )
+  {
+    tp->delay -= cycles;
+    if( tp->delay <= 0)
+    {
+      if( tp->bit == 1 )
+        tp->delay = 1;
+      else
+        tp->delay = 0;
+    }
+    tp->count = TAPE_1_PULSE;
+    return SDL_FALSE;
+  }
+
+  if( tp->offs >= tp->len )
+  {
+    switch( tp->hitend )
+    {
+      case 0: tp->count = TAPE_1_PULSE; break;
+      case 1: tp->count = 0x36*2; break;
+    }
+    tp->hitend++;
+    return SDL_FALSE;
+  }
+
+  // Raw tape
+  if( tp->raw )
+  {
+    // In a non-raw section?
+    if( tp->offs >= tp->nonrawend )
+    {
+      tape_next_raw_count( tp );
+      return SDL_FALSE;
+    }
+  }
+
+  // .TAP real tape simulation
+  // Tape signal rising edge
+  if( tp->out )
+  {
+    // In slow mode, each bit is 8 cycles of a 1 or 4 cycles of a 0
+    if( tp->reps > 0 )
+    {
+      tp->reps--;
+      tp->count = tp->time;
+      return SDL_FALSE;
+    }
+
+    switch( tp->bit )
+    {
+      case 0:      // Start of a new byte. Send a 1 pulse
+        tp->time = TAPE_1_PULSE;
+        break;
+
+      case 1:     // Then a sync pulse (0)
+        tp->time = TAPE_0_PULSE;
+        tp->parity = 1;
+        break;
+      
+      default:    // For bit numbers 2 to 9, send actual byte bits 0 to 7
+        if( tp->buf[tp->offs]&(1<<(tp->bit-2)) )
+        {
+          tp->time = TAPE_1_PULSE;
+          tp->parity ^= 1;
+        } else {
+          tp->time = TAPE_0_PULSE;
+        }
+        break;
+
+      case 10:  // Then a parity bit
+        if( tp->parity )
+          tp->time = TAPE_1_PULSE;
+        else
+          tp->time = TAPE_0_PULSE;
+        break;
+
+      case 11:
+      case 12:
+      case 13:
+        tp->time = TAPE_1_PULSE;
+        break;
+    }
+    if( tp->slow )
+      tp->reps = ( tp->time == TAPE_1_PULSE ) ? 7 : 3;
+
+    // Move on to the next bit
+    tp->bit = (tp->bit+1)%14;
+    if( !tp->bit )
+    {
+      if( tp->dupbytes > 0 )
+        tp->dupbytes--;
+      else
+      {
+        tp->offs++;
+        if( tp->stats ) tp->stats->bytes++;
+        tp->count = tp->time;
+        return SDL_TRUE;
+      }
+    }
+  }
+  tp->count = tp->time;
+  return SDL_FALSE;
 }
 
 // Rewind to the start of the tape
 void tape_rewind( struct machine *oric )
 {
-  oric->nonrawend = 0;
-  if( oric->rawtape )
+  tape_sync( oric );
+  oric->tape.nonrawend = 0;
+  if( oric->tape.raw )
   {
-    oric->tapeout = oric->tapebuf[4];
-    via_write_CB1( &oric->via, oric->tapeout );
+    if( oric->tape.stream )
+    {
+      wavstream_rewind( oric->tape.stream );
+      oric->tape.buf[4] = wavstream_startbit( oric->tape.stream );
+    }
+
+    oric->tape.out = oric->tape.buf[4];
+    via_write_CB1( &oric->via, oric->tape.out );
 
-    oric->tapeoffs = 5;
-    tape_next_raw_count( oric );
+    oric->tape.offs = 5;
+    tape_next_raw_count( &oric->tape );
   }
   else
   {
-    oric->tapeoffs   = 0;
-    oric->tapebit    = 0;
-    oric->tapecount  = 2;
-    oric->tapeout    = 0;
-    oric->tapedupbytes = 0;
+    oric->tape.offs   = 0;
+    oric->tape.bit    = 0;
+    oric->tape.count  = 2;
+    oric->tape.out    = 0;
+    oric->tape.dupbytes = 0;
+
+    if( oric->tape.buf )
+      tape_setup_header( &oric->tape );
+  }
+  oric->tape.hitend = 0;
+  oric->tape.delay = 0;
+  refreshtape = SDL_TRUE;
+}
+
+// Add the files in a run of TAP bytes to the tape index
+static SDL_bool tape_indexbytes( struct machine *oric, int i, int to, int secend, int *space )
+{
+  unsigned char *buf = oric->tape.buf;
+  struct tapeentry *te;
+  int lead, n;
+
+  while( i < to )
+  {
+    // At least three sync bytes, then $24
+    if( buf[i] != 0x16 )
+    {
+      i++;
+      continue;
+    }
 
-    if( oric->tapebuf )
-      tape_setup_header( oric );
+    lead = i;
+    while( ( i < to ) && ( buf[i] == 0x16 ) ) i++;
+    if( ( (i-lead) < 3 ) || ( i >= to ) || ( buf[i] != 0x24 ) )
+      continue;
+    i++;
+    if( (i+9) > to ) break;
+
+    if( oric->tapeindexlen >= *space )
+    {
+      te = realloc( oric->tapeindex, sizeof( struct tapeentry ) * ((*space)+32) );
+      if( !te ) return SDL_FALSE;
+      oric->tapeindex = te;
+      (*space) += 32;
+    }
+
+    te = &oric->tapeindex[oric->tapeindexlen++];
+    te->offs    = lead;
+    te->secend  = secend;
+    te->type    = buf[i+2];
+    te->autorun = buf[i+3];
+    te->end     = (buf[i+4]<<8)|buf[i+5];
+    te->start   = (buf[i+6]<<8)|buf[i+7];
+    i += 9;
+
+    for( n=0; ( i < to ) && ( buf[i] ); i++ )
+    {
+      if( n < 16 ) te->name[n++] = buf[i];
+    }
+    te->name[n] = 0;
+    i++;
+    te->dataoffs = i;
+
+    // Skip the program
+    if( te->end >= te->start )
+      i += (te->end - te->start) + 1;
   }
-  oric->tapehitend = 0;
-  oric->tapedelay = 0;
+
+  return SDL_TRUE;
+}
+
+// Find every file on the tape, so CLOAD "NAME" and the tape
+// browser can go straight to it. Streamed WAVs aren't indexed.
+void tape_buildindex( struct machine *oric )
+{
+  int i, len, space = 0;
+  SDL_bool ok = SDL_TRUE;
+
+  if( oric->tapeindex ) free( oric->tapeindex );
+  oric->tapeindex = NULL;
+  oric->tapeindexlen = 0;
+
+  if( ( !oric->tape.buf ) || ( oric->tape.stream ) )
+    return;
+
+  if( !oric->tape.raw )
+  {
+    tape_indexbytes( oric, 0, oric->tape.len, 0, &space );
+    return;
+  }
+
+  // Only the non-raw sections of an ORT can be indexed
+  for( i=5; ( ok ) && ( i<oric->tape.len ); )
+  {
+    switch( oric->tape.buf[i] )
+    {
+      case 0xfc: i += 2; break;
+      case 0xfd: i += 3; break;
+
+      case 0xff:
+        if( (i+3) > oric->tape.len ) return;
+        len = (oric->tape.buf[i+1]<<8)|oric->tape.buf[i+2];
+        i += 3;
+        if( (i+len) > oric->tape.len ) return;
+        ok = tape_indexbytes( oric, i, i+len, i+len, &space );
+        i += len;
+        break;
+
+      case 0xfe:
+        return;
+
+      default:
+        i++;
+        break;
+    }
+  }
+}
+
+// Find a file by name, starting from the current position and
+// wrapping around to the start of the tape, like a real search would
+int tape_findentry( struct machine *oric, char *name )
+{
+  int i, from;
+
+  if( !oric->tapeindexlen ) return -1;
+
+  from = tape_currententry( oric );
+  if( ( from < 0 ) || ( oric->tapeindex[from].offs < oric->tape.offs ) ) from++;
+
+  for( i=0; i<oric->tapeindexlen; i++ )
+  {
+    if( strncmp( oric->tapeindex[(from+i)%oric->tapeindexlen].name, name, 16 ) == 0 )
+      return (from+i)%oric->tapeindexlen;
+  }
+
+  return -1;
+}
+
+// The file the tape is at or in, or -1 if it is before the first one
+int tape_currententry( struct machine *oric )
+{
+  int i;
+
+  for( i=0; i<oric->tapeindexlen; i++ )
+  {
+    if( oric->tapeindex[i].offs > oric->tape.offs )
+      break;
+  }
+
+  return i-1;
+}
+
+// Wind the tape to the leader of a file in the index
+void tape_seekentry( struct machine *oric, int n )
+{
+  struct tapeentry *te;
+
+  if( ( n < 0 ) || ( n >= oric->tapeindexlen ) ) return;
+  te = &oric->tapeindex[n];
+
+  tape_sync( oric );
+  oric->tape.offs     = te->offs;
+  oric->tape.nonrawend = te->secend;
+  oric->tape.bit      = 0;
+  oric->tape.count    = 2;
+  oric->tape.out      = 0;
+  oric->tape.dupbytes = 0;
+  tape_setup_header( &oric->tape );
+
+  oric->tape.hitend = 0;
+  oric->tape.delay = 0;
   refreshtape = SDL_TRUE;
 }
 
+char *tape_typename( struct tapeentry *te )
+{
+  if( te->type & 0x80 ) return "M/C";
+  if( te->type & 0x40 ) return "ARR";
+  return "BAS";
+}
+
 // This is used by the "tapsections" function. It returns the next time
 // value from an ort buffer, or -1 for invalid (or if an existing tapsection
 // is found)
@@ -435,13 +742,14 @@ static int validbyte(int accum)
   return parity;
 }
 
-// This converts oric standard encoded waveforms to decoded TAP sections
-static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scratch, SDL_bool slow )
+// This converts oric standard encoded waveforms to decoded TAP sections.
+// If "stats" isn't NULL, it is updated for each section found.
+static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scratch, SDL_bool slow, struct tapestats *stats )
 {
   int ort_offs, tapebit, ort_val, cyccount;
   int accum, state, thisbit, leaderstart=0, leadercount=0;
   int last_offsets[20], i, bitcount, tapbytes=0;
-  int data_bytes=0, slow0s=0, slow1s=0;
+  int data_bytes=0, slow0s=0, slow1s=0, badbytes=0;
   SDL_bool anytapsec = SDL_FALSE;
 
   ort_offs = 4;
@@ -595,6 +903,7 @@ static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scr
                 scratch[2] = 0x16;
                 scratch[3] = 0x24;
                 tapbytes = 4;
+                badbytes = 0;
                 state = TAPSEC_STATE_HEADER;
               }
             }
@@ -607,6 +916,7 @@ static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scr
             {
 //              printf("Byte @ %d is %03x (%02X)\n", ort_offs, accum&0x7fe, (accum>>2)&0xff);
 //              fflush(stdout);
+              if (!validbyte(accum)) badbytes++;
               scratch[tapbytes++] = (accum>>2)&0xff;
               if (tapbytes == 13)
               {
@@ -641,6 +951,7 @@ static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scr
             {
 //              printf("Filename byte = %03x (%02x) %c\n", accum&0x7fe, (accum>>2)&0xff, (accum>>2)&0xff);
 //              fflush(stdout);
+              if (!validbyte(accum)) badbytes++;
               scratch[tapbytes++] = (accum>>2)&0xff;
               if (scratch[tapbytes-1] == 0)
               {
@@ -667,6 +978,7 @@ static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scr
             if ((bitcount==13)&&validbyte(accum)) bitcount = 0;
             if (!bitcount)
             {
+              if (!validbyte(accum)) badbytes++;
               scratch[tapbytes++] = (accum>>2)&0xff;
               data_bytes--;
 //              printf("%d to go..\n", data_bytes);
@@ -698,6 +1010,13 @@ static int tapsections( unsigned char *ortbuf, int ortbuflen, unsigned char *scr
               accum = 0;
               anytapsec = SDL_TRUE;
 
+              if (stats)
+              {
+                stats->sections++;
+                stats->bytes += tapbytes;
+                stats->parityerrors += badbytes;
+              }
+
 //              printf("Back to scanning...\n");
 //              fflush(stdout);
             }
@@ -726,10 +1045,14 @@ static inline signed short getsmp(unsigned char *buf, SDL_bool is8bit)
 // any DC offset in the recording. It also calls "tapsections" to convert
 // any standard oric tape format waveforms it finds into non-raw "tap"
 // style sections to enable turbo loading of those parts.
-SDL_bool wav_convert( struct machine *oric )
+//
+// On success, the WAV in "buf" is freed and replaced by the ORT data.
+// "stats" can be NULL.
+SDL_bool wav_to_ort( unsigned char **buf, int *len, struct tapestats *stats )
 {
   // Chunk pointers
-  unsigned char *p=oric->tapebuf, *data=NULL, *ortbuf=NULL;
+  unsigned char *p=*buf, *data=NULL, *ortbuf=NULL;
+  int tapelen=*len;
   unsigned int i, j, k, l, chunklen, bps=0, freq=0, smpdelta=0, datalen=0, ortlen;
   signed int smaxl, sminl, smaxr, sminr, dcoffs=0, dcoffsav;
   signed int *lastsmps = NULL;
@@ -743,13 +1066,13 @@ SDL_bool wav_convert( struct machine *oric )
   while ((!fmtseen) || (!data))
   {
     // Run out of data?
-    if (i >= (oric->tapelen-8)) return SDL_FALSE;
+    if (i >= (tapelen-8)) return SDL_FALSE;
 
     // Length of this chunk
     chunklen = (p[i+7]<<24)|(p[i+6]<<16)|(p[i+5]<<8)|p[i+4];
 
     // Sane length?
-    if ((i+chunklen+8) > oric->tapelen)
+    if ((i+chunklen+8) > tapelen)
       return SDL_FALSE;
  
     // Format chunk?
@@ -856,14 +1179,14 @@ SDL_bool wav_convert( struct machine *oric )
       dcoffs = ((smaxl-sminl)/2)+sminl;
     }
 
-    if (j >= oric->tapelen)
+    if (j >= tapelen)
     {
 //      printf("Oh dear\n");
 //      fflush(stdout);
       break;
     }
 
-    oric->tapebuf[j++] = (smp>dcoffs) ? 1 : 0;
+    p[j++] = (smp>dcoffs) ? 1 : 0;
   }
 
 //  printf("ortsize = %d\n", j);
@@ -874,14 +1197,14 @@ SDL_bool wav_convert( struct machine *oric )
 
   // Calculate the length of the .ORT data
   ortlen = 5; // header + initial state
-  i = oric->tapebuf[0];
+  i = p[0];
   count = 0.0f;
   pcount = 0.0f;
   for (k=1; k<j; k++)
   {
-    if (oric->tapebuf[k] != i)
+    if (p[k] != i)
     {
-      i = oric->tapebuf[k];
+      i = p[k];
       if (((int)count) < 1)
       {
         // Just a spike?
@@ -910,6 +1233,10 @@ SDL_bool wav_convert( struct machine *oric )
     count+=cps;
   }
 
+  // The DC offset history isn't needed any more, and the batch
+  // converter goes through a lot of WAVs
+  if (lastsmps) free(lastsmps);
+
   // Allocate a buffer for the converted data
   ortbuf = malloc(ortlen);
   if (!ortbuf) return SDL_FALSE;
@@ -918,16 +1245,16 @@ SDL_bool wav_convert( struct machine *oric )
   memcpy(ortbuf, "ORT\0", 4);
 
   // Write the ORT data
-  i = oric->tapebuf[0];
+  i = p[0];
   ortbuf[4] = i;
   count = 0.0f;
   pcount = 0.0f;
   l = 5;
   for (k=1; k<j; k++)
   {
-    if (oric->tapebuf[k] != i)
+    if (p[k] != i)
     {
-      i = oric->tapebuf[k];
+      i = p[k];
       if (((int)count) < 1)
       {
         // Just a spike. Cancel the last swap.
@@ -964,62 +1291,267 @@ SDL_bool wav_convert( struct machine *oric )
 
   // Look for any standard oric encoded parts to convert
   // to non-raw "tap" sections
-  ortlen = tapsections(ortbuf, ortlen, oric->tapebuf, SDL_FALSE);
-  ortlen = tapsections(ortbuf, ortlen, oric->tapebuf, SDL_TRUE);
+  ortlen = tapsections(ortbuf, ortlen, p, SDL_FALSE, stats);
+  ortlen = tapsections(ortbuf, ortlen, p, SDL_TRUE, stats);
 
   // Substitute the ORT data for the original WAV data
-  free(oric->tapebuf);
-  oric->tapebuf = ortbuf;
-  oric->tapelen = ortlen;
+  free(p);
+  *buf = ortbuf;
+  *len = ortlen;
 
   return SDL_TRUE;
 }
 
+SDL_bool wav_convert( struct machine *oric )
+{
+  return wav_to_ort( &oric->tape.buf, &oric->tape.len, NULL );
+}
+
+// Tape to WAV encoding. This plays the image through the same pulse
+// model tape_ticktock uses (without the CPU, so each step is exactly
+// one half-period) and samples the tape signal at "rate".
+struct tapewav
+{
+  FILE             *f;
+  SDL_bool          failed;
+  Uint8             out[65536];
+  int               used;
+  Uint64            cycles;     // Time so far (CPU cycles)
+  Uint64            smps;       // Samples so far
+  Uint32            rate;
+  struct tapeplayer tp;
+};
+
+// Output "level" for "cycles"
+static void tapewav_level( struct tapewav *tw, int level, int cycles )
+{
+  Uint8 smp = level ? 0xf0 : 0x10;
+
+  tw->cycles += cycles;
+  while( tw->smps*1000000 < tw->cycles*tw->rate )
+  {
+    tw->out[tw->used++] = smp;
+    tw->smps++;
+    if( tw->used == sizeof( tw->out ) )
+    {
+      if( ( !tw->failed ) && ( fwrite( tw->out, tw->used, 1, tw->f ) != 1 ) )
+        tw->failed = SDL_TRUE;
+      tw->used = 0;
+    }
+  }
+}
+
+// Encode a TAP or ORT image as an 8bit mono WAV. "slow" encodes the
+// standard sections in the ROM's slow format. Returns SDL_FALSE if
+// the file couldn't be written.
+SDL_bool tape_to_wav( unsigned char *buf, int len, FILE *f, Uint32 rate, SDL_bool slow, struct tapestats *stats, Uint32 *ms )
+{
+  struct tapewav *tw;
+  struct tapeplayer *tp;
+  unsigned char hdr[44];
+  Uint32 datalen;
+  SDL_bool ok;
+
+  tw = malloc( sizeof( struct tapewav ) );
+  if( !tw ) return SDL_FALSE;
+  memset( tw, 0, sizeof( struct tapewav ) );
+
+  tw->f     = f;
+  tw->rate  = rate;
+
+  tp = &tw->tp;
+  tp->buf   = buf;
+  tp->len   = len;
+  tp->slow  = slow;
+  tp->stats = stats;
+
+  // Header, with the lengths filled in at the end
+  memset( hdr, 0, sizeof( hdr ) );
+  if( fwrite( hdr, sizeof( hdr ), 1, f ) != 1 )
+  {
+    free( tw );
+    return SDL_FALSE;
+  }
+
+  // A moment of silence for the tape deck to get going
+  tapewav_level( tw, 0, 250000 );
+
+  // See tape_rewind
+  if( ( len > 4 ) && ( memcmp( buf, "ORT\0", 4 ) == 0 ) )
+  {
+    tp->raw  = SDL_TRUE;
+    tp->out  = buf[4]&1;
+    tp->offs = 5;
+    tape_next_raw_count( tp );
+  }
+  else
+  {
+    tp->count = 2;
+    if( len > 0 ) tape_setup_header( tp );
+  }
+
+  // See tape_advance
+  while( tp->hitend <= 2 )
+  {
+    if( ( tp->hdrend != 0 ) && ( tp->offs == tp->hdrend ) )
+    {
+      tp->delay = 1281;
+      tp->hdrend = 0;
+    }
+
+    tapewav_level( tw, tp->out, tp->count );
+    tp->out ^= 1;
+
+    // The ROM stops the motor between files, and tape_setmotor
+    // lengthens the leader when it starts again
+    if( ( tape_nextpulse( tp, tp->count ) ) &&
+        ( tp->offs < tp->len ) &&
+        ( tp->buf[tp->offs] == 0x16 ) &&
+        ( tp->buf[tp->offs-1] != 0x16 ) )
+      tape_setup_header( tp );
+  }
+
+  // Finish the last pulse and leave a gap
+  tapewav_level( tw, tp->out, tp->count );
+  tapewav_level( tw, 0, 250000 );
+
+  if( ( tw->used ) && ( !tw->failed ) && ( fwrite( tw->out, tw->used, 1, f ) != 1 ) )
+    tw->failed = SDL_TRUE;
+
+  datalen = (Uint32)tw->smps;
+  if( ms ) *ms = (Uint32)(tw->cycles/1000);
+  ok = !tw->failed;
+  free( tw );
+
+  // Now the lengths are known
+  memcpy( &hdr[0], "RIFF", 4 );
+  hdr[4]  = (datalen+36)&0xff;
+  hdr[5]  = ((datalen+36)>>8)&0xff;
+  hdr[6]  = ((datalen+36)>>16)&0xff;
+  hdr[7]  = ((datalen+36)>>24)&0xff;
+  memcpy( &hdr[8], "WAVEfmt ", 8 );
+  hdr[16] = 16;                         // Format chunk length
+  hdr[20] = 1;                          // PCM
+  hdr[22] = 1;                          // Mono
+  hdr[24] = rate&0xff;
+  hdr[25] = (rate>>8)&0xff;
+  hdr[26] = (rate>>16)&0xff;
+  hdr[27] = (rate>>24)&0xff;
+  hdr[28] = rate&0xff;                  // Bytes per second
+  hdr[29] = (rate>>8)&0xff;
+  hdr[30] = (rate>>16)&0xff;
+  hdr[31] = (rate>>24)&0xff;
+  hdr[32] = 1;                          // Bytes per frame
+  hdr[34] = 8;                          // Bits per sample
+  memcpy( &hdr[36], "data", 4 );
+  hdr[40] = datalen&0xff;
+  hdr[41] = (datalen>>8)&0xff;
+  hdr[42] = (datalen>>16)&0xff;
+  hdr[43] = (datalen>>24)&0xff;
+
+  if( ( fseek( f, 0, SEEK_SET ) != 0 ) || ( fwrite( hdr, sizeof( hdr ), 1, f ) != 1 ) )
+    ok = SDL_FALSE;
+
+  return ok;
+}
+
+// Make a displayable version of the image filename
+static void tape_setname( struct machine *oric, char *fname )
+{
+  if( strlen( fname ) > 31 )
+  {
+    strncpy( oric->tapename, &fname[strlen(fname)-31], 32 );
+    oric->tapename[0] = 22;
+  } else {
+    strncpy( oric->tapename, fname, 32 );
+  }
+  oric->tapename[31] = 0;
+
+  // Show it in the popup
+  tape_popup( oric );
+}
+
+// Insert a WAV that is decoded as it plays
+static SDL_bool tape_load_wavstream( struct machine *oric, char *fname )
+{
+  oric->tape.stream = wavstream_open( fname );
+  oric->tape.buf = malloc( 5 );
+  if( ( !oric->tape.stream ) || ( !oric->tape.buf ) )
+  {
+    if( !oric->tape.stream ) msgbox( oric, MSGBOX_OK, "Invalid wav file" );
+    tape_eject( oric );
+    return SDL_FALSE;
+  }
+
+  // The position is counted in sample frames
+  memcpy( oric->tape.buf, "ORT\0", 4 );
+  oric->tape.len = oric->tape.stream->numframes;
+  oric->tape.raw = SDL_TRUE;
+
+  tape_rewind( oric );
+  tape_setname( oric, fname );
+  return SDL_TRUE;
+}
+
 // Insert a new tape image
 SDL_bool tape_load_tap( struct machine *oric, char *fname )
 {
-  FILE *f;
+  struct arcfile *f;
 
-  // First make sure the image file exists
-  f = fopen( fname, "rb" );
+  // First make sure the image file exists (it can be
+  // gzipped, or the first tape image in a zip)
+  f = arc_open( fname, arc_tapeexts );
   if( !f ) return SDL_FALSE;
 
   // Eject any old image
   tape_eject( oric );
 
   // Get the image size
-  fseek( f, 0, SEEK_END );
-  oric->tapelen = (int)ftell( f );
-  fseek( f, 0, SEEK_SET );
+  oric->tape.len = (int)f->size;
 
-  if( oric->tapelen <= 4 )   // Even worth loading it?
+  if( oric->tape.len <= 4 )   // Even worth loading it?
   {
-    fclose( f );
+    arc_close( &f );
     return SDL_FALSE;
   }
 
+  // Big WAVs are played as they are decoded, rather than converted
+  // in one go. tapebuf just has an ORT header and the starting level.
+  if( oric->tape.len >= WAVSTREAM_MINSIZE )
+  {
+    char riff[12];
+    if( ( arc_read( f, riff, 12 ) == 12 ) &&
+        ( memcmp( riff,   "RIFF", 4 ) == 0 ) &&
+        ( memcmp( riff+8, "WAVE", 4 ) == 0 ) )
+    {
+      arc_close( &f );
+      return tape_load_wavstream( oric, fname );
+    }
+    arc_seek( f, 0 );
+  }
+
   // Allocate memory for the tape image and read it in
-  oric->tapebuf = malloc( oric->tapelen+1 );
-  if( !oric->tapebuf )
+  oric->tape.buf = malloc( oric->tape.len+1 );
+  if( !oric->tape.buf )
   {
-    fclose( f );
-    oric->tapelen = 0;
+    arc_close( &f );
+    oric->tape.len = 0;
     return SDL_FALSE;
   }
 
-  if( fread( &oric->tapebuf[0], oric->tapelen, 1, f ) != 1 )
+  if( ( arc_read( f, &oric->tape.buf[0], oric->tape.len ) != (Uint32)oric->tape.len ) || ( !arc_ok( f ) ) )
   {
-    fclose( f );
+    arc_close( &f );
     tape_eject( oric );
     return SDL_FALSE;
   }
 
-  fclose( f );
+  arc_close( &f );
 
   // WAV
-  if ((oric->tapelen >= 36) &&
-      (memcmp(oric->tapebuf,   "RIFF", 4) == 0) &&
-      (memcmp(oric->tapebuf+8, "WAVE", 4) == 0))
+  if ((oric->tape.len >= 36) &&
+      (memcmp(oric->tape.buf,   "RIFF", 4) == 0) &&
+      (memcmp(oric->tape.buf+8, "WAVE", 4) == 0))
   {
     if (!wav_convert( oric ))
     {
@@ -1028,21 +1560,21 @@ SDL_bool tape_load_tap( struct machine *oric, char *fname )
       return SDL_FALSE;
     }
 
-    oric->rawtape = SDL_TRUE;
+    oric->tape.raw = SDL_TRUE;
   }
   // ORT
-  else if (memcmp(oric->tapebuf, "ORT\0", 4) == 0)
+  else if (memcmp(oric->tape.buf, "ORT\0", 4) == 0)
   {
-    oric->rawtape = SDL_TRUE;
+    oric->tape.raw = SDL_TRUE;
   }
   // TAP
-  else if (memcmp(oric->tapebuf, "\x16\x16\x16", 3) == 0)
+  else if (memcmp(oric->tape.buf, "\x16\x16\x16", 3) == 0)
   {
-    oric->rawtape = SDL_FALSE;
+    oric->tape.raw = SDL_FALSE;
 
     // I give up trying to do anything clever.
     // Just allow an extra byte for broken tape images.
-    oric->tapelen++;
+    oric->tape.len++;
   }
   // ???
   else
@@ -1054,20 +1586,9 @@ SDL_bool tape_load_tap( struct machine *oric, char *fname )
 
   // Rewind the tape
   tape_rewind( oric );
+  tape_buildindex( oric );
 
-  // Make a displayable version of the image filename
-  if( strlen( fname ) > 31 )
-  {
-    strncpy( oric->tapename, &fname[strlen(fname)-31], 32 );
-    oric->tapename[0] = 22;
-  } else {
-    strncpy( oric->tapename, fname, 32 );
-  }
-  oric->tapename[31] = 0;
-
-  // Show it in the popup
-  tape_popup( oric );
-
+  tape_setname( oric, fname );
   return SDL_TRUE;
 }
 
@@ -1086,20 +1607,20 @@ void tape_autoinsert( struct machine *oric )
   odir = getcwd( NULL, 0 );
   chdir( tapepath );
   tape_load_tap( oric, tapefile );
-  if( !oric->tapebuf )
+  if( !oric->tape.buf )
   {
     // Try appending .tap
     strcpy( &tapefile[i], ".tap" );
     tape_load_tap( oric, tapefile );
   }
-  if( !oric->tapebuf )
+  if( !oric->tape.buf )
   {
     // Try appending .ort
     strcpy( &tapefile[i], ".ort" );
     tape_load_tap( oric, tapefile );
   }
   
-  if( oric->tapebuf )
+  if( oric->tape.buf )
   {
     // We already inserted this one. Don't re-insert it when we get to the end. */
     oric->lasttapefile[0] = 0;
@@ -1109,26 +1630,81 @@ void tape_autoinsert( struct machine *oric )
   free( odir );
 }
 
-void tape_stop_savepatch( struct machine *oric )
+// Finish off the section being CSAVEd. Returns SDL_FALSE (having told
+// the user) if a separate TAP file couldn't be written.
+SDL_bool tape_stop_savepatch( struct machine *oric )
 {
-  if( !oric->tsavf ) return;
+  SDL_bool ok = SDL_TRUE;
+
+  if( !oric->tsavf ) return SDL_TRUE;
 
   if( oric->tsavf == oric->tapecap )
   {
-    unsigned char bufdata[2];
-    fseek( oric->tsavf, oric->tapecapsavoffs, SEEK_SET );
-    bufdata[0] = (oric->tapecapsavbytes>>8)&0xff;
-    bufdata[1] = oric->tapecapsavbytes&0xff;
-    fwrite( bufdata, 2, 1, oric->tsavf );
+    // The section length goes in when the capture is closed
+    tapecap_fixup16( oric->tsavf, oric->tapecapsavoffs, oric->tapecapsavbytes );
     oric->tapecapsavoffs = 0;
     oric->tapecapsavbytes = 0;
   }
-  else
+  else if( !tapecap_close( &oric->tsavf ) )
   {
-    fclose( oric->tsavf );
+    msgbox( oric, MSGBOX_OK, "Error writing tape file" );
+    ok = SDL_FALSE;
   }
 
   oric->tsavf = NULL;
+  return ok;
+}
+
+// The ROM is about to read the body of a program. If it is one we
+// indexed, put the whole thing into memory and skip to the end of the
+// ROM's read loop. Whatever the ROM does after the load (setting up
+// the BASIC pointers, autorun...) then happens as normal.
+static void tape_instantload( struct machine *oric )
+{
+  struct tapeentry *te = NULL;
+  int i, len, limit, addr;
+
+  for( i=0; i<oric->tapeindexlen; i++ )
+  {
+    if( oric->tapeindex[i].dataoffs == oric->tape.offs )
+    {
+      te = &oric->tapeindex[i];
+      break;
+    }
+  }
+
+  // Arrays go wherever RECALL wants them, not to the header address
+  if( ( !te ) || ( te->end < te->start ) || ( te->type & 0x40 ) )
+    return;
+
+  len = (te->end - te->start) + 1;
+  limit = te->secend ? te->secend : oric->tape.len;
+  if( (oric->tape.offs+len) > limit )
+    return;
+
+  // Make sure the patch file points at an RTS
+  if( oric->cpu.read( &oric->cpu, oric->pch_tt_getdata_end_pc ) != 0x60 )
+    return;
+
+  for( i=0; i<len; i++ )
+    oric->cpu.write( &oric->cpu, te->start+i, oric->tape.buf[oric->tape.offs+i] );
+  oric->tape.offs += len;
+
+  // Leave things as the read byte routine would after the last byte
+  if( oric->pch_tt_readbyte_storebyte_addr != -1 ) oric->cpu.write( &oric->cpu, oric->pch_tt_readbyte_storebyte_addr, oric->tape.buf[oric->tape.offs-1] );
+  if( oric->pch_tt_readbyte_storezero_addr != -1 ) oric->cpu.write( &oric->cpu, oric->pch_tt_readbyte_storezero_addr, 0x00 );
+
+  // And the load pointer as the read loop would leave it
+  if( oric->pch_tt_getdata_ptr_addr != -1 )
+  {
+    addr = te->end+1;
+    oric->cpu.write( &oric->cpu, oric->pch_tt_getdata_ptr_addr,   addr&0xff );
+    oric->cpu.write( &oric->cpu, oric->pch_tt_getdata_ptr_addr+1, (addr>>8)&0xff );
+  }
+
+  oric->cpu.calcpc = oric->pch_tt_getdata_end_pc;
+  oric->cpu.calcop = oric->cpu.read( &oric->cpu, oric->cpu.calcpc );
+  if( oric->tape.offs >= oric->tape.len ) refreshtape = SDL_TRUE;
 }
 
 // Do the tape patches (must be done after every m6502 setcycles)
@@ -1147,6 +1723,7 @@ void tape_patches( struct machine *oric )
           ( oric->cpu.calcpc == oric->pch_fd_recall_getname_pc ) )
       {
         // Read in the filename from RAM
+        tape_sync( oric );
         for( i=0; i<16; i++ )
         {
           j = oric->cpu.read( &oric->cpu, oric->pch_fd_getname_addr+i );
@@ -1160,8 +1737,8 @@ void tape_patches( struct machine *oric )
         {
           // Only do this if there is no tape inserted, or we're at the
           // end of the current tape, or the filename ends in .TAP, .ORT or .WAV
-          if( ( !oric->tapebuf ) ||
-              ( oric->tapeoffs >= oric->tapelen ) ||
+          if( ( !oric->tape.buf ) ||
+              ( oric->tape.offs >= oric->tape.len ) ||
               ( ( i > 3 ) && ( strcasecmp( &oric->lasttapefile[i-4], ".tap" ) == 0 ) ) ||
               ( ( i > 3 ) && ( strcasecmp( &oric->lasttapefile[i-4], ".ort" ) == 0 ) ) ||
               ( ( i > 3 ) && ( strcasecmp( &oric->lasttapefile[i-4], ".wav" ) == 0 ) ) )
@@ -1170,6 +1747,17 @@ void tape_patches( struct machine *oric )
             oric->cpu.write( &oric->cpu, oric->pch_fd_getname_addr, 0 );
           }
         }
+
+        // Still looking for a name on the inserted tape? With turbotape
+        // on, wind straight to it rather than reading past every file
+        // before it.
+        if( ( oric->tapeturbo ) &&
+            ( oric->lasttapefile[0] ) &&
+            ( oric->cpu.read( &oric->cpu, oric->pch_fd_getname_addr ) != 0 ) )
+        {
+          i = tape_findentry( oric, oric->lasttapefile );
+          if( i >= 0 ) tape_seekentry( oric, i );
+        }
       }
       else if( ( ( oric->cpu.calcpc == oric->pch_fd_csave_getname_pc ) ||
                  ( oric->cpu.calcpc == oric->pch_fd_store_getname_pc ) ) &&
@@ -1182,13 +1770,13 @@ void tape_patches( struct machine *oric )
         // If we're doing tape capture, we can just use that
         if( oric->tapecap )
         {
+          unsigned char section[] = { 0xff, 0x00, 0x00 };  // Length filled in later
+
           oric->tsavf = oric->tapecap;
           if( oric->tapecapcount < 0 )
-            fputc( 0, oric->tapecap );
-          fputc( 0xff, oric->tapecap );
-          oric->tapecapsavoffs = (int)ftell(oric->tapecap);
-          fputc( 0x00, oric->tapecap );
-          fputc( 0x00, oric->tapecap );
+            tapecap_putc( oric->tapecap, 0 );
+          oric->tapecapsavoffs = tapecap_tell( oric->tapecap ) + 1;
+          tapecap_write( oric->tapecap, section, 3 );
           oric->tapecapsavbytes = 0;
         }
         else
@@ -1226,7 +1814,7 @@ void tape_patches( struct machine *oric )
           if( odir )
           {
             chdir( tapepath );
-            oric->tsavf = fopen(tmptapename, "wb");
+            oric->tsavf = tapecap_open( tmptapename, SDL_FALSE );
             chdir( odir );
             free( odir );
           }
@@ -1236,8 +1824,7 @@ void tape_patches( struct machine *oric )
                ( oric->cpu.calcpc == oric->pch_tt_store_end_pc ) )
       {
         SDL_bool justtap = (oric->tsavf != oric->tapecap);
-        tape_stop_savepatch( oric );
-        if( justtap )
+        if( ( tape_stop_savepatch( oric ) ) && ( justtap ) )
         {
           snprintf( filetmp, 32, "\x0f\x10 Saved to %s", tmptapename );
           filetmp[31] = 0;
@@ -1257,7 +1844,7 @@ void tape_patches( struct machine *oric )
       {
         if( oric->tsavf )
         {
-          fputc( oric->cpu.a, oric->tsavf );
+          tapecap_putc( oric->tsavf, oric->cpu.a );
           if( oric->tsavf == oric->tapecap )
             oric->tapecapsavbytes++;
         }
@@ -1270,7 +1857,7 @@ void tape_patches( struct machine *oric )
         if( oric->tsavf )
         {
           unsigned char leader[] = { 0x16, 0x16, 0x16, 0x16 };
-          fwrite( leader, 4, 1, oric->tsavf );
+          tapecap_write( oric->tsavf, leader, 4 );
           if( oric->tsavf == oric->tapecap )
             oric->tapecapsavbytes += 4;
         }
@@ -1284,7 +1871,7 @@ void tape_patches( struct machine *oric )
 // Only do turbotape past this point!
 
   // No tape? Motor off?
-  if( ( !oric->tapebuf ) || ( !oric->tapemotor ) )
+  if( ( !oric->tape.buf ) || ( !oric->tapemotor ) )
   {
     if( ( oric->pch_tt_available ) && ( oric->tapeturbo ) && ( oric->romon ) && ( oric->cpu.calcpc == oric->pch_tt_getsync_pc ) )
       oric->tapeturbo_syncstack = oric->cpu.sp;
@@ -1292,13 +1879,16 @@ void tape_patches( struct machine *oric )
   }
 
   if( ( oric->tapeturbo_forceoff ) && ( oric->pch_tt_available ) && ( oric->romon ) && ( oric->cpu.calcpc == oric->pch_tt_getsync_end_pc ) )
+  {
+    tape_sync( oric );
     oric->tapeturbo_forceoff = SDL_FALSE;
+  }
 
   // Don't do turbotape if we have a raw tape
   // Turbotape can't work with rawtape. TODO: Auto enable warpspeed when CLOADing/CSAVEing rawtape
-  if(( oric->rawtape ) && ( oric->tapeoffs >= oric->nonrawend )) return;
+  if(( oric->tape.raw ) && ( oric->tape.offs >= oric->tape.nonrawend )) return;
 
-  if(( !oric->tapebuf ) || ( oric->tapeoffs >= oric->tapelen )) return;
+  if(( !oric->tape.buf ) || ( oric->tape.offs >= oric->tape.len )) return;
 
   // Maybe do turbotape
   if( ( oric->pch_tt_available ) && ( oric->tapeturbo ) && ( !oric->tapeturbo_forceoff ) && ( oric->romon ) )
@@ -1319,6 +1909,7 @@ void tape_patches( struct machine *oric )
       if( oric->tapeturbo_syncstack == -1 )
       {
         // No. Give up.
+        tape_sync( oric );
         oric->tapeturbo_forceoff = SDL_TRUE;
         return;
       }
@@ -1332,20 +1923,20 @@ void tape_patches( struct machine *oric )
     if( ( oric->cpu.calcpc == oric->pch_tt_getsync_pc ) || ( dosyncpatch ) )
     {
       // Currently at a sync byte?
-      if( oric->tapebuf[oric->tapeoffs] != 0x16 )
+      if( oric->tape.buf[oric->tape.offs] != 0x16 )
       {
         // Find the next sync byte
         do
         {
-          oric->tapeoffs++;
+          oric->tape.offs++;
 
           // Give up at end of image
-          if( oric->tapeoffs >= oric->tapelen )
+          if( oric->tape.offs >= oric->tape.len )
           {
             refreshtape = SDL_TRUE;
             return;
           }
-        } while( oric->tapebuf[oric->tapeoffs] != 0x16 );
+        } while( oric->tape.buf[oric->tape.offs] != 0x16 );
       }
 
       // "Jump" to the end of the cassette sync routine
@@ -1357,7 +1948,7 @@ void tape_patches( struct machine *oric )
     if( oric->cpu.calcpc == oric->pch_tt_readbyte_pc )
     {
       // Read the next byte directly into A
-      oric->cpu.a = oric->tapebuf[oric->tapeoffs++];
+      oric->cpu.a = oric->tape.buf[oric->tape.offs++];
 
       // Set flags
       oric->cpu.f_z = oric->cpu.a == 0;
@@ -1370,19 +1961,33 @@ void tape_patches( struct machine *oric )
       // Jump to the end of the read byte routine
       oric->cpu.calcpc = oric->pch_tt_readbyte_end_pc;
       oric->cpu.calcop = oric->cpu.read( &oric->cpu, oric->cpu.calcpc );
-      if( oric->tapeoffs >= oric->tapelen ) refreshtape = SDL_TRUE;
+      if( oric->tape.offs >= oric->tape.len ) refreshtape = SDL_TRUE;
+    }
+    else if( ( oric->tapeinstant ) &&
+             ( oric->pch_tt_instant_available ) &&
+             ( oric->cpu.calcpc == oric->pch_tt_getdata_pc ) )
+    {
+      tape_instantload( oric );
     }
   }
 }
 
-// Emulate the specified cpu-cycles time for the tape
-void tape_ticktock( struct machine *oric, int cycles )
+// Is turbotape standing in for the tape signal?
+static SDL_bool tape_turboactive( struct machine *oric )
+{
+  return ( oric->pch_tt_available ) && ( oric->tapeturbo ) && ( !oric->tapeturbo_forceoff ) && ( oric->romon ) && ( !oric->tape.raw );
+}
+
+// Emulate "pre"+"cycles" cpu-cycles time for the tape. Nothing is due
+// during the first "pre" of them (tape_schedule makes sure of that),
+// and "cycles" is the last instruction.
+static void tape_advance( struct machine *oric, int pre, int cycles )
 {
   Sint32 j;
 
   // Update the counter since last PB7 toggle
   if( ( oric->tapecap ) && ( oric->tapecapcount != -1 ) )
-    oric->tapecapcount += cycles;
+    oric->tapecapcount += pre+cycles;
 
   // The VSync hack is triggered in the video emulation
   // but actually handled here, since the VSync signal
@@ -1391,7 +1996,7 @@ void tape_ticktock( struct machine *oric, int cycles )
   // counter, which we count down here.
   if( oric->vsync > 0 )
   {
-    oric->vsync -= cycles;
+    oric->vsync -= pre+cycles;
     if( oric->vsync < 0 )
       oric->vsync = 0;
   }
@@ -1406,13 +2011,13 @@ void tape_ticktock( struct machine *oric, int cycles )
   }
 
   // No tape? Motor off?
-  if( ( !oric->tapebuf ) || ( !oric->tapemotor ) )
+  if( ( !oric->tape.buf ) || ( !oric->tapemotor ) )
     return;
 
   // Tape offset outside the tape image limits?
-  if( ( oric->tapeoffs < 0 ) || ( oric->tapeoffs >= oric->tapelen ) )
+  if( ( oric->tape.offs < 0 ) || ( oric->tape.offs >= oric->tape.len ) )
   {
-    if( oric->tapehitend > 2 )
+    if( oric->tape.hitend > 2 )
     {
       // Try to autoinsert a tape image
       if( ( oric->lasttapefile[0] ) && ( oric->autoinsert ) )
@@ -1424,144 +2029,121 @@ void tape_ticktock( struct machine *oric, int cycles )
   }
 
   // Abort if turbotape is on
-  if( ( oric->pch_tt_available ) && ( oric->tapeturbo ) && ( !oric->tapeturbo_forceoff ) && ( oric->romon ) && ( !oric->rawtape ) )
+  if( tape_turboactive( oric ) )
     return;
 
-  if( oric->tapehitend > 2 )
+  if( oric->tape.hitend > 2 )
     return;
 
-  if( ( oric->tapehdrend != 0 ) && ( oric->tapeoffs == oric->tapehdrend ) )
+  if( ( oric->tape.hdrend != 0 ) && ( oric->tape.offs == oric->tape.hdrend ) )
   {
-    oric->tapedelay = 1281;
-    oric->tapehdrend = 0;
+    oric->tape.delay = 1281;
+    oric->tape.hdrend = 0;
   }
 
   // No turbotape. Do "real" tape emulation.
+  // The counters just run down until the last instruction
+  if( pre > 0 )
+  {
+    oric->tape.count -= pre;
+    if( oric->tape.delay > 0 )
+    {
+      oric->tape.delay -= pre;
+      if( oric->tape.delay < 0 )
+        oric->tape.delay = 1;
+    }
+  }
+
   // Count down the cycle counter
-  if( oric->tapecount > cycles )
+  if( oric->tape.count > cycles )
   {
-    oric->tapecount -= cycles;
-    if( oric->tapedelay > 0 )
+    oric->tape.count -= cycles;
+    if( oric->tape.delay > 0 )
     {
-      oric->tapedelay -= cycles;
-      if( oric->tapedelay < 0 )
-        oric->tapedelay = 1;
+      oric->tape.delay -= cycles;
+      if( oric->tape.delay < 0 )
+        oric->tape.delay = 1;
     }
     return;
   }
 
   // Toggle the tape input
-  oric->tapeout ^= 1;
+  oric->tape.out ^= 1;
   if( !oric->vsynchack )
   {
     // Update the audio if tape noise is enabled
     if( oric->tapenoise )
     {
-      ay_lockaudio( &oric->ay ); // Gets unlocked at the end of each frame
-      if( oric->ay.do_logcycle_reset )
-      {
-        oric->ay.logcycle = oric->ay.newlogcycle;
-        oric->ay.do_logcycle_reset = SDL_FALSE;
-      }
-      if( oric->ay.tlogged < TAPELOG_SIZE )
-      {
-        oric->ay.tapelog[oric->ay.tlogged  ].cycle = oric->ay.logcycle;
-        oric->ay.tapelog[oric->ay.tlogged++].val   = oric->tapeout;
-      }
+      ay_logevent( &oric->ay, AY_TAPE_EVENT, oric->tape.out );
     }
 
     // Put tape signal onto CB1
-    via_write_CB1( &oric->via, oric->tapeout );
-  }
-
-  if( oric->tapedelay > 0 )
-  {
-    oric->tapedelay -= cycles;
-    if( oric->tapedelay <= 0)
-    {
-      if( oric->tapebit == 1 )
-        oric->tapedelay = 1;
-      else
-        oric->tapedelay = 0;
-    }
-    oric->tapecount = TAPE_1_PULSE;
-    return;
+    via_write_CB1( &oric->via, oric->tape.out );
   }
 
-  if( oric->tapeoffs >= oric->tapelen )
-  {
-    switch( oric->tapehitend )
-    {
-      case 0: oric->tapecount = TAPE_1_PULSE; break;
-      case 1: oric->tapecount = 0x36*2; break;
-    }
-    oric->tapehitend++;
+  // Then on to the next pulse
+  j = oric->tape.hitend;
+  tape_nextpulse( &oric->tape, cycles );
+  if( oric->tape.hitend != j )
     refreshtape = SDL_TRUE;
-    return;
-  }
+}
 
-  // Raw tape
-  if( oric->rawtape )
+// Work out how many cycles there are until tape_ticktock next has
+// something to do, for the VIA to count down
+static void tape_schedule( struct machine *oric )
+{
+  int next = TAPE_IDLE_TICKS;
+
+  // End of the VSync hack pulse
+  if( ( oric->vsynchack ) && ( oric->vsync > 0 ) )
+    next = oric->vsync;
+
+  if( ( oric->tape.buf ) && ( oric->tapemotor ) )
   {
-    // In a non-raw section?
-    if( oric->tapeoffs >= oric->nonrawend )
+    // Waiting to autoinsert the next tape
+    if( ( ( oric->tape.offs < 0 ) || ( oric->tape.offs >= oric->tape.len ) ) &&
+        ( oric->tape.hitend > 2 ) &&
+        ( oric->lasttapefile[0] ) &&
+        ( oric->autoinsert ) )
+      next = 0;
+
+    if( ( !tape_turboactive( oric ) ) && ( oric->tape.hitend <= 2 ) )
     {
-      tape_next_raw_count( oric );
-      if( oric->tapehitend > 2 )
-        refreshtape = SDL_TRUE;
-      return;
+      // Next edge of the tape signal
+      if( oric->tape.count < next )
+        next = oric->tape.count;
+
+      // End of the gap after a header
+      if( ( oric->tape.delay > 1 ) && ( oric->tape.delay < next ) )
+        next = oric->tape.delay;
     }
   }
 
-  // .TAP real tape simulation
-  // Tape signal rising edge
-  if( oric->tapeout )
-  {
-    switch( oric->tapebit )
-    {
-      case 0:      // Start of a new byte. Send a 1 pulse
-        oric->tapetime = TAPE_1_PULSE;
-        break;
+  oric->tapeticks   = next;
+  oric->tapeticklen = next;
+}
 
-      case 1:     // Then a sync pulse (0)
-        oric->tapetime = TAPE_0_PULSE;
-        oric->tapeparity = 1;
-        break;
-      
-      default:    // For bit numbers 2 to 9, send actual byte bits 0 to 7
-        if( oric->tapebuf[oric->tapeoffs]&(1<<(oric->tapebit-2)) )
-        {
-          oric->tapetime = TAPE_1_PULSE;
-          oric->tapeparity ^= 1;
-        } else {
-          oric->tapetime = TAPE_0_PULSE;
-        }
-        break;
+// Called by the VIA when "tapeticks" runs out. "cycles" is the
+// length of the instruction that got it there.
+void tape_ticktock( struct machine *oric, int cycles )
+{
+  int elapsed = oric->tapeticklen - oric->tapeticks;
 
-      case 10:  // Then a parity bit
-        if( oric->tapeparity )
-          oric->tapetime = TAPE_1_PULSE;
-        else
-          oric->tapetime = TAPE_0_PULSE;
-        break;
+  oric->tapeticks   = 0;
+  oric->tapeticklen = 0;
+  tape_advance( oric, elapsed-cycles, cycles );
+  tape_schedule( oric );
+}
 
-      case 11:
-      case 12:
-      case 13:
-        oric->tapetime = TAPE_1_PULSE;
-        break;
-    }
+// Catch the tape emulation up before changing anything it depends on.
+// It is then rescheduled after the next instruction.
+void tape_sync( struct machine *oric )
+{
+  int elapsed = oric->tapeticklen - oric->tapeticks;
 
-    // Move on to the next bit
-    oric->tapebit = (oric->tapebit+1)%14;
-    if( !oric->tapebit )
-    {
-      if( oric->tapedupbytes > 0 )
-        oric->tapedupbytes--;
-      else
-        oric->tapeoffs++;
-    }
-  }
-  oric->tapecount = oric->tapetime;
+  oric->tapeticks   = 0;
+  oric->tapeticklen = 0;
+  if( elapsed > 0 )
+    tape_advance( oric, elapsed, 0 );
 }
 
@@ -21,6 +21,8 @@
 #define TAPE_0_PULSE 416
 #define TAPE_1_PULSE 208
 
+#define TAPE_IDLE_TICKS 0x1000000   // Most cycles tape_ticktock goes without running
+
 #define TAPE_DECODE_0_MIN (TAPE_1_PULSE+(TAPE_1_PULSE/5))
 #define TAPE_DECODE_0_MAX (TAPE_0_PULSE*2)
 #define TAPE_DECODE_1_MIN (TAPE_1_PULSE/4)
@@ -28,12 +30,40 @@
 
 #define TIME_TO_BIT(t) ((t<TAPE_DECODE_1_MIN)?-1:((t<TAPE_DECODE_0_MIN)?1:0))
 
+// A file on the tape
+struct tapeentry
+{
+  int    offs;        // Start of the leader in tapebuf
+  int    dataoffs;    // First byte of the program
+  int    secend;      // End of the ORT section it is in (0 for TAP images)
+  Uint16 start, end;
+  Uint8  type;        // 0x00 BASIC, 0x80 machine code, 0x40 array
+  Uint8  autorun;
+  char   name[17];
+};
+
+// What wav_to_ort managed to decode
+struct tapestats
+{
+  int sections;       // Standard encoded files found
+  int bytes;          // TAP bytes recovered from them
+  int parityerrors;   // Bytes in them that failed the parity check
+};
+
 void tape_eject( struct machine *oric );
 void tape_rewind( struct machine *oric );
 SDL_bool tape_load_tap( struct machine *oric, char *fname );
+SDL_bool wav_to_ort( unsigned char **buf, int *len, struct tapestats *stats );
+SDL_bool tape_to_wav( unsigned char *buf, int len, FILE *f, Uint32 rate, SDL_bool slow, struct tapestats *stats, Uint32 *ms );
+void tape_buildindex( struct machine *oric );
+int tape_findentry( struct machine *oric, char *name );
+int tape_currententry( struct machine *oric );
+void tape_seekentry( struct machine *oric, int n );
+char *tape_typename( struct tapeentry *te );
 void tape_ticktock( struct machine *oric, int cycles );
+void tape_sync( struct machine *oric );
 void tape_setmotor( struct machine *oric, SDL_bool motoron );
 void tape_patches( struct machine *oric );
 void toggletapecap( struct machine *oric, struct osdmenuitem *mitem, int dummy );
 void tape_orbchange(struct via *via);
-void tape_stop_savepatch( struct machine *oric );
+SDL_bool tape_stop_savepatch( struct machine *oric );
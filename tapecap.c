@@ -0,0 +1,225 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Buffered tape output (ORT capture and CSAVEd TAP files)
+**
+**  Tape output arrives a byte or two at a time. It is queued in a ring
+**  buffer and a background thread writes it out in big blocks. Things
+**  that are only known later (the length of a CSAVEd section in an ORT)
+**  are queued as placeholders and patched in when the file is closed.
+**
+*/
+
+// Captures can outgrow 2GB, so ask for a 64bit off_t on 32bit hosts
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "6502.h"
+#include "via.h"
+#include "8912.h"
+#include "tapecap.h"
+
+// fseek only takes a long, which is 32bit on Windows and 32bit hosts
+static int tapecap_seek( FILE *f, Uint64 offs )
+{
+#if defined(WIN32)
+  return _fseeki64( f, (__int64)offs, SEEK_SET );
+#elif defined(HAVE_FSEEKO)
+  return fseeko( f, (off_t)offs, SEEK_SET );
+#else
+  if( offs > 0x7fffffff ) return -1;
+  return fseek( f, (long)offs, SEEK_SET );
+#endif
+}
+
+// The writer thread. Empties the ring until told to quit, then
+// empties it one last time.
+static int tapecap_writer( void *data )
+{
+  struct tapecap_handle *th = (struct tapecap_handle *)data;
+  Uint32 head, tail, n;
+  Uint32 quit;
+
+  for( ;; )
+  {
+    quit = AY_LOAD_ACQUIRE( &th->quit );
+    head = AY_LOAD_ACQUIRE( &th->head );
+    tail = th->tail;
+
+    if( head == tail )
+    {
+      if( quit ) break;
+      SDL_Delay( TAPECAP_POLLMS );
+      continue;
+    }
+
+    // Up to the end of the ring, a chunk at a time
+    n = head-tail;
+    if( n > TAPECAP_RINGLEN-(tail&TAPECAP_RINGMASK) ) n = TAPECAP_RINGLEN-(tail&TAPECAP_RINGMASK);
+    if( n > TAPECAP_CHUNK ) n = TAPECAP_CHUNK;
+
+    if( ( !th->failed ) && ( fwrite( &th->ring[tail&TAPECAP_RINGMASK], n, 1, th->f ) != 1 ) )
+      th->failed = SDL_TRUE;
+
+    AY_STORE_RELEASE( &th->tail, tail+n );
+  }
+
+  return 0;
+}
+
+// Open a file for tape output. "ort" writes the ORT header first.
+struct tapecap_handle *tapecap_open( char *filename, SDL_bool ort )
+{
+  struct tapecap_handle *th;
+
+  th = malloc( sizeof( struct tapecap_handle ) );
+  if( !th ) return NULL;
+
+  memset( th, 0, sizeof( struct tapecap_handle ) );
+
+  th->ring = malloc( TAPECAP_RINGLEN );
+  if( !th->ring )
+  {
+    free( th );
+    return NULL;
+  }
+
+  th->f = fopen( filename, "wb" );
+  if( !th->f )
+  {
+    free( th->ring );
+    free( th );
+    return NULL;
+  }
+
+  th->thread = SDL_COMPAT_CreateThread( tapecap_writer, "tapecap", th );
+  if( !th->thread )
+  {
+    fclose( th->f );
+    free( th->ring );
+    free( th );
+    return NULL;
+  }
+
+  if( ort )
+    tapecap_write( th, (Uint8 *)"ORT\0", 4 );   // Oric Raw Tape, Version 0
+
+  return th;
+}
+
+// Queue some bytes, waiting for room if the writer has fallen behind
+void tapecap_write( struct tapecap_handle *th, Uint8 *data, Uint32 len )
+{
+  Uint32 head, room, n;
+
+  if( !th ) return;
+
+  head = th->head;
+  th->queued += len;
+  while( len > 0 )
+  {
+    room = TAPECAP_RINGLEN - (head - AY_LOAD_ACQUIRE( &th->tail ));
+    if( !room )
+    {
+      SDL_Delay( 1 );
+      continue;
+    }
+
+    n = len;
+    if( n > room ) n = room;
+    if( n > TAPECAP_RINGLEN-(head&TAPECAP_RINGMASK) ) n = TAPECAP_RINGLEN-(head&TAPECAP_RINGMASK);
+
+    memcpy( &th->ring[head&TAPECAP_RINGMASK], data, n );
+    head += n;
+    data += n;
+    len  -= n;
+  }
+
+  AY_STORE_RELEASE( &th->head, head );
+}
+
+void tapecap_putc( struct tapecap_handle *th, Uint8 c )
+{
+  tapecap_write( th, &c, 1 );
+}
+
+// Where the next byte will go in the file
+Uint64 tapecap_tell( struct tapecap_handle *th )
+{
+  return th ? th->queued : 0;
+}
+
+// Put a 16bit big-endian value at "offs" when the file is closed
+SDL_bool tapecap_fixup16( struct tapecap_handle *th, Uint64 offs, Uint16 val )
+{
+  struct tapecap_fixup *tmp;
+
+  if( !th ) return SDL_FALSE;
+
+  if( th->numfixups >= th->fixupspace )
+  {
+    tmp = realloc( th->fixups, sizeof( struct tapecap_fixup ) * (th->fixupspace+16) );
+    if( !tmp )
+    {
+      th->failed = SDL_TRUE;
+      return SDL_FALSE;
+    }
+    th->fixups = tmp;
+    th->fixupspace += 16;
+  }
+
+  th->fixups[th->numfixups].offs    = offs;
+  th->fixups[th->numfixups].data[0] = (val>>8)&0xff;
+  th->fixups[th->numfixups].data[1] = val&0xff;
+  th->numfixups++;
+  return SDL_TRUE;
+}
+
+// Write out everything queued, apply the fix-ups and close the file.
+// Returns SDL_FALSE if anything failed along the way.
+SDL_bool tapecap_close( struct tapecap_handle **th )
+{
+  SDL_bool ok;
+  int i;
+
+  if( ( !th ) || ( !(*th) ) ) return SDL_TRUE;
+
+  // Let the writer finish off what's queued
+  AY_STORE_RELEASE( &(*th)->quit, 1 );
+  SDL_WaitThread( (*th)->thread, NULL );
+
+  ok = !(*th)->failed;
+  for( i=0; ( ok ) && ( i<(*th)->numfixups ); i++ )
+  {
+    if( ( tapecap_seek( (*th)->f, (*th)->fixups[i].offs ) != 0 ) ||
+        ( fwrite( (*th)->fixups[i].data, 2, 1, (*th)->f ) != 1 ) )
+      ok = SDL_FALSE;
+  }
+
+  if( fclose( (*th)->f ) != 0 ) ok = SDL_FALSE;
+  if( (*th)->fixups ) free( (*th)->fixups );
+  free( (*th)->ring );
+  free( (*th) );
+  (*th) = NULL;
+
+  return ok;
+}
@@ -0,0 +1,58 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Buffered tape output (ORT capture and CSAVEd TAP files)
+**
+*/
+
+#define TAPECAP_RINGLEN (1<<18)          // Bytes (a good minute of ORT data)
+#define TAPECAP_RINGMASK (TAPECAP_RINGLEN-1)
+#define TAPECAP_CHUNK   16384            // Largest single write to the file
+#define TAPECAP_POLLMS  20               // How often the writer looks for more
+
+// A 16bit big-endian value to put back over something already queued
+struct tapecap_fixup
+{
+  Uint64 offs;
+  Uint8  data[2];
+};
+
+struct tapecap_handle
+{
+  FILE       *f;
+  SDL_bool    failed;
+
+  // Patched in once everything has been written
+  struct tapecap_fixup *fixups;
+  int         numfixups, fixupspace;
+
+  // Single producer (the emulation), single consumer (the writer
+  // thread). The producer waits for room rather than dropping anything.
+  Uint8      *ring;
+  Uint32      head, tail;
+  Uint32      quit;
+  Uint64      queued;                   // Bytes queued since the file was opened
+  SDL_Thread *thread;
+};
+
+struct tapecap_handle *tapecap_open( char *filename, SDL_bool ort );
+void tapecap_write( struct tapecap_handle *th, Uint8 *data, Uint32 len );
+void tapecap_putc( struct tapecap_handle *th, Uint8 c );
+Uint64 tapecap_tell( struct tapecap_handle *th );
+SDL_bool tapecap_fixup16( struct tapecap_handle *th, Uint64 offs, Uint16 val );
+SDL_bool tapecap_close( struct tapecap_handle **th );
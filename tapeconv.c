@@ -0,0 +1,545 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Batch WAV to ORT/TAP conversion, and TAP/ORT to WAV export
+**
+**  Each WAV goes through the same wav_to_ort that the tape loader uses.
+**  The .ort is always written, and any standard encoded files it found
+**  are also glued together into a .tap. A handful of worker threads
+**  take the next WAV off a shared list until there are none left.
+**
+**  Exporting goes the other way. Each TAP or ORT is played through
+**  tape_to_wav, which runs as fast as it can rather than in real time,
+**  and written next to the image with ".wav" on the end.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "system.h"
+#include "6502.h"
+#include "via.h"
+#include "8912.h"
+#include "gui.h"
+#include "disk.h"
+#include "monitor.h"
+#include "6551.h"
+#include "machine.h"
+#include "tape.h"
+#include "tapeconv.h"
+
+static struct tapeconv_job *jobs;
+static int numjobs, nextjob;
+static SDL_mutex *jobmutex;
+
+static SDL_bool exporting;
+static Uint32 exportrate;
+static SDL_bool exportslow;
+
+static char *statusnames[] = { "-", "ok", "not a wav", "read error", "write error", "out of memory" };
+
+// Glue a path and a file name together
+static char *tapeconv_join( char *path, char *file )
+{
+  int i = (int)strlen( path );
+  char *ret = malloc( i+strlen( file )+2 );
+  if( !ret ) return NULL;
+
+  strcpy( ret, path );
+  if( ( i > 0 ) && ( ret[i-1] != PATHSEP ) && ( ret[i-1] != ':' ) )
+    ret[i++] = PATHSEP;
+  strcpy( &ret[i], file );
+  return ret;
+}
+
+// Copy a file name with a different extension
+static char *tapeconv_swapext( char *fname, char *ext )
+{
+  char *ret, *dot, *sep;
+
+  ret = malloc( strlen( fname )+strlen( ext )+1 );
+  if( !ret ) return NULL;
+
+  strcpy( ret, fname );
+  dot = strrchr( ret, '.' );
+  sep = strrchr( ret, PATHSEP );
+  if( ( dot ) && ( ( !sep ) || ( dot > sep ) ) )
+    *dot = 0;
+  strcat( ret, ext );
+  return ret;
+}
+
+static SDL_bool tapeconv_hasext( char *fname, char *ext )
+{
+  int i = (int)strlen( fname );
+  return ( ( i > 4 ) && ( strcasecmp( &fname[i-4], ext ) == 0 ) );
+}
+
+// Is this something to convert?
+static SDL_bool tapeconv_wanted( char *fname )
+{
+  if( exporting )
+    return ( tapeconv_hasext( fname, ".tap" ) || tapeconv_hasext( fname, ".ort" ) );
+  return tapeconv_hasext( fname, ".wav" );
+}
+
+static SDL_bool tapeconv_addjob( char *srcname, char *showname )
+{
+  struct tapeconv_job *tmp;
+
+  if( ( numjobs & 63 ) == 0 )
+  {
+    tmp = realloc( jobs, sizeof( struct tapeconv_job ) * ( numjobs+64 ) );
+    if( !tmp ) return SDL_FALSE;
+    jobs = tmp;
+  }
+
+  memset( &jobs[numjobs], 0, sizeof( struct tapeconv_job ) );
+  jobs[numjobs].srcname  = srcname;
+  jobs[numjobs].showname = showname;
+  numjobs++;
+  return SDL_TRUE;
+}
+
+static int tapeconv_cmpjob( const void *a, const void *b )
+{
+  return strcmp( ((struct tapeconv_job *)a)->showname, ((struct tapeconv_job *)b)->showname );
+}
+
+static int tapeconv_cmpsrc( const void *a, const void *b )
+{
+  return strcmp( ((struct tapeconv_job *)a)->srcname, ((struct tapeconv_job *)b)->srcname );
+}
+
+// Write out the standard encoded sections of an ORT as a TAP
+static SDL_bool tapeconv_writetap( struct tapeconv_job *job, unsigned char *ortbuf, int ortlen )
+{
+  char *tapname;
+  FILE *f = NULL;
+  int i, len;
+  SDL_bool ok = SDL_TRUE;
+
+  if( !job->stats.sections ) return SDL_TRUE;
+
+  tapname = tapeconv_swapext( job->srcname, ".tap" );
+  if( !tapname ) return SDL_FALSE;
+
+  for( i=5; ( ok ) && ( i<ortlen ); )
+  {
+    switch( ortbuf[i] )
+    {
+      case 0xfc: i += 2; break;
+      case 0xfd: i += 3; break;
+
+      case 0xff:
+        if( i+3 > ortlen ) { i = ortlen; break; }
+        len = (ortbuf[i+1]<<8)|ortbuf[i+2];
+        i += 3;
+        if( i+len > ortlen ) len = ortlen-i;
+
+        if( !f )
+        {
+          f = fopen( tapname, "wb" );
+          if( !f ) { ok = SDL_FALSE; break; }
+        }
+        if( ( len ) && ( fwrite( &ortbuf[i], len, 1, f ) != 1 ) )
+          ok = SDL_FALSE;
+        i += len;
+        break;
+
+      default: i++; break;
+    }
+  }
+
+  if( f )
+  {
+    if( fclose( f ) != 0 ) ok = SDL_FALSE;
+    job->wrotetap = ok;
+  }
+  free( tapname );
+  return ok;
+}
+
+static void tapeconv_convert( struct tapeconv_job *job )
+{
+  FILE *f;
+  unsigned char *buf;
+  char *ortname;
+  int len;
+
+  f = fopen( job->srcname, "rb" );
+  if( !f ) { job->status = TAPECONV_READERR; return; }
+
+  fseek( f, 0, SEEK_END );
+  len = (int)ftell( f );
+  fseek( f, 0, SEEK_SET );
+
+  if( len < 36 ) { fclose( f ); job->status = TAPECONV_NOTWAV; return; }
+
+  buf = malloc( len );
+  if( !buf ) { fclose( f ); job->status = TAPECONV_NOMEM; return; }
+
+  if( fread( buf, len, 1, f ) != 1 )
+  {
+    fclose( f );
+    free( buf );
+    job->status = TAPECONV_READERR;
+    return;
+  }
+  fclose( f );
+
+  if( ( memcmp( buf, "RIFF", 4 ) != 0 ) ||
+      ( memcmp( buf+8, "WAVE", 4 ) != 0 ) ||
+      ( !wav_to_ort( &buf, &len, &job->stats ) ) )
+  {
+    free( buf );
+    job->status = TAPECONV_NOTWAV;
+    return;
+  }
+  job->ortlen = len;
+
+  job->status = TAPECONV_WRITEERR;
+  ortname = tapeconv_swapext( job->srcname, ".ort" );
+  if( ortname )
+  {
+    f = fopen( ortname, "wb" );
+    if( f )
+    {
+      if( ( fwrite( buf, len, 1, f ) == 1 ) &&
+          ( fclose( f ) == 0 ) &&
+          ( tapeconv_writetap( job, buf, len ) ) )
+        job->status = TAPECONV_OK;
+    }
+    free( ortname );
+  }
+
+  free( buf );
+}
+
+static void tapeconv_export( struct tapeconv_job *job )
+{
+  FILE *f;
+  unsigned char *buf;
+  char *wavname;
+  int len;
+
+  f = fopen( job->srcname, "rb" );
+  if( !f ) { job->status = TAPECONV_READERR; return; }
+
+  fseek( f, 0, SEEK_END );
+  len = (int)ftell( f );
+  fseek( f, 0, SEEK_SET );
+
+  buf = malloc( len+1 );
+  if( !buf ) { fclose( f ); job->status = TAPECONV_NOMEM; return; }
+
+  if( ( len > 0 ) && ( fread( buf, len, 1, f ) != 1 ) )
+  {
+    fclose( f );
+    free( buf );
+    job->status = TAPECONV_READERR;
+    return;
+  }
+  fclose( f );
+
+  // Keep the image's extension, so "foo.tap" and "foo.ort" don't clash
+  job->status = TAPECONV_NOMEM;
+  wavname = malloc( strlen( job->srcname )+5 );
+  if( wavname )
+  {
+    strcpy( wavname, job->srcname );
+    strcat( wavname, ".wav" );
+
+    job->status = TAPECONV_WRITEERR;
+    f = fopen( wavname, "wb" );
+    if( f )
+    {
+      if( tape_to_wav( buf, len, f, exportrate, exportslow, &job->stats, &job->ms ) )
+        job->status = TAPECONV_OK;
+      if( fclose( f ) != 0 )
+        job->status = TAPECONV_WRITEERR;
+    }
+    free( wavname );
+  }
+
+  free( buf );
+}
+
+static int tapeconv_worker( void *data )
+{
+  struct tapeconv_job *job;
+
+  for( ;; )
+  {
+    SDL_mutexP( jobmutex );
+    job = ( nextjob < numjobs ) ? &jobs[nextjob++] : NULL;
+    SDL_mutexV( jobmutex );
+
+    if( !job ) break;
+
+    if( exporting )
+      tapeconv_export( job );
+    else
+      tapeconv_convert( job );
+
+    SDL_mutexP( jobmutex );
+    printf( "%s: %s", job->showname, statusnames[job->status] );
+    if( ( job->status == TAPECONV_OK ) && ( exporting ) )
+      printf( " (%d files, %u:%02u)", job->stats.sections, job->ms/60000, (job->ms/1000)%60 );
+    else if( job->status == TAPECONV_OK )
+      printf( " (%d files, %d bytes, %d parity errors)", job->stats.sections, job->stats.bytes, job->stats.parityerrors );
+    printf( "\n" );
+    fflush( stdout );
+    SDL_mutexV( jobmutex );
+  }
+
+  return 0;
+}
+
+static SDL_bool tapeconv_summary( char *dir )
+{
+  char *fname;
+  FILE *f;
+  int i, ok=0, files=0, bytes=0, parity=0;
+
+  fname = tapeconv_join( dir, TAPECONV_SUMMARY );
+  if( !fname ) return SDL_FALSE;
+
+  f = fopen( fname, "w" );
+  if( !f )
+  {
+    fprintf( stderr, "Unable to write %s\n", fname );
+    free( fname );
+    return SDL_FALSE;
+  }
+
+  fprintf( f, "%-14s %6s %8s %7s %9s %4s  %s\n", "Status", "Files", "Bytes", "Parity", "ORT size", "TAP", "WAV" );
+  for( i=0; i<numjobs; i++ )
+  {
+    fprintf( f, "%-14s %6d %8d %7d %9d %4s  %s\n",
+      statusnames[jobs[i].status],
+      jobs[i].stats.sections,
+      jobs[i].stats.bytes,
+      jobs[i].stats.parityerrors,
+      jobs[i].ortlen,
+      jobs[i].wrotetap ? "yes" : "no",
+      jobs[i].showname );
+
+    if( jobs[i].status == TAPECONV_OK ) ok++;
+    files  += jobs[i].stats.sections;
+    bytes  += jobs[i].stats.bytes;
+    parity += jobs[i].stats.parityerrors;
+  }
+  fprintf( f, "\n%d of %d WAVs converted, %d files, %d bytes, %d parity errors\n", ok, numjobs, files, bytes, parity );
+
+  fclose( f );
+  printf( "Summary written to %s\n", fname );
+  free( fname );
+  return SDL_TRUE;
+}
+
+// Put a file, or every wanted file in a directory, on the job list.
+// "dir" gets where the summary goes, if it isn't set already.
+static SDL_bool tapeconv_addpath( char *path, char **dir )
+{
+  struct stat sb;
+  DIR *dh;
+  struct dirent *de;
+  char *name, *srcname, *sep;
+  int firstjob = numjobs;
+  SDL_bool ok = SDL_TRUE;
+
+  if( stat( path, &sb ) != 0 )
+  {
+    fprintf( stderr, "Unable to find '%s'\n", path );
+    return SDL_FALSE;
+  }
+
+  if( S_ISDIR( sb.st_mode ) )
+  {
+    dh = opendir( path );
+    if( !dh )
+    {
+      fprintf( stderr, "Unable to read the directory '%s'\n", path );
+      return SDL_FALSE;
+    }
+
+    if( !(*dir) ) *dir = strdup( path );
+
+    while( ( de = readdir( dh ) ) )
+    {
+      if( !tapeconv_wanted( de->d_name ) ) continue;
+
+      srcname = tapeconv_join( path, de->d_name );
+      name = strdup( de->d_name );
+      if( ( !srcname ) || ( !name ) || ( !tapeconv_addjob( srcname, name ) ) )
+      {
+        free( srcname );
+        free( name );
+        ok = SDL_FALSE;
+        break;
+      }
+    }
+    closedir( dh );
+  }
+  else
+  {
+    // Just the one, and the summary goes next to it
+    if( !(*dir) )
+    {
+      *dir = strdup( path );
+      if( *dir )
+      {
+        sep = strrchr( *dir, PATHSEP );
+        if( sep )
+          sep[1] = 0;
+        else
+          (*dir)[0] = 0;
+      }
+    }
+    srcname = strdup( path );
+    name = strdup( path );
+    if( ( !srcname ) || ( !name ) || ( !tapeconv_addjob( srcname, name ) ) )
+    {
+      free( srcname );
+      free( name );
+      ok = SDL_FALSE;
+    }
+  }
+
+  if( ( !ok ) || ( !(*dir) ) )
+  {
+    fprintf( stderr, "Out of memory\n" );
+    return SDL_FALSE;
+  }
+
+  if( numjobs == firstjob )
+  {
+    fprintf( stderr, "No %s found in '%s'\n", exporting ? "TAPs or ORTs" : "WAVs", path );
+    return SDL_FALSE;
+  }
+
+  return SDL_TRUE;
+}
+
+// Do every job on the list for each of the files, or directories of
+// them. "threads" of 0 means one per CPU.
+static SDL_bool tapeconv_batch( char **paths, int numpaths, int threads )
+{
+  SDL_Thread *workers[TAPECONV_MAXTHREADS];
+  char *dir = NULL;
+  int i, j;
+  SDL_bool ok = SDL_TRUE;
+
+  jobs = NULL;
+  numjobs = 0;
+  nextjob = 0;
+
+  for( i=0; ( ok ) && ( i<numpaths ); i++ )
+    ok = tapeconv_addpath( paths[i], &dir );
+
+  if( ok )
+  {
+    // The same file named twice would have two workers writing its output
+    qsort( jobs, numjobs, sizeof( struct tapeconv_job ), tapeconv_cmpsrc );
+    for( i=j=0; i<numjobs; i++ )
+    {
+      if( ( j > 0 ) && ( strcmp( jobs[i].srcname, jobs[j-1].srcname ) == 0 ) )
+      {
+        free( jobs[i].srcname );
+        free( jobs[i].showname );
+        continue;
+      }
+      jobs[j++] = jobs[i];
+    }
+    numjobs = j;
+
+    qsort( jobs, numjobs, sizeof( struct tapeconv_job ), tapeconv_cmpjob );
+
+    if( threads <= 0 ) threads = SDL_COMPAT_GetCPUCount();
+    if( threads > TAPECONV_MAXTHREADS ) threads = TAPECONV_MAXTHREADS;
+    if( threads > numjobs ) threads = numjobs;
+
+    jobmutex = SDL_CreateMutex();
+    if( !jobmutex )
+    {
+      fprintf( stderr, "Unable to create a mutex\n" );
+      ok = SDL_FALSE;
+    }
+    else
+    {
+      printf( "%s %d %s with %d threads\n", exporting ? "Exporting" : "Converting", numjobs, exporting ? "tapes" : "WAVs", threads );
+      fflush( stdout );
+
+      // If a thread can't be started, the ones that did will do its share
+      for( i=0; i<threads; i++ )
+      {
+        workers[i] = SDL_COMPAT_CreateThread( tapeconv_worker, "tapeconv", NULL );
+        if( !workers[i] ) break;
+      }
+      threads = i;
+
+      if( !threads )
+        tapeconv_worker( NULL );
+
+      for( i=0; i<threads; i++ )
+        SDL_WaitThread( workers[i], NULL );
+
+      SDL_DestroyMutex( jobmutex );
+      jobmutex = NULL;
+
+      if( ( !exporting ) && ( !tapeconv_summary( dir[0] ? dir : "." ) ) ) ok = SDL_FALSE;
+
+      for( i=0; i<numjobs; i++ )
+        if( jobs[i].status != TAPECONV_OK ) ok = SDL_FALSE;
+    }
+  }
+
+  for( i=0; i<numjobs; i++ )
+  {
+    free( jobs[i].srcname );
+    free( jobs[i].showname );
+  }
+  free( jobs );
+  jobs = NULL;
+  numjobs = 0;
+  free( dir );
+
+  return ok;
+}
+
+// Convert a WAV, or every WAV in a directory
+SDL_bool tapeconv_run( char *path, int threads )
+{
+  exporting = SDL_FALSE;
+  return tapeconv_batch( &path, 1, threads );
+}
+
+// Export each TAP or ORT, or every one in each directory, as WAVs
+SDL_bool tapeconv_export_run( char **paths, int numpaths, Uint32 rate, SDL_bool slow, int threads )
+{
+  exporting  = SDL_TRUE;
+  exportrate = rate;
+  exportslow = slow;
+  return tapeconv_batch( paths, numpaths, threads );
+}
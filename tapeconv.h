@@ -0,0 +1,51 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Batch WAV to ORT/TAP conversion, and TAP/ORT to WAV export
+**
+*/
+
+#define TAPECONV_SUMMARY    "tapeconvert.txt"   // Written next to the converted files
+#define TAPECONV_MAXTHREADS 64
+#define TAPECONV_DEFRATE    44100
+#define TAPECONV_MINRATE    22050                 // Below this a 1 pulse is too few samples
+#define TAPECONV_MAXRATE    192000
+
+enum
+{
+  TAPECONV_PENDING = 0,
+  TAPECONV_OK,
+  TAPECONV_NOTWAV,
+  TAPECONV_READERR,
+  TAPECONV_WRITEERR,
+  TAPECONV_NOMEM
+};
+
+struct tapeconv_job
+{
+  char            *srcname;
+  char            *showname;   // What goes in the summary
+  int              status;
+  int              ortlen;
+  SDL_bool         wrotetap;
+  struct tapestats stats;
+  Uint32           ms;         // Length of an exported WAV
+};
+
+SDL_bool tapeconv_run( char *path, int threads );
+SDL_bool tapeconv_export_run( char **paths, int numpaths, Uint32 rate, SDL_bool slow, int threads );
@@ -0,0 +1,375 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  AY-8912 sound generator check.
+**
+**  Replays logs of register writes through ay_audioticktock and through
+**  the original cycle-by-cycle loop, and fails if the two ever differ in
+**  their output or generator state. Built and run by "make test".
+**
+**  Each line of a log is "<cycles> <reg> <val>": run for that many clock
+**  cycles, then write the value to the register. Numbers can be decimal
+**  or 0x hex, and anything after a '#' is ignored.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "6502.h"
+#include "8912.h"
+#include "via.h"
+#include "gui.h"
+#include "disk.h"
+#include "monitor.h"
+#include "6551.h"
+#include "machine.h"
+#include "avi.h"
+#include "wavcap.h"
+#include "basic.h"
+
+#define TONETIME     8
+#define NOISETIME    8
+#define ENVTIME     16
+
+extern Sint32 voltab[];
+extern unsigned char *eshapes[];
+void ay_audioticktock( struct ay8912 *ay, Uint32 cycles );
+void ay_dowrite( struct ay8912 *ay, struct aywrite *aw );
+
+// 8912.c wants these from the rest of the emulator
+struct avi_handle *vidcap = NULL;
+struct wavcap_handle *wavcap = NULL;
+Sint16 soundsilence = 0;
+SDL_bool soundavailable = SDL_FALSE, soundon = SDL_FALSE, warpspeed = SDL_FALSE;
+char *basicqueue = NULL;
+
+SDL_bool avi_addaudio( struct avi_handle **ah, Sint16 *audiodata, Uint32 audiosize ) { return SDL_FALSE; }
+void wavcap_addaudio( struct wavcap_handle *wh, Sint16 *samples, int count, SDL_bool wait ) {}
+void basic_poll( struct machine *oric ) {}
+void m6502_reset( struct m6502 *cpu ) {}
+SDL_bool m6502_set_icycles( struct m6502 *cpu, SDL_bool dobp, char *bpmsg ) { return SDL_FALSE; }
+void setromon( struct machine *oric ) {}
+void via_init( struct via *v, struct machine *oric, int viatype ) {}
+
+// The sound generators as they were before ay_audioticktock
+// skipped ahead, clocked one cycle at a time
+struct refay
+{
+  Uint8          regs[NUM_AY_REGS];
+  SDL_bool       newnoise;
+  Uint32         toneper[3], noiseper, envper;
+  Uint16         tonebit[3], noisebit[3], newout;
+  Sint32         vol[3];
+  Sint32         ct[3], ctn, cte;
+  Sint32         sign[3], out[3], envpos;
+  unsigned char *envtab;
+  Uint32         currnoise, rndrack;
+  Sint32         output;
+};
+
+static Uint32 ref_rand( struct refay *ay )
+{
+  Uint32 rbit = (ay->rndrack&1) ^ ((ay->rndrack>>2)&1);
+  ay->rndrack = (ay->rndrack>>1)|(rbit<<16);
+  return rbit&1;
+}
+
+static void ref_init( struct refay *ay )
+{
+  Sint32 i;
+
+  memset( ay, 0, sizeof( *ay ) );
+  for( i=0; i<3; i++ )
+  {
+    ay->tonebit[i]  = 1;
+    ay->noisebit[i] = 1;
+  }
+  ay->newout    = 7;
+  ay->newnoise  = SDL_TRUE;
+  ay->envtab    = eshapes[0];
+  ay->rndrack   = 1;
+  ay->output    = soundsilence;
+}
+
+static void ref_ticktock( struct refay *ay, Uint32 cycles )
+{
+  Sint32 i, output;
+
+  while( cycles > 0 )
+  {
+    if( (++ay->ctn) >= ay->noiseper )
+    {
+      ay->currnoise ^= ref_rand( ay );
+      ay->ctn = 0;
+      ay->newnoise = SDL_TRUE;
+    }
+
+    for( i=0; i<3; i++ )
+    {
+      if( !ay->toneper[i] )
+      {
+        if( !ay->sign[i] )
+        {
+          ay->sign[i] = 1;
+          ay->newout |= (1<<i);
+          continue;
+        }
+      }
+
+      if( (++ay->ct[i]) >= ay->toneper[i] )
+      {
+        ay->ct[i] = 0;
+        ay->sign[i] ^= 1;
+        ay->newout |= (1<<i);
+      }
+
+      if( ( ay->newnoise ) && ( !ay->noisebit[i] ) )
+        ay->newout |= (1<<i);
+    }
+
+    if( (++ay->cte) >= ay->envper )
+    {
+      ay->cte = 0;
+      ay->envpos++;
+      if( ay->envtab[ay->envpos]&0x80 )
+        ay->envpos = ay->envtab[ay->envpos]&0x7f;
+
+      for( i=0; i<3; i++ )
+      {
+        if( ay->regs[AY_CHA_AMP+i]&0x10 )
+        {
+          ay->vol[i] = voltab[ay->envtab[ay->envpos]];
+          ay->newout |= (1<<i);
+        }
+      }
+    }
+
+    cycles--;
+  }
+
+  if( !ay->newout ) return;
+
+  output = soundsilence;
+  for( i=0; i<3; i++ )
+  {
+    if( ay->newout & (1<<i) )
+      ay->out[i] = ((ay->tonebit[i]|ay->sign[i])&(ay->noisebit[i]|ay->currnoise)) * ay->vol[i];
+    output += ay->out[i];
+  }
+  ay->newout = 0;
+
+  if( output > 32767 ) output = 32767;
+  ay->output = output;
+}
+
+static void ref_write( struct refay *ay, Uint8 reg, Uint8 val )
+{
+  Sint32 i;
+
+  switch( reg )
+  {
+    case AY_CHA_PER_L:
+    case AY_CHA_PER_H:
+    case AY_CHB_PER_L:
+    case AY_CHB_PER_H:
+    case AY_CHC_PER_L:
+    case AY_CHC_PER_H:
+      ay->regs[reg] = val;
+      i = reg>>1;
+      ay->toneper[i] = (((ay->regs[i*2+1]&0xf)<<8)|ay->regs[i*2]) * TONETIME;
+      break;
+
+    case AY_STATUS:
+      ay->regs[reg] = val;
+      for( i=0; i<3; i++ )
+      {
+        ay->tonebit[i]  = (val&(0x01<<i))?1:0;
+        ay->noisebit[i] = (val&(0x08<<i))?1:0;
+      }
+      ay->newout = 7;
+      break;
+
+    case AY_NOISE_PER:
+      ay->regs[reg] = val;
+      ay->noiseper = (val&0x1f) * NOISETIME;
+      break;
+
+    case AY_CHA_AMP:
+    case AY_CHB_AMP:
+    case AY_CHC_AMP:
+      ay->regs[reg] = val;
+      i = reg-AY_CHA_AMP;
+      if( val&0x10 )
+        ay->vol[i] = voltab[ay->envtab[ay->envpos]];
+      else
+        ay->vol[i] = voltab[val&0xf];
+      ay->newout |= (1<<i);
+      break;
+
+    case AY_ENV_PER_L:
+    case AY_ENV_PER_H:
+      ay->regs[reg] = val;
+      ay->envper = ((ay->regs[AY_ENV_PER_H]<<8)|ay->regs[AY_ENV_PER_L])*ENVTIME;
+      break;
+
+    case AY_ENV_CYCLE:
+      if( val != 0xff )
+      {
+        ay->regs[reg] = val;
+        ay->envtab = eshapes[val&0xf];
+        ay->envpos = 0;
+        for( i=0; i<3; i++ )
+        {
+          if( ay->regs[AY_CHA_AMP+i]&0x10 )
+          {
+            ay->vol[i] = voltab[ay->envtab[ay->envpos]];
+            ay->newout |= (1<<i);
+          }
+        }
+      }
+      break;
+  }
+}
+
+// Chunk sizes to run the two engines for. Mostly around one sample's
+// worth of cycles, as ay_synth uses it, with the odd single cycle and
+// the odd long run thrown in.
+static Uint32 chunkseed = 1;
+static Uint32 nextchunk( void )
+{
+  Uint32 r;
+
+  chunkseed = chunkseed * 1103515245 + 12345;
+  r = (chunkseed>>16)&0x7fff;
+  switch( r&7 )
+  {
+    case 0:  return 1;
+    case 1:  return r%5;
+    case 2:  return 1+(r<<5);
+    default: return 16+(r>>3)%16;
+  }
+}
+
+// Compare everything that shows up in the output
+static SDL_bool same( struct ay8912 *ay, struct refay *ref )
+{
+  Sint32 i;
+
+  if( ay->output[0] != ref->output ) return SDL_FALSE;
+  if( ay->output[1] != ref->output ) return SDL_FALSE;
+  if( ay->ctn       != ref->ctn ) return SDL_FALSE;
+  if( ay->cte       != ref->cte ) return SDL_FALSE;
+  if( ay->envpos    != ref->envpos ) return SDL_FALSE;
+  if( ay->currnoise != ref->currnoise ) return SDL_FALSE;
+  if( ay->rndrack   != ref->rndrack ) return SDL_FALSE;
+  for( i=0; i<3; i++ )
+  {
+    if( ay->ct[i]          != ref->ct[i] ) return SDL_FALSE;
+    if( ay->sign[i]        != ref->sign[i] ) return SDL_FALSE;
+    if( voltab[ay->vol[i]] != ref->vol[i] ) return SDL_FALSE;
+  }
+  return SDL_TRUE;
+}
+
+static SDL_bool run( struct ay8912 *ay, struct refay *ref, Uint32 cycles, Uint64 *clock )
+{
+  Uint32 n;
+
+  do
+  {
+    n = nextchunk();
+    if( n > cycles ) n = cycles;
+    ay_audioticktock( ay, n );
+    ref_ticktock( ref, n );
+    cycles -= n;
+    *clock += n;
+    if( !same( ay, ref ) ) return SDL_FALSE;
+  }
+  while( cycles > 0 );
+
+  return SDL_TRUE;
+}
+
+static SDL_bool runlog( char *fname )
+{
+  static struct machine oric;
+  static struct ay8912 ay;
+  struct refay ref;
+  struct aywrite aw;
+  FILE *f;
+  char line[256], *p;
+  long cycles, reg, val;
+  int lineno = 0;
+  Uint64 clock = 0;
+
+  f = fopen( fname, "r" );
+  if( !f )
+  {
+    printf( "%s: can't open\n", fname );
+    return SDL_FALSE;
+  }
+
+  // ay_init leaves the periods to the register writes that follow it
+  memset( &ay, 0, sizeof( ay ) );
+  oric.keymap   = KMAP_QWERTY;
+  oric.aystereo = AYSTEREO_MONO;
+  ay_init( &ay, &oric );
+  ay_audioticktock( &ay, 0 );
+  ref_init( &ref );
+  chunkseed = 1;
+
+  while( fgets( line, sizeof( line ), f ) )
+  {
+    lineno++;
+    if( ( p = strchr( line, '#' ) ) ) *p = 0;
+    if( sscanf( line, "%li %li %li", &cycles, &reg, &val ) != 3 )
+      continue;
+
+    if( !run( &ay, &ref, cycles, &clock ) )
+    {
+      printf( "%s:%d: output differs at cycle %llu\n", fname, lineno, (unsigned long long)clock );
+      fclose( f );
+      return SDL_FALSE;
+    }
+
+    aw.cycle = 0;
+    aw.reg   = reg;
+    aw.val   = val;
+    ay_dowrite( &ay, &aw );
+    ref_write( &ref, reg, val );
+  }
+  fclose( f );
+
+  printf( "%s: ok (%llu cycles)\n", fname, (unsigned long long)clock );
+  return SDL_TRUE;
+}
+
+int main( int argc, char *argv[] )
+{
+  int i, failed = 0;
+
+  for( i=1; i<argc; i++ )
+  {
+    if( !runlog( argv[i] ) )
+      failed++;
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -39,6 +39,25 @@ extern SDL_bool warpspeed;
 
 static unsigned char bittab[8*8*64*8];
 
+// Cache of rendered LORES text lines. Every line starts with the default
+// attributes, so a line's output depends only on its 40 screen bytes, the
+// character row (and double height phase), the blink phase and the
+// contents of the character set it uses.
+#define TEXTCACHE_SIZE 256   // Must be a power of 2
+
+struct textcache_line
+{
+  SDL_bool valid;
+  Uint32   chargen;          // oric->vid_chargen when this was rendered
+  Uint8   *ch_base;          // Character set used
+  int      yphase;           // y&15 (character row, including double height)
+  int      blink;            // Blink phase
+  Uint8    src[40];          // Screen bytes
+  Uint8    out[240];         // Rendered line
+};
+
+static struct textcache_line textcache[TEXTCACHE_SIZE];
+
 // Refresh the video base pointer
 static inline void ula_refresh_charset( struct machine *oric )
 {
@@ -235,13 +254,44 @@ void ula_renderscreen( struct machine *oric )
   oric->scrpt = scrpt;
 }
 
+// Find the text cache slot for a LORES line. Returns NULL if the line
+// can't be cached, otherwise *hit says whether the slot already holds it.
+static struct textcache_line *ula_textcache_find( struct machine *oric, Uint8 *src, int y, SDL_bool *hit )
+{
+  struct textcache_line *tl;
+  Uint32 hash = 2166136261u;
+  int i, blink;
+
+  for( i=0; i<40; i++ )
+  {
+    // Video mode attributes affect the following lines, so leave those
+    // to the normal renderer.
+    if( ( src[i] & 0x78 ) == 0x18 )
+      return NULL;
+    hash = (hash ^ src[i]) * 16777619u;
+  }
+
+  blink = oric->frames & 0x10;
+  hash = (hash ^ ((y&15)|blink)) * 16777619u;
+  tl = &textcache[(hash^(hash>>16)) & (TEXTCACHE_SIZE-1)];
+
+  *hit = ( tl->valid ) &&
+         ( tl->chargen == oric->vid_chargen ) &&
+         ( tl->ch_base == oric->vid_ch_base ) &&
+         ( tl->yphase == (y&15) ) &&
+         ( tl->blink == blink ) &&
+         ( memcmp( tl->src, src, 40 ) == 0 );
+  return tl;
+}
+
 // Draw one rasterline
 SDL_bool ula_doraster( struct machine *oric )
 {
   int b, c, bitmask;
-  SDL_bool hires, needrender;
+  SDL_bool hires, needrender, hit;
   unsigned int y, cy;
   Uint8 *rptr;
+  struct textcache_line *tl;
 
   needrender = SDL_FALSE;
 
@@ -288,6 +338,7 @@ SDL_bool ula_doraster( struct machine *oric )
     }
 
     oric->vid_raster = 0;
+    tape_sync( oric );
     oric->vsync      = oric->cyclesperraster / 2;
     needrender = SDL_TRUE;
     oric->frames++;
@@ -352,6 +403,32 @@ SDL_bool ula_doraster( struct machine *oric )
 
     rptr = &oric->mem[oric->vidbases[2] + cy -1];  // bb80 = bf68 - (200/8*40)
   }
+
+  tl = NULL;
+  if( !hires )
+  {
+    tl = ula_textcache_find( oric, rptr+1, y, &hit );
+    if( ( tl ) && ( hit ) )
+    {
+      if( memcmp( oric->scrpt, tl->out, 240 ) != 0 )
+      {
+        memcpy( oric->scrpt, tl->out, 240 );
+        oric->vid_dirty[y] = SDL_TRUE;
+      }
+      return needrender;
+    }
+
+    if( tl )
+    {
+      tl->valid   = SDL_TRUE;
+      tl->chargen = oric->vid_chargen;
+      tl->ch_base = oric->vid_ch_base;
+      tl->yphase  = y&15;
+      tl->blink   = oric->frames & 0x10;
+      memcpy( tl->src, rptr+1, 40 );
+    }
+  }
+
   bitmask = (oric->frames&0x10)?0x3f:oric->vid_blinkmask;
     
   for( b=0; b<40; b++ )
@@ -396,6 +473,9 @@ SDL_bool ula_doraster( struct machine *oric )
     }
   }
 
+  if( tl )
+    memcpy( tl->out, &oric->scr[y*240], 240 );
+
   return needrender;
 }
 
@@ -407,14 +487,19 @@ void ula_set_dirty( struct machine *oric )
   {
     oric->vid_dirty[i] = SDL_TRUE;
   }
+
+  // Memory may have been changed behind our back (snapshots etc.)
+  oric->vid_chargen++;
 }
 
 void preinit_ula( struct machine *oric )
 {
   oric->scr = NULL;
+  oric->vid_chargen = 0;
   oric->hstretch = SDL_TRUE;
   oric->scanlines = SDL_FALSE;
   oric->palghost = SDL_TRUE;
+  oric->swpalghost = SDL_FALSE;
 }
 
 SDL_bool init_ula( struct machine *oric )
@@ -19,6 +19,12 @@
 **  Oric video ULA
 */
 
+// Must be called for every write to oric->mem, so that the text line
+// cache can spot changes to either character set.
+#define ULA_CHECK_CHARSET_WRITE( oric, offs ) do { \
+  if( ( ((Uint16)((offs)-(oric)->vidbases[3])) < 0x800 ) || \
+      ( ((Uint16)((offs)-(oric)->vidbases[1])) < 0x800 ) ) (oric)->vid_chargen++; } while( 0 )
+
 void preinit_ula( struct machine *oric );
 SDL_bool init_ula( struct machine *oric );
 void shut_ula( struct machine *oric );
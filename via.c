@@ -414,8 +414,13 @@ void via_clock( struct via *v, unsigned int cycles )
 {
   unsigned int crem;
 
-  // Move on the tape emulation
-  tape_ticktock( v->oric, cycles );
+  // Move on the tape emulation, if anything is due
+  if( v == &v->oric->via )
+  {
+    v->oric->tapeticks -= cycles;
+    if( v->oric->tapeticks <= 0 )
+      tape_ticktock( v->oric, cycles );
+  }
 
   if( !cycles ) return;
 
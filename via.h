@@ -132,6 +132,7 @@ void tape_eject( struct machine *oric );
 void tape_rewind( struct machine *oric );
 SDL_bool tape_load_tap( struct machine *oric, char *fname );
 void tape_ticktock( struct machine *oric, int cycles );
+void tape_sync( struct machine *oric );
 
 // Init/Reset
 void via_init( struct via *v, struct machine *oric, int viatype );
@@ -0,0 +1,268 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Audio capturing (WAV and raw float)
+**
+**  The samples are queued in a ring buffer by whoever is producing the
+**  sound, and a background thread does the conversion and file writes,
+**  so the audio thread never waits for the disk.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "6502.h"
+#include "via.h"
+#include "8912.h"
+#include "wavcap.h"
+
+// Write a 32bit value to a stream in little-endian format
+static SDL_bool write32l( SDL_bool stillok, struct wavcap_handle *wh, Uint32 val, Uint32 *rem )
+{
+  if( !stillok ) return SDL_FALSE; // Something failed earlier, so we're aborting
+  if( rem ) (*rem) = (Uint32)ftell( wh->f );
+  _MAKE_LE32(val);
+  return (fwrite( &val, 4, 1, wh->f ) == 1);
+}
+
+// Write a 16bit value to a stream in little-endian format
+static SDL_bool write16l( SDL_bool stillok, struct wavcap_handle *wh, Uint16 val )
+{
+  if( !stillok ) return SDL_FALSE; // Something failed earlier, so we're aborting
+  _MAKE_LE16(val);
+  return (fwrite( &val, 2, 1, wh->f ) == 1);
+}
+
+// Write a string to a stream
+static SDL_bool writestr( SDL_bool stillok, struct wavcap_handle *wh, char *str )
+{
+  if( !stillok ) return SDL_FALSE; // Something failed earlier, so we're aborting
+  return (fwrite( str, strlen( str ), 1, wh->f ) == 1);
+}
+
+// Convert a block of samples and write it out
+static SDL_bool wavcap_writeblock( struct wavcap_handle *wh, Sint16 *samples, Uint32 count )
+{
+  Uint32 i, u;
+  Uint16 s;
+  float f;
+
+  if( wh->isfloat )
+  {
+    for( i=0; i<count; i++ )
+    {
+      f = ((float)samples[i]) / 32768.0f;
+      memcpy( &u, &f, 4 );
+      _MAKE_LE32(u);
+      memcpy( &wh->chunk[i*4], &u, 4 );
+    }
+    count *= 4;
+  }
+  else
+  {
+    for( i=0; i<count; i++ )
+    {
+      s = samples[i];
+      _MAKE_LE16(s);
+      memcpy( &wh->chunk[i*2], &s, 2 );
+    }
+    count *= 2;
+  }
+
+  wh->datalen += count;
+  return (fwrite( wh->chunk, count, 1, wh->f ) == 1);
+}
+
+// The writer thread. Empties the ring until told to quit, then
+// empties it one last time.
+static int wavcap_writer( void *data )
+{
+  struct wavcap_handle *wh = (struct wavcap_handle *)data;
+  Uint32 head, tail, n;
+  Uint32 quit;
+
+  for( ;; )
+  {
+    quit = AY_LOAD_ACQUIRE( &wh->quit );
+    head = AY_LOAD_ACQUIRE( &wh->head );
+    tail = wh->tail;
+
+    if( head == tail )
+    {
+      if( quit ) break;
+      SDL_Delay( WAVCAP_POLLMS );
+      continue;
+    }
+
+    // Up to the end of the ring, a chunk at a time
+    n = head-tail;
+    if( n > WAVCAP_RINGLEN-(tail&WAVCAP_RINGMASK) ) n = WAVCAP_RINGLEN-(tail&WAVCAP_RINGMASK);
+    if( n > WAVCAP_CHUNK ) n = WAVCAP_CHUNK;
+
+    if( ( !wh->failed ) && ( !wavcap_writeblock( wh, &wh->ring[tail&WAVCAP_RINGMASK], n ) ) )
+      wh->failed = SDL_TRUE;
+
+    AY_STORE_RELEASE( &wh->tail, tail+n );
+  }
+
+  return 0;
+}
+
+struct wavcap_handle *wavcap_open( char *filename, int rate, int channels )
+{
+  struct wavcap_handle *wh;
+  SDL_bool ok;
+  Sint32 i;
+
+  wh = malloc( sizeof( struct wavcap_handle ) );
+  if( !wh ) return NULL;
+
+  memset( wh, 0, sizeof( struct wavcap_handle ) );
+
+  // ".raw" or ".f32" gives headerless 32bit floats, anything else a WAV
+  i = (int)strlen( filename );
+  if( ( i > 3 ) && ( ( strcasecmp( &filename[i-4], ".raw" ) == 0 ) ||
+                     ( strcasecmp( &filename[i-4], ".f32" ) == 0 ) ) )
+    wh->isfloat = SDL_TRUE;
+
+  wh->ring = malloc( WAVCAP_RINGLEN*sizeof( wh->ring[0] ) );
+  if( !wh->ring )
+  {
+    free( wh );
+    return NULL;
+  }
+
+  wh->f = fopen( filename, "wb" );
+  if( !wh->f )
+  {
+    free( wh->ring );
+    free( wh );
+    return NULL;
+  }
+
+  ok = SDL_TRUE;
+  if( !wh->isfloat )
+  {
+    ok &= writestr( ok, wh, "RIFF" );
+    ok &= write32l( ok, wh,       0, &wh->offs_riffsize );   // RIFF size
+    ok &= writestr( ok, wh, "WAVE" );
+    ok &= writestr( ok, wh, "fmt " );
+    ok &= write32l( ok, wh,      16, NULL );                 // Chunk size
+    ok &= write16l( ok, wh,       1 );                       // PCM
+    ok &= write16l( ok, wh,channels );                       // Channels
+    ok &= write32l( ok, wh,    rate, NULL );                 // Sample rate
+    ok &= write32l( ok, wh,rate*2*channels, NULL );          // Bytes per second
+    ok &= write16l( ok, wh,channels*2 );                     // Block align
+    ok &= write16l( ok, wh,      16 );                       // Bits per sample
+    ok &= writestr( ok, wh, "data" );
+    ok &= write32l( ok, wh,       0, &wh->offs_datalen );    // Data size
+  }
+
+  if( ok )
+    wh->thread = SDL_COMPAT_CreateThread( wavcap_writer, "wavcap", wh );
+
+  if( ( !ok ) || ( !wh->thread ) )
+  {
+    fclose( wh->f );
+    free( wh->ring );
+    free( wh );
+    return NULL;
+  }
+
+  return wh;
+}
+
+/*
+** Queue some samples (interleaved, if there is more than one channel).
+** Never blocks unless "wait" is set, in which case it waits for room
+** rather than dropping samples (for when the sound is being produced
+** faster than real time). Otherwise it drops the whole lot if they
+** don't fit, so the channels stay in step.
+*/
+void wavcap_addaudio( struct wavcap_handle *wh, Sint16 *samples, int count, SDL_bool wait )
+{
+  Uint32 head, room, n;
+
+  if( !wh ) return;
+
+  head = wh->head;
+  while( count > 0 )
+  {
+    room = WAVCAP_RINGLEN - (head - AY_LOAD_ACQUIRE( &wh->tail ));
+    if( ( !wait ) && ( room < (Uint32)count ) )
+    {
+      wh->dropped += count;
+      break;
+    }
+
+    if( !room )
+    {
+      SDL_Delay( 1 );
+      continue;
+    }
+
+    n = count;
+    if( n > room ) n = room;
+    if( n > WAVCAP_RINGLEN-(head&WAVCAP_RINGMASK) ) n = WAVCAP_RINGLEN-(head&WAVCAP_RINGMASK);
+
+    memcpy( &wh->ring[head&WAVCAP_RINGMASK], samples, n*sizeof( wh->ring[0] ) );
+    head    += n;
+    samples += n;
+    count   -= n;
+
+    // Publish as we go, so the writer can start on it
+    AY_STORE_RELEASE( &wh->head, head );
+  }
+}
+
+/*
+** Finish the file off and free the handle. Returns SDL_FALSE if any of
+** it couldn't be written. "dropped" (if given) gets how many samples
+** were lost because the writer fell behind.
+*/
+SDL_bool wavcap_close( struct wavcap_handle **wh, Uint32 *dropped )
+{
+  SDL_bool ok;
+
+  if( dropped ) *dropped = 0;
+  if( ( !wh ) || (!(*wh)) ) return SDL_TRUE;
+
+  // Let the writer finish off what's queued
+  AY_STORE_RELEASE( &(*wh)->quit, 1 );
+  SDL_WaitThread( (*wh)->thread, NULL );
+
+  if( dropped ) *dropped = (*wh)->dropped;
+
+  ok = !(*wh)->failed;
+  if( !(*wh)->isfloat )
+  {
+    if( ( ok ) && ( fseek( (*wh)->f, (*wh)->offs_riffsize, SEEK_SET ) != 0 ) ) ok = SDL_FALSE;
+    ok = write32l( ok, *wh, (*wh)->datalen+36, NULL );
+    if( ( ok ) && ( fseek( (*wh)->f, (*wh)->offs_datalen, SEEK_SET ) != 0 ) ) ok = SDL_FALSE;
+    ok = write32l( ok, *wh, (*wh)->datalen, NULL );
+  }
+
+  if( fclose( (*wh)->f ) != 0 ) ok = SDL_FALSE;
+  free( (*wh)->ring );
+  free( (*wh) );
+  *wh = NULL;
+  return ok;
+}
@@ -0,0 +1,50 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Audio capturing (WAV and raw float)
+**
+*/
+
+#define WAVCAP_RINGLEN (1<<20)           // Samples (about 20 seconds at 44.1kHz)
+#define WAVCAP_RINGMASK (WAVCAP_RINGLEN-1)
+#define WAVCAP_CHUNK   4096              // Samples written to the file at a time
+#define WAVCAP_POLLMS  10                // How often the writer looks for more
+
+struct wavcap_handle
+{
+  FILE       *f;
+  SDL_bool    isfloat;                  // Raw 32bit floats instead of a 16bit WAV
+  SDL_bool    failed;
+  Uint32      datalen;
+  Uint32      offs_riffsize;
+  Uint32      offs_datalen;
+  Uint32      dropped;                  // Samples lost because the writer fell behind
+
+  // Single producer (audio callback or headless synthesis), single
+  // consumer (the writer thread). Neither side ever locks.
+  Sint16     *ring;
+  Uint32      head, tail;
+  Uint32      quit;
+  SDL_Thread *thread;
+
+  Uint8       chunk[WAVCAP_CHUNK*4];
+};
+
+struct wavcap_handle *wavcap_open( char *filename, int rate, int channels );
+void wavcap_addaudio( struct wavcap_handle *wh, Sint16 *samples, int count, SDL_bool wait );
+SDL_bool wavcap_close( struct wavcap_handle **wh, Uint32 *dropped );
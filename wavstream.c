@@ -0,0 +1,405 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Streaming WAV tape decoding
+**
+**  Long recordings aren't converted to ORT up front. Instead the file
+**  is mapped (or read a chunk at a time where there's no mmap, or it is
+**  compressed and has to be inflated as it goes), and a
+**  background thread turns the samples into pulse lengths a little
+**  ahead of where the tape is playing. The pulses are the same ones
+**  wav_convert would have put in the ORT data, minus the search for
+**  standard encoded sections, so turbotape doesn't apply to them.
+**
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#include "6502.h"
+#include "via.h"
+#include "8912.h"
+#include "wavstream.h"
+#include "arcfile.h"
+
+static Uint32 get32l( Uint8 *p )
+{
+  return (p[3]<<24)|(p[2]<<16)|(p[1]<<8)|p[0];
+}
+
+static Uint32 get16l( Uint8 *p )
+{
+  return (p[1]<<8)|p[0];
+}
+
+// Same as getsmp in tape.c
+static Sint32 wavstream_smp( struct wavstream *ws, Uint8 *frame )
+{
+  if( ws->useright ) frame += ws->bps;
+  return (ws->bps == 1) ? ((Sint32)*frame)-128 : (Sint16)((frame[1]<<8)|frame[0]);
+}
+
+// Find the format and the sample data
+static SDL_bool wavstream_header( struct wavstream *ws, Uint32 filelen )
+{
+  Uint8 b[16];
+  Uint32 i, chunklen;
+  SDL_bool fmtseen = SDL_FALSE, dataseen = SDL_FALSE;
+
+  i = 12;
+  while( ( !fmtseen ) || ( !dataseen ) )
+  {
+    if( ( i+8 > filelen ) || ( !arc_seek( ws->f, i ) ) || ( arc_read( ws->f, b, 8 ) != 8 ) )
+      return SDL_FALSE;
+
+    chunklen = get32l( &b[4] );
+
+    if( memcmp( b, "fmt ", 4 ) == 0 )
+    {
+      // PCM?
+      if( ( chunklen != 16 ) || ( arc_read( ws->f, b, 16 ) != 16 ) || ( get16l( &b[0] ) != 1 ) )
+        return SDL_FALSE;
+
+      switch( get16l( &b[2] ) )
+      {
+        case 1:  ws->stereo = SDL_FALSE; break;
+        case 2:  ws->stereo = SDL_TRUE;  break;
+        default: return SDL_FALSE;
+      }
+
+      ws->freq     = get32l( &b[4] );
+      ws->framelen = get16l( &b[12] );
+      ws->bps      = get16l( &b[14] );
+      if( ( !ws->freq ) || ( !ws->framelen ) || ( ws->framelen > 4 ) ) return SDL_FALSE;
+      if( ( ws->bps != 8 ) && ( ws->bps != 16 ) ) return SDL_FALSE;
+      ws->bps /= 8;
+      fmtseen = SDL_TRUE;
+    }
+    else if( memcmp( b, "data", 4 ) == 0 )
+    {
+      // Long recordings often have the length wrong or missing
+      ws->dataoffs = i+8;
+      ws->datalen  = chunklen;
+      if( ws->datalen > filelen-ws->dataoffs )
+        ws->datalen = filelen-ws->dataoffs;
+      dataseen = SDL_TRUE;
+    }
+
+    if( chunklen > filelen-i-8 ) break;
+    i += chunklen+8;
+  }
+
+  if( ( !fmtseen ) || ( !dataseen ) ) return SDL_FALSE;
+
+  ws->numframes = ws->datalen / ws->framelen;
+  return ( ws->numframes > 1 );
+}
+
+// Get up to *count frames starting at "first"
+static Uint8 *wavstream_frames( struct wavstream *ws, Uint32 first, Uint32 *count )
+{
+  Uint32 n = *count;
+
+  if( first >= ws->numframes ) n = 0;
+  if( n > ws->numframes-first ) n = ws->numframes-first;
+  if( n > WAVSTREAM_CHUNK ) n = WAVSTREAM_CHUNK;
+
+  if( ws->map )
+  {
+    *count = n;
+    return &ws->map[ws->dataoffs+first*ws->framelen];
+  }
+
+  if( ( n ) && ( arc_seek( ws->f, ws->dataoffs+first*ws->framelen ) ) )
+    n = arc_read( ws->f, ws->chunk, ws->framelen*n ) / ws->framelen;
+  else
+    n = 0;
+
+  *count = n;
+  return ws->chunk;
+}
+
+// The tape input just changed. Queue the pulse that ended, unless it
+// was too short to count, in which case it cancels the last swap. Like
+// wav_convert stepping back through the ORT data, each spike in a row
+// cancels one more, so the last few are held back until they're safe.
+static void wavstream_edge( struct wavstream *ws, Uint32 *head )
+{
+  int i;
+
+  if( ((int)ws->count) < 1 )
+  {
+    // Just a spike. Cancel the last swap.
+    if( ws->numpending )
+      ws->numpending--;
+    else if( !ws->pushedany )
+      ws->startbit = ws->level;
+    ws->count += ws->pcount;
+    return;
+  }
+
+  if( ws->numpending == WAVSTREAM_HOLD )
+  {
+    ws->ring[((*head)++)&WAVSTREAM_RINGMASK] = ws->pending[0];
+    ws->pushedany = SDL_TRUE;
+    for( i=1; i<WAVSTREAM_HOLD; i++ )
+      ws->pending[i-1] = ws->pending[i];
+    ws->numpending--;
+  }
+
+  ws->pending[ws->numpending++] = ((int)ws->count > 0xffff) ? 0xffff : (Uint32)ws->count;
+  ws->pcount = ws->count;
+  ws->count  = 0.0;
+}
+
+static int wavstream_decoder( void *data )
+{
+  struct wavstream *ws = (struct wavstream *)data;
+  Uint32 head, i, n;
+  Sint32 b;
+  Uint8 *p;
+
+  head = ws->head;
+  while( ( !AY_LOAD_ACQUIRE( &ws->quit ) ) && ( ws->frame < ws->numframes ) )
+  {
+    // Each frame can make at most one pulse
+    if( WAVSTREAM_RINGLEN-(head-AY_LOAD_ACQUIRE( &ws->tail )) <= WAVSTREAM_CHUNK )
+    {
+      SDL_Delay( WAVSTREAM_POLLMS );
+      continue;
+    }
+
+    n = WAVSTREAM_CHUNK;
+    p = wavstream_frames( ws, ws->frame, &n );
+    if( !n ) break;
+
+    // Sliced at zero, the same as wav_convert
+    for( i=0; i<n; i++, p+=ws->framelen )
+    {
+      b = wavstream_smp( ws, p ) > 0;
+      if( b != ws->level )
+      {
+        ws->level = b;
+        wavstream_edge( ws, &head );
+      }
+      ws->count += ws->cps;
+    }
+    ws->frame += n;
+
+    AY_STORE_RELEASE( &ws->head, head );
+  }
+
+  if( !AY_LOAD_ACQUIRE( &ws->quit ) )
+  {
+    for( i=0; i<ws->numpending; i++ )
+      ws->ring[(head++)&WAVSTREAM_RINGMASK] = ws->pending[i];
+    ws->numpending = 0;
+    AY_STORE_RELEASE( &ws->head, head );
+    AY_STORE_RELEASE( &ws->eof, 1 );
+  }
+
+  return 0;
+}
+
+// Start decoding from the beginning
+static SDL_bool wavstream_start( struct wavstream *ws )
+{
+  Uint32 n = 1;
+  Uint8 *p;
+
+  ws->head = ws->tail = 0;
+  ws->quit = ws->eof = 0;
+  ws->played = 0;
+
+  p = wavstream_frames( ws, 0, &n );
+  if( !n ) return SDL_FALSE;
+
+  ws->level      = wavstream_smp( ws, p ) > 0;
+  ws->startbit   = ws->level;
+  ws->frame      = 1;
+  ws->count      = 0.0;
+  ws->pcount     = 0.0;
+  ws->numpending = 0;
+  ws->pushedany  = SDL_FALSE;
+
+  ws->thread = SDL_COMPAT_CreateThread( wavstream_decoder, "wavstream", ws );
+  return ( ws->thread != NULL );
+}
+
+struct wavstream *wavstream_open( char *fname )
+{
+  struct wavstream *ws;
+  Sint32 smp, lmin=0, lmax=0, rmin=0, rmax=0;
+  Uint32 filelen, i, n, probe;
+  Uint8 *p;
+
+  ws = malloc( sizeof( struct wavstream ) );
+  if( !ws ) return NULL;
+  memset( ws, 0, sizeof( struct wavstream ) );
+
+  ws->ring = malloc( WAVSTREAM_RINGLEN*sizeof( ws->ring[0] ) );
+  ws->f = arc_open( fname, arc_tapeexts );
+  if( ( !ws->ring ) || ( !ws->f ) )
+  {
+    wavstream_close( &ws );
+    return NULL;
+  }
+
+  filelen = ws->f->size;
+
+  if( !wavstream_header( ws, filelen ) )
+  {
+    wavstream_close( &ws );
+    return NULL;
+  }
+
+#ifdef HAVE_MMAP
+  // Compressed ones are read a chunk at a time
+  if( ws->f->type == ARC_NONE )
+  {
+    ws->map = mmap( NULL, filelen, PROT_READ, MAP_PRIVATE, fileno( ws->f->f ), 0 );
+    if( ws->map == MAP_FAILED )
+    {
+      ws->map = NULL;
+    }
+    else
+    {
+      ws->maplen = filelen;
+#ifdef MADV_SEQUENTIAL
+      madvise( ws->map, ws->maplen, MADV_SEQUENTIAL );
+#endif
+    }
+  }
+#endif
+
+  // wav_convert looks at the whole file to find the loudest channel,
+  // but the start of it is plenty to go on.
+  if( ws->stereo )
+  {
+    probe = ws->freq * WAVSTREAM_PROBE;
+    if( probe > ws->numframes ) probe = ws->numframes;
+    for( i=0; i<probe; i+=n )
+    {
+      n = probe-i;
+      p = wavstream_frames( ws, i, &n );
+      if( !n ) break;
+
+      for( ; n; n--, p+=ws->framelen, i++ )
+      {
+        ws->useright = SDL_FALSE;
+        smp = wavstream_smp( ws, p );
+        if( smp < lmin ) lmin = smp;
+        if( smp > lmax ) lmax = smp;
+
+        ws->useright = SDL_TRUE;
+        smp = wavstream_smp( ws, p );
+        if( smp < rmin ) rmin = smp;
+        if( smp > rmax ) rmax = smp;
+      }
+    }
+    ws->useright = ((rmax-rmin) > (lmax-lmin));
+  }
+
+  ws->cps = 500000 / ((double)ws->freq);  // .ORT is 500khz
+
+  if( !wavstream_start( ws ) )
+  {
+    wavstream_close( &ws );
+    return NULL;
+  }
+
+  return ws;
+}
+
+static void wavstream_stop( struct wavstream *ws )
+{
+  if( !ws->thread ) return;
+
+  AY_STORE_RELEASE( &ws->quit, 1 );
+  SDL_WaitThread( ws->thread, NULL );
+  ws->thread = NULL;
+}
+
+void wavstream_close( struct wavstream **ws )
+{
+  if( ( !ws ) || ( !(*ws) ) ) return;
+
+  wavstream_stop( *ws );
+
+#ifdef HAVE_MMAP
+  if( (*ws)->map ) munmap( (*ws)->map, (*ws)->maplen );
+#endif
+  arc_close( &(*ws)->f );
+  if( (*ws)->ring ) free( (*ws)->ring );
+  free( *ws );
+  *ws = NULL;
+}
+
+SDL_bool wavstream_rewind( struct wavstream *ws )
+{
+  wavstream_stop( ws );
+  return wavstream_start( ws );
+}
+
+// The level the tape starts at
+int wavstream_startbit( struct wavstream *ws )
+{
+  // It can still change until the first pulse is out
+  while( ( !AY_LOAD_ACQUIRE( &ws->head ) ) && ( !AY_LOAD_ACQUIRE( &ws->eof ) ) )
+    SDL_Delay( 1 );
+
+  return ws->startbit;
+}
+
+// The next pulse length in ORT units, or 0 at the end of the tape.
+// The decoder is far quicker than real time, so waiting for it only
+// happens if the host is badly overloaded (or in warp speed).
+int wavstream_next( struct wavstream *ws )
+{
+  Uint32 tail = ws->tail, eof, val;
+
+  for( ;; )
+  {
+    eof = AY_LOAD_ACQUIRE( &ws->eof );
+    if( AY_LOAD_ACQUIRE( &ws->head ) != tail ) break;
+    if( ( eof ) || ( !ws->thread ) ) return 0;
+    SDL_Delay( 1 );
+  }
+
+  val = ws->ring[tail&WAVSTREAM_RINGMASK];
+  AY_STORE_RELEASE( &ws->tail, tail+1 );
+
+  ws->played += val;
+  return val;
+}
+
+// How far through the recording we are, in sample frames
+Uint32 wavstream_tell( struct wavstream *ws )
+{
+  Uint64 frame = (ws->played * ws->freq) / 500000;
+
+  if( frame >= ws->numframes ) frame = ws->numframes-1;
+  return (Uint32)frame;
+}
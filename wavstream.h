@@ -0,0 +1,68 @@
+/*
+**  Oricutron
+**  Copyright (C) 2009-2014 Peter Gordon
+**
+**  This program is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU General Public License
+**  as published by the Free Software Foundation, version 2
+**  of the License.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+**  Streaming WAV tape decoding
+**
+*/
+
+#define WAVSTREAM_MINSIZE  (16*1024*1024)   // WAVs at least this big are streamed
+#define WAVSTREAM_RINGLEN  (1<<16)          // Pulses decoded ahead of the play position
+#define WAVSTREAM_RINGMASK (WAVSTREAM_RINGLEN-1)
+#define WAVSTREAM_CHUNK    8192             // Sample frames decoded at a time
+#define WAVSTREAM_PROBE    30               // Seconds looked at to choose the loudest channel
+#define WAVSTREAM_POLLMS   5                // How often the decoder looks for room
+#define WAVSTREAM_HOLD     2                // Pulses held back so spikes can cancel them
+
+struct wavstream
+{
+  struct arcfile *f;                    // Possibly compressed
+  Uint8      *map;                      // The whole file, if it could be mapped
+  size_t      maplen;
+
+  // Format
+  Uint32      dataoffs, datalen;        // The sample data in the file
+  Uint32      numframes;
+  Uint32      freq, framelen, bps;
+  SDL_bool    stereo, useright;
+
+  // Decoder (only touched by the decoder thread while it runs)
+  Uint32      frame;
+  Sint32      level;
+  double      cps, count, pcount;
+  Uint32      pending[WAVSTREAM_HOLD];  // Last pulses, held back in case spikes follow them
+  Uint32      numpending;
+  SDL_bool    pushedany;
+  Uint8       chunk[WAVSTREAM_CHUNK*4];
+
+  // Single producer (the decoder), single consumer (tape emulation)
+  Uint16     *ring;
+  Uint32      head, tail;
+  Uint32      quit, eof;
+  Uint32      startbit;                 // Level of the first sample, fixed before the first pulse
+  SDL_Thread *thread;
+
+  // Consumer side
+  Uint64      played;                   // In ORT (500kHz) units
+};
+
+struct wavstream *wavstream_open( char *fname );
+void wavstream_close( struct wavstream **ws );
+SDL_bool wavstream_rewind( struct wavstream *ws );
+int wavstream_startbit( struct wavstream *ws );
+int wavstream_next( struct wavstream *ws );
+Uint32 wavstream_tell( struct wavstream *ws );